@@ -9,115 +9,1801 @@
 #include <vector>
 #include <string>
 #endif  /* __PROGTEST__ */
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+#ifndef __PROGTEST__
+#include <chrono>
+#include <utility>
+#include <sstream>
+#endif  /* __PROGTEST__ */
+
+const size_t MAX_BITS_IN_OTHER_BYTES = 6;
+const size_t BITS = 8;
+// The highest number encoded, the highest ID with 4 UTF-8 bytes + 1
+const uint32_t MAX_ENCODED = 1u << (3 * MAX_BITS_IN_OTHER_BYTES + 3);
+const size_t FIBONACCI_COUNT = 32;
+// IDs below this one are encoded by a lookup in a table (1 and 2 UTF-8 bytes)
+const size_t DIRECT_CODES = 0x800;
+// Fibonacci codes are decoded by words of this many bits
+const size_t WORD_BITS = 64;
+// Bits written or read at once by the bit writer and reader (a byte
+// of them can be pending)
+const size_t MAX_PUT_BITS = WORD_BITS - BITS;
+// Files are read and written by blocks of this many bytes
+const size_t BUFFER_SIZE = 1 << 16;
+// Bytes of UTF-8 characters decoded one by one, before trying the ASCII
+// fast path again
+const size_t ASCII_BLOCK = 32;
+const size_t MAX_UTF8_BYTES = 4;
+// A framed file starts with this (a raw stream of codes can't)
+const size_t FRAME_MAGIC_SIZE = 8;
+const char FRAME_MAGIC[FRAME_MAGIC_SIZE + 1] = "\0\0\0\0FIB1";
+// Blocks of a framed file are encoded from this many bytes of UTF-8
+// characters, a batch of this many blocks per thread at once
+const size_t FRAME_BLOCK_SIZE = 1 << 20;
+const size_t FRAME_BATCH = 4;
+// Codes of a block take at most this many bytes: a block has at most
+// FRAME_BLOCK_SIZE bytes and a cut character, a code takes at most 11 bits
+// per byte of it's character (of an ASCII one)
+const size_t FRAME_MAX_CODES_SIZE = (FRAME_BLOCK_SIZE + MAX_UTF8_BYTES) * 11 / 8 + 1;
+// Sizes of the blocks and their numbers of characters are written
+// in this many bytes
+const size_t FRAME_SIZE_BYTES = 4;
+
+/**
+ * Input read by blocks, of a stream or of memory given at once
+ */
+struct byte_reader {
+    // nullptr, if reading memory
+    std::istream * stream;
+    std::vector<char> buffer;
+    const unsigned char * data;
+    size_t size;
+    size_t position;
+};
+
+/**
+ * Read a stream
+ * @param stream
+ * @return The reader
+ */
+byte_reader
+make_reader(std::istream & stream) {
+    return { &stream, std::vector<char>(BUFFER_SIZE), nullptr, 0, 0 };
+}
+
+/**
+ * Read memory
+ * @param data
+ * @param size
+ * @return The reader
+ */
+byte_reader
+make_reader(const char * data, const size_t size) {
+    return { nullptr, {}, reinterpret_cast<const unsigned char *>(data), size, 0 };
+}
+
+/**
+ * Read the next block of a stream, bytes not read yet (a character cut
+ * by the end of the block) are kept before it
+ * @param reader
+ * @return true, if got anything new;
+ *      false, if there is nothing more to read
+ */
+bool
+refill(byte_reader & reader) {
+    if (!reader.stream) {
+        return false;
+    }
+    const size_t kept = reader.size - reader.position;
+    if (kept) {
+        std::memmove(reader.buffer.data(), reader.data + reader.position, kept);
+    }
+    reader.stream->read(reader.buffer.data() + kept, reader.buffer.size() - kept);
+    reader.data = reinterpret_cast<const unsigned char *>(reader.buffer.data());
+    reader.size = kept + reader.stream->gcount();
+    reader.position = 0;
+    return reader.size > kept;
+}
+
+/**
+ * Read the next byte
+ * @param reader
+ * @param c
+ * @return true, if everything went ok;
+ *      false, if there is nothing more to read
+ */
+inline bool
+next_byte(byte_reader & reader, unsigned char & c) {
+    if (reader.position == reader.size && !refill(reader)) {
+        return false;
+    }
+    c = reader.data[reader.position++];
+    return true;
+}
+
+/**
+ * Output written by blocks, to a stream or to memory
+ */
+struct byte_writer {
+    // nullptr, if writing to memory
+    std::ostream * stream;
+    std::string * memory;
+    std::vector<char> buffer;
+    size_t size;
+};
+
+/**
+ * Write to a stream
+ * @param stream
+ * @return The writer
+ */
+byte_writer
+make_writer(std::ostream & stream) {
+    return { &stream, nullptr, std::vector<char>(BUFFER_SIZE), 0 };
+}
+
+/**
+ * Write to a string (it's old content is dropped)
+ * @param memory
+ * @return The writer
+ */
+byte_writer
+make_writer(std::string & memory) {
+    memory.clear();
+    return { nullptr, &memory, std::vector<char>(BUFFER_SIZE), 0 };
+}
+
+/**
+ * Write everything buffered
+ * @param writer
+ * @return true, if everything went ok;
+ *      false, if couldn't write
+ */
+bool
+flush(byte_writer & writer) {
+    if (writer.stream) {
+        writer.stream->write(writer.buffer.data(), writer.size);
+        if (!writer.stream->good()) {
+            return false;
+        }
+    }
+    else {
+        writer.memory->append(writer.buffer.data(), writer.size);
+    }
+    writer.size = 0;
+    return true;
+}
+
+/**
+ * Write a byte
+ * @param writer
+ * @param c
+ * @return true, if everything went ok;
+ *      false, if couldn't write
+ */
+inline bool
+put_byte(byte_writer & writer, const unsigned char c) {
+    writer.buffer[writer.size++] = static_cast<char>(c);
+    return writer.size < writer.buffer.size() || flush(writer);
+}
+
+/**
+ * Bits written to bytes, the first one to bit 0 of a byte
+ */
+struct bit_writer {
+    byte_writer * out;
+    // Bits not written yet (less than a byte), the first one in bit 0
+    uint64_t pending;
+    size_t pending_bits;
+};
+
+/**
+ * Write bits
+ * @param writer
+ * @param bits The first one in bit 0
+ * @param length At most MAX_PUT_BITS
+ * @return true, if everything went ok;
+ *      false, if couldn't write
+ */
+inline bool
+put_bits(bit_writer & writer, const uint64_t bits, const size_t length) {
+    writer.pending |= bits << writer.pending_bits;
+    for (writer.pending_bits += length; writer.pending_bits >= BITS; writer.pending_bits -= BITS) {
+        if (!put_byte(*writer.out, static_cast<unsigned char>(writer.pending))) {
+            return false;
+        }
+        writer.pending >>= BITS;
+    }
+    return true;
+}
+
+/**
+ * Write zeros, as many as needed
+ * @param writer
+ * @param count
+ * @return true, if everything went ok;
+ *      false, if couldn't write
+ */
+bool
+put_zeros(bit_writer & writer, size_t count) {
+    for (; count > MAX_PUT_BITS; count -= MAX_PUT_BITS) {
+        if (!put_bits(writer, 0, MAX_PUT_BITS)) {
+            return false;
+        }
+    }
+    return put_bits(writer, 0, count);
+}
+
+/**
+ * Write the last bits (the rest of their byte are zeros) and everything
+ * buffered
+ * @param writer
+ * @return true, if everything went ok;
+ *      false, if couldn't write
+ */
+bool
+finish_bits(bit_writer & writer) {
+    if (writer.pending_bits && !put_byte(*writer.out, static_cast<unsigned char>(writer.pending))) {
+        return false;
+    }
+    writer.pending = 0;
+    writer.pending_bits = 0;
+    return flush(*writer.out);
+}
+
+/**
+ * Bits read from bytes, the first one from bit 0 of a byte
+ */
+struct bit_reader {
+    byte_reader * in;
+    // Bits read, but not taken yet, the first one in bit 0
+    uint64_t buffer;
+    size_t buffered;
+};
+
+/**
+ * Read bytes, until more than MAX_PUT_BITS bits are buffered
+ * @param reader
+ * @return true, if there are more bits to read;
+ *      false, if all bits of the input are buffered
+ */
+inline bool
+fill_bits(bit_reader & reader) {
+    unsigned char c;
+    while (reader.buffered <= MAX_PUT_BITS) {
+        if (!next_byte(*reader.in, c)) {
+            return false;
+        }
+        reader.buffer |= static_cast<uint64_t>(c) << reader.buffered;
+        reader.buffered += BITS;
+    }
+    return reader.in->position < reader.in->size || refill(*reader.in);
+}
+
+/**
+ * Take bits
+ * @param reader
+ * @param length At most MAX_PUT_BITS
+ * @param bits The first one in bit 0
+ * @return true, if everything went ok;
+ *      false, if the input ends before them
+ */
+inline bool
+get_bits(bit_reader & reader, const size_t length, uint64_t & bits) {
+    if (reader.buffered < length) {
+        fill_bits(reader);
+        if (reader.buffered < length) {
+            return false;
+        }
+    }
+    bits = reader.buffer & ((1ull << length) - 1);
+    reader.buffer >>= length;
+    reader.buffered -= length;
+    return true;
+}
+
+/**
+ * Take zeros and the '1' after them
+ * @param reader
+ * @param max_zeros
+ * @param zeros Number of the zeros
+ * @return true, if everything went ok;
+ *      false, if there are more zeros or the input ends before '1'
+ */
+inline bool
+get_unary(bit_reader & reader, const size_t max_zeros, size_t & zeros) {
+    zeros = 0;
+    while (!reader.buffer) {
+        zeros += reader.buffered;
+        reader.buffered = 0;
+        if (zeros > max_zeros || (!fill_bits(reader) && !reader.buffered)) {
+            return false;
+        }
+    }
+    const size_t run = __builtin_ctzll(reader.buffer);
+    zeros += run;
+    // The run and the '1' (buffer is shifted twice, run + 1 can be 64)
+    reader.buffer >>= run;
+    reader.buffer >>= 1;
+    reader.buffered -= run + 1;
+    return zeros <= max_zeros;
+}
+
+#ifdef SIMD_X86
+/**
+ * Copy ASCII characters from the beginning as IDs, 32 bytes at once
+ * @param data
+ * @param size
+ * @param ids
+ * @return Number of the characters (the rest starts with a block,
+ *      which isn't all ASCII, or is shorter than a block)
+ */
+__attribute__((target("avx2")))
+size_t
+ascii_prefix_avx2(const unsigned char * data, const size_t size, uint32_t ids[]) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        if (_mm256_movemask_epi8(bytes)) {
+            break;
+        }
+        for (size_t j = 0; j < 32; j += 8) {
+            __m128i eight = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(data + i + j));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(ids + i + j), _mm256_cvtepu8_epi32(eight));
+        }
+    }
+    return i;
+}
+
+/**
+ * Copy ASCII characters from the beginning as IDs, 16 bytes at once
+ * @param data
+ * @param size
+ * @param ids
+ * @return Number of the characters
+ */
+size_t
+ascii_prefix_sse2(const unsigned char * data, const size_t size, uint32_t ids[]) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        if (_mm_movemask_epi8(bytes)) {
+            break;
+        }
+        __m128i low = _mm_unpacklo_epi8(bytes, zero), high = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(ids + i), _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(ids + i + 4), _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(ids + i + 8), _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(ids + i + 12), _mm_unpackhi_epi16(high, zero));
+    }
+    return i;
+}
+#endif  /* SIMD_X86 */
+
+/**
+ * Copy ASCII characters from the beginning as IDs, 8 bytes at once
+ * (on processors without SIMD instructions)
+ * @param data
+ * @param size
+ * @param ids
+ * @return Number of the characters
+ */
+size_t
+ascii_prefix_scalar(const unsigned char * data, const size_t size, uint32_t ids[]) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t bytes;
+        std::memcpy(&bytes, data + i, sizeof(bytes));
+        if (bytes & 0x8080808080808080ull) {
+            break;
+        }
+        for (size_t j = 0; j < 8; j++) {
+            ids[i + j] = data[i + j];
+        }
+    }
+    return i;
+}
+
+using ascii_prefix_function = size_t (*)(const unsigned char *, size_t, uint32_t[]);
+
+/**
+ * Choose the widest ASCII fast path, which the processor supports
+ * @return The function
+ */
+ascii_prefix_function
+choose_ascii_prefix() {
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ascii_prefix_avx2;
+    }
+    return ascii_prefix_sse2;
+#else
+    return ascii_prefix_scalar;
+#endif  /* SIMD_X86 */
+}
+
+const ascii_prefix_function ASCII_PREFIX = choose_ascii_prefix();
+
+/**
+ * Number of bytes of UTF-8 characters by their first byte, 0 if it
+ * can't be the first one (more than 4 bytes, or "10" of other bytes)
+ * @return The numbers
+ */
+constexpr std::array<uint8_t, 1 << BITS>
+make_utf8_length_table() {
+    std::array<uint8_t, 1 << BITS> table {};
+    for (size_t c = 0; c < table.size(); c++) {
+        table[c] = c < 0x80 ? 1 : c < 0xc0 ? 0 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : c < 0xf8 ? 4 : 0;
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 1 << BITS> UTF8_LENGTH = make_utf8_length_table();
+
+/**
+ * Decode UTF-8 characters in bulk: runs of ASCII by the fast path,
+ * other characters one by one until the next block
+ * @param data
+ * @param size
+ * @param ids At least size IDs
+ * @param consumed Number of the bytes decoded (a character cut
+ *      by the end isn't)
+ * @param count Number of the IDs
+ * @return true, if everything went ok;
+ *      false, if got invalid character
+ */
+bool
+decode_utf8(const unsigned char * data, const size_t size, uint32_t ids[],
+            size_t & consumed, size_t & count) {
+    size_t i = 0;
+    count = 0;
+    while (i < size) {
+        size_t ascii = ASCII_PREFIX(data + i, size - i, ids + count);
+        i += ascii;
+        count += ascii;
+
+        const size_t block_end = std::min(size, i + ASCII_BLOCK);
+        while (i < block_end) {
+            const unsigned char first = data[i];
+            if (first < 0x80) {
+                ids[count++] = first;
+                i++;
+                continue;
+            }
+
+            const size_t bytes = UTF8_LENGTH[first];
+            if (!bytes) {
+                return false;
+            }
+            // We ignore the prefix and the '0' after it
+            uint32_t id = first & (0x7f >> bytes);
+            const size_t available = std::min(bytes, size - i);
+            for (size_t j = 1; j < available; j++) {
+                // 0xc0 = (11000000)bin, 0x80 = (10000000)bin
+                if ((data[i + j] & 0xc0) != 0x80) {
+                    return false;
+                }
+                id = id << MAX_BITS_IN_OTHER_BYTES | (data[i + j] & 0x3f);
+            }
+            if (available < bytes) {
+                consumed = i;
+                return true;
+            }
+            ids[count++] = id;
+            i += bytes;
+        }
+    }
+    consumed = i;
+    return true;
+}
+
+/**
+ * Fibonacci numbers 1, 2, 3, 5, ..., bit i of a code stands for the i-th
+ * @return The numbers
+ */
+constexpr std::array<uint32_t, FIBONACCI_COUNT>
+make_fibonacci_table() {
+    std::array<uint32_t, FIBONACCI_COUNT> table {};
+    table[0] = 1, table[1] = 2;
+    for (size_t i = 2; i < FIBONACCI_COUNT; i++) {
+        table[i] = table[i - 1] + table[i - 2];
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, FIBONACCI_COUNT> FIBONACCI = make_fibonacci_table();
+static_assert(FIBONACCI[FIBONACCI_COUNT - 1] > MAX_ENCODED,
+              "Not enough Fibonacci numbers for 4 UTF-8 bytes");
+
+/**
+ * Fibonacci code of a number, bit 0 is written first and the last
+ * bit is the terminating '1'
+ */
+struct fib_code {
+    uint32_t bits;
+    uint32_t length;
+};
+
+/**
+ * Encode the number with Fibonacci code, greedily from the highest
+ * Fibonacci number not greater than it
+ * @param num From 1 to MAX_ENCODED
+ * @return Encoded number
+ */
+constexpr fib_code
+encode_fibonacci(uint32_t num) {
+    // Binary search, FIBONACCI[low] <= num < FIBONACCI[high]
+    size_t low = 0, high = FIBONACCI_COUNT;
+    while (high - low > 1) {
+        size_t middle = (low + high) / 2;
+        if (FIBONACCI[middle] <= num) {
+            low = middle;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    // We will need to append '1' after the highest bit
+    fib_code code = { 1u << (low + 1), static_cast<uint32_t>(low + 2) };
+    for (size_t i = low + 1; i-- > 0;) {
+        // After taking FIBONACCI[i], the rest is smaller than
+        // FIBONACCI[i - 1], so no two '1's are next to each other
+        if (FIBONACCI[i] <= num) {
+            code.bits |= 1u << i;
+            num -= FIBONACCI[i];
+        }
+    }
+    return code;
+}
+
+/**
+ * Codes of the code points with 1 or 2 UTF-8 bytes (ASCII and Latin)
+ * @return The codes
+ */
+constexpr std::array<fib_code, DIRECT_CODES>
+make_code_table() {
+    std::array<fib_code, DIRECT_CODES> table {};
+    for (size_t id = 0; id < DIRECT_CODES; id++) {
+        // +1, because we need to shift number to the right
+        table[id] = encode_fibonacci(static_cast<uint32_t>(id + 1));
+    }
+    return table;
+}
+
+constexpr std::array<fib_code, DIRECT_CODES> CODE_TABLE = make_code_table();
+
+/**
+ * The lowest Fibonacci number, which isn't left to the table in
+ * encode_code_point() (the rest is always below it)
+ * @return It's index
+ */
+constexpr size_t
+find_table_index() {
+    size_t i = 0;
+    while (FIBONACCI[i + 1] <= DIRECT_CODES + 1) {
+        i++;
+    }
+    return i;
+}
+
+constexpr size_t TABLE_INDEX = find_table_index();
+
+/**
+ * The highest Fibonacci number, which can be a term of a code
+ * @return It's index
+ */
+constexpr size_t
+find_top_index() {
+    size_t i = 0;
+    while (FIBONACCI[i + 1] <= MAX_ENCODED) {
+        i++;
+    }
+    return i;
+}
+
+constexpr size_t TOP_INDEX = find_top_index();
+
+/**
+ * Get Fibonacci code of UTF-8 character's ID
+ * @param id
+ * @return Encoded ID + 1
+ */
+inline fib_code
+encode_code_point(const uint32_t id) {
+    if (id < DIRECT_CODES) {
+        return CODE_TABLE[id];
+    }
+
+    // Higher terms greedily, without branches (characters of a text are
+    // random enough to mispredict them), the rest from the table
+    uint32_t num = id + 1;
+    fib_code code = { 0, 0 };
+    for (size_t i = TOP_INDEX; i >= TABLE_INDEX; i--) {
+        uint32_t take = FIBONACCI[i] <= num;
+        code.bits |= take << i;
+        num = take ? num - FIBONACCI[i] : num;
+        // The highest term decides the length, '1' is appended after it
+        code.length = code.length ? code.length : take * static_cast<uint32_t>(i + 2);
+    }
+    code.bits |= 1u << (code.length - 1);
+
+    const fib_code & rest = CODE_TABLE[num ? num - 1 : 0];
+    code.bits |= num ? rest.bits ^ (1u << (rest.length - 1)) : 0;
+    return code;
+}
+
+/**
+ * Fibonacci code (a code of every number ends with "11"), with the IDs
+ * shifted by 1
+ */
+struct fibonacci_code {
+    /**
+     * Write a code
+     * @param out
+     * @param id
+     * @return true, if everything went ok;
+     *      false, if couldn't write
+     */
+    static inline bool
+    encode(bit_writer & out, const uint32_t id) {
+        fib_code code = encode_code_point(id);
+        return put_bits(out, code.bits, code.length);
+    }
+
+    static inline bool
+    decode(bit_reader & in, uint32_t & id);
+};
+
+/**
+ * Encode UTF-8 characters with a code
+ * @tparam Code fibonacci_code, elias_gamma_code, ... (how an ID is written)
+ * @param utf8
+ * @param out
+ * @return true, if everything went ok;
+ *      false, if got invalid character or couldn't write
+ */
+template <typename Code>
+bool
+utf8_to_codes(byte_reader & utf8, byte_writer & out) {
+    std::vector<uint32_t> ids(BUFFER_SIZE);
+    bit_writer bits = { &out, 0, 0 };
+    for (;;) {
+        // Memory is decoded by parts, which fit the IDs
+        size_t consumed, count;
+        if (!decode_utf8(utf8.data + utf8.position, std::min(utf8.size - utf8.position, ids.size()),
+                         ids.data(), consumed, count)) {
+            return false;
+        }
+        utf8.position += consumed;
+        // Nothing left, or only a character cut by the end of the block
+        if (!consumed && !refill(utf8)) {
+            break;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (!Code::encode(bits, ids[i])) {
+                return false;
+            }
+        }
+    }
+
+    // A character cut by the end of the input
+    if (utf8.position != utf8.size) {
+        return false;
+    }
+    // Every code has '1' in it, so the zeros after the last one aren't a code
+    return finish_bits(bits);
+}
+
+/**
+ * Encode UTF-8 characters with Fibonacci code
+ * @param utf8
+ * @param out
+ * @return true, if everything went ok;
+ *      false, if got invalid character or couldn't write
+ */
+bool
+utf8_to_fibonacci(byte_reader & utf8, byte_writer & out) {
+    return utf8_to_codes<fibonacci_code>(utf8, out);
+}
+
+bool
+utf8ToFibonacci(std::istream & in, std::ostream & out) {
+    byte_reader reader = make_reader(in);
+    byte_writer writer = make_writer(out);
+    return utf8_to_fibonacci(reader, writer);
+}
+
+bool
+utf8ToFibonacci(const char * data, const size_t size, std::string & out) {
+    byte_reader reader = make_reader(data, size);
+    byte_writer writer = make_writer(out);
+    return utf8_to_fibonacci(reader, writer);
+}
+
+bool
+utf8ToFibonacci(const char * inFile, const char * outFile) {
+    std::ifstream utf8_file;
+    utf8_file.open(inFile);
+    if (!utf8_file.is_open()) {
+        return false;
+    }
+
+    std::ofstream out;
+    out.open(outFile);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    if (!utf8ToFibonacci(utf8_file, out)) {
+        return false;
+    }
+
+    out.close();
+    if (!out.good()) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Sums of Fibonacci numbers, which the bits of a byte stand for, when
+ * the byte is the 1st, 2nd, 3rd or 4th one of a code
+ * @return The sums
+ */
+constexpr std::array<std::array<uint32_t, 1 << BITS>, 4>
+make_sum_table() {
+    std::array<std::array<uint32_t, 1 << BITS>, 4> table {};
+    for (size_t which = 0; which < table.size(); which++) {
+        for (size_t byte = 0; byte < table[which].size(); byte++) {
+            for (size_t bit = 0; bit < BITS; bit++) {
+                if ((byte >> bit) & 1) {
+                    table[which][byte] += FIBONACCI[which * BITS + bit];
+                }
+            }
+        }
+    }
+    return table;
+}
+
+constexpr std::array<std::array<uint32_t, 1 << BITS>, 4> SUM_TABLE = make_sum_table();
+
+/**
+ * State of decoding, carried from one word to the next one
+ */
+struct fib_decoder {
+    // Bits of the current code read so far, the first one in bit 0
+    uint64_t pattern;
+    size_t length;
+    // Whether the last bit read is '1' of the current code
+    uint64_t carry;
+};
+
+/**
+ * Append bits to the current code
+ * @param decoder
+ * @param bits
+ * @param count
+ * @return true, if everything went ok;
+ *      false, if the code stands for too big number
+ */
+inline bool
+append_bits(fib_decoder & decoder, const uint64_t bits, const size_t count) {
+    // No Fibonacci number from the 32nd on is small enough, so only
+    // zeros can be there (and they aren't kept)
+    if (decoder.length >= FIBONACCI_COUNT) {
+        return !bits;
+    }
+    else if (bits >> (FIBONACCI_COUNT - decoder.length)) {
+        return false;
+    }
+    decoder.pattern |= bits << decoder.length;
+    decoder.length = std::min(decoder.length + count, FIBONACCI_COUNT);
+    return true;
+}
+
+/**
+ * Decode codes, which end in a word of Fibonacci codes
+ * @param decoder
+ * @param word Up to 64 bits, the first one in bit 0
+ * @param bits Number of the bits
+ * @param ids At least WORD_BITS / 2 IDs
+ * @param count Number of the IDs decoded
+ * @return true, if everything went ok;
+ *      false, if a number is too big
+ */
+inline bool
+decode_fibonacci(fib_decoder & decoder, const uint64_t word, const size_t bits,
+                 int32_t ids[], size_t & count) {
+    // A code ends with the second '1' of a pair, so runs of '1's end
+    // codes at every second bit. Runs starting at even bits end them
+    // at odd bits and vice versa (a run continuing from the last word
+    // started at bit -1, which is odd).
+    const uint64_t EVEN = 0x5555555555555555ull;
+    uint64_t starts = word & ~(word << 1 | decoder.carry);
+    uint64_t even_runs = word & ~(word + (starts & EVEN));
+    uint64_t ends = (even_runs & ~EVEN) | (word & ~even_runs & EVEN);
+    decoder.carry = (word & ~ends) >> (bits - 1) & 1;
+
+    size_t start = 0;
+    count = 0;
+    for (; ends; ends &= ends - 1) {
+        // The code ends with the bit before the terminating '1'
+        size_t end = __builtin_ctzll(ends);
+        if (!append_bits(decoder, (word >> start) & ((1ull << (end - start)) - 1), end - start)) {
+            return false;
+        }
+        uint64_t pattern = decoder.pattern;
+        uint32_t decoded = SUM_TABLE[0][pattern & 0xff] + SUM_TABLE[1][(pattern >> 8) & 0xff]
+                           + SUM_TABLE[2][(pattern >> 16) & 0xff] + SUM_TABLE[3][(pattern >> 24) & 0xff];
+        if (decoded - 1 > 0x10ffff) {
+            return false;   // Too big number
+        }
+        ids[count++] = decoded - 1;
+        decoder.pattern = 0;
+        decoder.length = 0;
+        start = end + 1;
+    }
+    return start >= bits || append_bits(decoder, word >> start, bits - start);
+}
+
+/**
+ * Tries to encode characters to UTF-8. If for whatever reason
+ * can't encode any character, returns false
+ * @param out
+ * @param num
+ * @return true, if everything went fine;
+ *      false otherwise
+ */
+bool
+encode_utf8(byte_writer & out, int32_t num) {
+    // 0x10ffff = (100001111111111111111)bin
+    if (num > 0x10ffff) {
+        return false;
+    }
+
+    int other_bytes = 0;    // 1 byte by default
+    // 0xffff = (1111111111111111)bin
+    if (num > 0xffff) {
+        // 4 bytes
+        other_bytes = 3;
+    }
+
+    // 0x7ff = (11111111111)bin
+    else if (num > 0x7ff) {
+        // 3 bytes
+        other_bytes = 2;
+    }
+
+    // 0x7f = (1111111)bin
+    else if (num > 0x7f) {
+        // 2 bytes
+        other_bytes = 1;
+    }
+
+    // The first byte starts with '1' for every byte (if there are more
+    // of them) and '0', the other ones with "10"
+    unsigned char first_byte = static_cast<unsigned char>(other_bytes ? 0xff00 >> (other_bytes + 1) : 0)
+                               | num >> (other_bytes * MAX_BITS_IN_OTHER_BYTES);
+    if (!put_byte(out, first_byte)) {
+        return false;
+    }
+
+    // Encoding other bytes
+    for (int i = other_bytes; i > 0; i--) {
+        unsigned char next_byte = 0x80 | ((num >> ((i - 1) * MAX_BITS_IN_OTHER_BYTES)) & 0x3f);
+        if (!put_byte(out, next_byte)) {
+            return false;
+        }
+    }
+    return true;
+}
+  
+/**
+ * Read the next word of Fibonacci codes, the bytes are the word's
+ * bytes from the lowest one
+ * @param fib
+ * @param word
+ * @param bytes Number of the bytes read
+ * @return true, if got anything;
+ *      false, if there is nothing more to read
+ */
+inline bool
+next_word(byte_reader & fib, uint64_t & word, size_t & bytes) {
+    const size_t WORD_BYTES = WORD_BITS / BITS;
+    word = 0;
+    if (fib.size - fib.position >= WORD_BYTES) {
+        for (size_t i = 0; i < WORD_BYTES; i++) {
+            word |= static_cast<uint64_t>(fib.data[fib.position + i]) << (i * BITS);
+        }
+        fib.position += WORD_BYTES;
+        bytes = WORD_BYTES;
+        return true;
+    }
+
+    // The word continues in the next block (or the input ends)
+    unsigned char c;
+    for (bytes = 0; bytes < WORD_BYTES && next_byte(fib, c); bytes++) {
+        word |= static_cast<uint64_t>(c) << (bytes * BITS);
+    }
+    return bytes;
+}
+
+/**
+ * Decode a raw stream of Fibonacci codes to UTF-8 characters
+ * @param fib
+ * @param out
+ * @return true, if everything went ok;
+ *      false, if got invalid code or couldn't write
+ */
+bool
+raw_fibonacci_to_utf8(byte_reader & fib, byte_writer & out) {
+    fib_decoder decoder = { 0, 0, 0 };
+    uint64_t word;
+    size_t bytes;
+    while (next_word(fib, word, bytes)) {
+        int32_t ids[WORD_BITS / 2];
+        size_t count;
+        if (!decode_fibonacci(decoder, word, bytes * BITS, ids, count)) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (!encode_utf8(out, ids[i])) {
+                // This will never happen though
+                return false;
+            }
+        }
+    }
+    // The input can end with zeros, but not in the middle of a code
+    if (decoder.pattern) {
+        return false;
+    }
+    return flush(out);
+}
+
+/**
+ * Take a Fibonacci code (the word decoder is faster, this one decodes
+ * a code at a time like the other codes)
+ * @param in Has it's bits buffered by fill_bits()
+ * @param id
+ * @return true, if everything went ok;
+ *      false, if the code is too long or the input ends in it
+ */
+inline bool
+fibonacci_code::decode(bit_reader & in, uint32_t & id) {
+    // The code ends with the first pair of '1's, the first of them
+    // is it's highest term
+    const uint64_t pairs = in.buffer & in.buffer >> 1;
+    if (!pairs) {
+        return false;
+    }
+    const size_t last = __builtin_ctzll(pairs);
+    if (last >= FIBONACCI_COUNT) {
+        return false;
+    }
+    const uint64_t pattern = in.buffer & ((2ull << last) - 1);
+    id = SUM_TABLE[0][pattern & 0xff] + SUM_TABLE[1][(pattern >> 8) & 0xff]
+         + SUM_TABLE[2][(pattern >> 16) & 0xff] + SUM_TABLE[3][(pattern >> 24) & 0xff] - 1;
+    in.buffer >>= last + 2;
+    in.buffered -= last + 2;
+    return true;
+}
+
+/**
+ * Decode a stream of codes to UTF-8 characters
+ * @tparam Code fibonacci_code, elias_gamma_code, ... (how an ID is read)
+ * @param codes
+ * @param out
+ * @return true, if everything went ok;
+ *      false, if got invalid code or couldn't write
+ */
+template <typename Code>
+bool
+codes_to_utf8(byte_reader & codes, byte_writer & out) {
+    bit_reader bits = { &codes, 0, 0 };
+    // The input can end with zeros (no code is only zeros), encoders
+    // write them only after the last code in it's byte
+    while (fill_bits(bits) || bits.buffer) {
+        uint32_t id;
+        if (!Code::decode(bits, id) || id > 0x10ffff || !encode_utf8(out, static_cast<int32_t>(id))) {
+            return false;
+        }
+    }
+    return flush(out);
+}
+
+/**
+ * Number of bits of the highest number
+ * @param num
+ * @return The bits (0 for 0)
+ */
+constexpr size_t
+bit_length(const uint32_t num) {
+    return num ? WORD_BITS - __builtin_clzll(num) : 0;
+}
+
+// Elias and Golomb codes write numbers up to MAX_ENCODED, so they
+// never have more bits than this
+const size_t MAX_NUMBER_BITS = bit_length(MAX_ENCODED);
+
+/*
+ * Elias codes write ID + 1 (they can't write 0). Bits of the numbers
+ * are written from the lowest one and without the highest '1' (every
+ * number has it), so the decoder doesn't reverse them. The codes are
+ * as long as with the highest bit first.
+ */
+
+/**
+ * Elias gamma code: as many zeros as the number has bits after the highest
+ * '1', then '1' and the bits
+ */
+struct elias_gamma_code {
+    static inline bool
+    encode(bit_writer & out, const uint32_t id) {
+        const uint32_t num = id + 1;
+        const size_t low_bits = bit_length(num) - 1;
+        return put_bits(out, static_cast<uint64_t>(num ^ 1u << low_bits) << (low_bits + 1) | 1ull << low_bits,
+                        2 * low_bits + 1);
+    }
+
+    static inline bool
+    decode(bit_reader & in, uint32_t & id) {
+        size_t low_bits;
+        uint64_t bits;
+        if (!get_unary(in, MAX_NUMBER_BITS - 1, low_bits) || !get_bits(in, low_bits, bits)) {
+            return false;
+        }
+        id = static_cast<uint32_t>(1ull << low_bits | bits) - 1;
+        return true;
+    }
+};
+
+/**
+ * Elias delta code: bits of the number (as in gamma code), their number + 1
+ * in gamma code before them
+ */
+struct elias_delta_code {
+    static inline bool
+    encode(bit_writer & out, const uint32_t id) {
+        const uint32_t num = id + 1;
+        const size_t low_bits = bit_length(num) - 1;
+        const size_t length_bits = bit_length(static_cast<uint32_t>(low_bits + 1)) - 1;
+        const uint64_t length = static_cast<uint64_t>((low_bits + 1) ^ 1u << length_bits) << (length_bits + 1)
+                                | 1ull << length_bits;
+        return put_bits(out, length | static_cast<uint64_t>(num ^ 1u << low_bits) << (2 * length_bits + 1),
+                        2 * length_bits + 1 + low_bits);
+    }
+
+    static inline bool
+    decode(bit_reader & in, uint32_t & id) {
+        size_t length_bits;
+        uint64_t length, bits;
+        if (!get_unary(in, bit_length(MAX_NUMBER_BITS) - 1, length_bits) || !get_bits(in, length_bits, length)) {
+            return false;
+        }
+        const size_t low_bits = (1u << length_bits | length) - 1;
+        if (low_bits >= MAX_NUMBER_BITS || !get_bits(in, low_bits, bits)) {
+            return false;
+        }
+        id = static_cast<uint32_t>(1ull << low_bits | bits) - 1;
+        return true;
+    }
+};
+
+/**
+ * Elias omega code: groups of '0' and bits of a number, each number is
+ * the number of bits in the next group, the first one is 1 and '1' ends
+ * the code (the highest bit of every number is '1', with it first
+ * it would be '1' for a group and '0' for the end)
+ */
+struct elias_omega_code {
+    static inline bool
+    encode(bit_writer & out, const uint32_t id) {
+        // Groups are prepended from the last one
+        uint64_t bits = 1;
+        size_t length = 1;
+        for (uint32_t num = id + 1; num > 1;) {
+            const size_t low_bits = bit_length(num) - 1;
+            bits = bits << (low_bits + 1) | static_cast<uint64_t>(num ^ 1u << low_bits) << 1;
+            length += low_bits + 1;
+            num = static_cast<uint32_t>(low_bits);
+        }
+        return put_bits(out, bits, length);
+    }
+
+    static inline bool
+    decode(bit_reader & in, uint32_t & id) {
+        uint64_t num = 1, end, bits;
+        while (get_bits(in, 1, end) && !end) {
+            if (num >= MAX_NUMBER_BITS || !get_bits(in, num, bits)) {
+                return false;
+            }
+            num = 1ull << num | bits;
+        }
+        if (!end) {
+            return false;
+        }
+        id = static_cast<uint32_t>(num) - 1;
+        return true;
+    }
+};
+
+/**
+ * Golomb code: ID / M as zeros and '1', then ID % M in truncated binary
+ * (remainders below CUTOFF have one bit less)
+ * @tparam M From 1 to MAX_ENCODED
+ */
+template <uint32_t M>
+struct golomb_code {
+    static_assert(M >= 1 && M <= MAX_ENCODED, "Golomb code: Invalid divisor");
+    static constexpr size_t REMAINDER_BITS = bit_length(M - 1);
+    static constexpr uint32_t CUTOFF = (1u << REMAINDER_BITS) - M;
+
+    static inline bool
+    encode(bit_writer & out, const uint32_t id) {
+        const uint32_t quotient = id / M, remainder = id % M;
+        if (!put_zeros(out, quotient)) {
+            return false;
+        }
+        if constexpr (!REMAINDER_BITS) {
+            return put_bits(out, 1, 1);
+        }
+        else {
+            if (remainder < CUTOFF) {
+                return put_bits(out, static_cast<uint64_t>(remainder) << 1 | 1, REMAINDER_BITS);
+            }
+            // The lowest bit is the extra one, so the decoder knows how many
+            // to read from the bits before it
+            const uint64_t bits = remainder + CUTOFF;
+            return put_bits(out, (bits >> 1 | (bits & 1) << (REMAINDER_BITS - 1)) << 1 | 1, REMAINDER_BITS + 1);
+        }
+    }
+
+    static inline bool
+    decode(bit_reader & in, uint32_t & id) {
+        size_t quotient;
+        uint64_t remainder = 0, extra;
+        if (!get_unary(in, (MAX_ENCODED - 1) / M, quotient)
+            || (REMAINDER_BITS && !get_bits(in, REMAINDER_BITS - 1, remainder))) {
+            return false;
+        }
+        if (REMAINDER_BITS && remainder >= CUTOFF) {
+            if (!get_bits(in, 1, extra)) {
+                return false;
+            }
+            remainder = (remainder << 1 | extra) - CUTOFF;
+        }
+        id = static_cast<uint32_t>(quotient * M + remainder);
+        return true;
+    }
+};
+
+/**
+ * Rice code: Golomb code with M = 2 ^ K (the remainder is K bits)
+ */
+template <size_t K>
+using rice_code = golomb_code<1u << K>;
+
+template <typename Code>
+bool
+utf8ToCode(std::istream & in, std::ostream & out) {
+    byte_reader reader = make_reader(in);
+    byte_writer writer = make_writer(out);
+    return utf8_to_codes<Code>(reader, writer);
+}
+
+template <typename Code>
+bool
+utf8ToCode(const char * data, const size_t size, std::string & out) {
+    byte_reader reader = make_reader(data, size);
+    byte_writer writer = make_writer(out);
+    return utf8_to_codes<Code>(reader, writer);
+}
+
+template <typename Code>
+bool
+codeToUtf8(std::istream & in, std::ostream & out) {
+    byte_reader reader = make_reader(in);
+    byte_writer writer = make_writer(out);
+    return codes_to_utf8<Code>(reader, writer);
+}
+
+template <typename Code>
+bool
+codeToUtf8(const char * data, const size_t size, std::string & out) {
+    byte_reader reader = make_reader(data, size);
+    byte_writer writer = make_writer(out);
+    return codes_to_utf8<Code>(reader, writer);
+}
+
+/**
+ * Read bytes
+ * @param reader
+ * @param data
+ * @param size
+ * @return Number of the bytes read (less at the end of the input)
+ */
+size_t
+read_bytes(byte_reader & reader, char * data, const size_t size) {
+    size_t read = 0;
+    while (read < size && (reader.position < reader.size || refill(reader))) {
+        size_t part = std::min(size - read, reader.size - reader.position);
+        std::memcpy(data + read, reader.data + reader.position, part);
+        reader.position += part;
+        read += part;
+    }
+    return read;
+}
+
+/**
+ * Write bytes
+ * @param writer
+ * @param data
+ * @param size
+ * @return true, if everything went ok;
+ *      false, if couldn't write
+ */
+bool
+put_bytes(byte_writer & writer, const char * data, const size_t size) {
+    for (size_t written = 0; written < size;) {
+        size_t part = std::min(size - written, writer.buffer.size() - writer.size);
+        std::memcpy(writer.buffer.data() + writer.size, data + written, part);
+        writer.size += part;
+        written += part;
+        if (writer.size == writer.buffer.size() && !flush(writer)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Read a little-endian number
+ * @param reader
+ * @param number
+ * @param bytes Number of it's bytes
+ * @return true, if everything went ok;
+ *      false, if the input ended
+ */
+bool
+read_number(byte_reader & reader, uint64_t & number, const size_t bytes) {
+    unsigned char data[sizeof(uint64_t)];
+    if (read_bytes(reader, reinterpret_cast<char *>(data), bytes) != bytes) {
+        return false;
+    }
+    number = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        number |= static_cast<uint64_t>(data[i]) << (i * BITS);
+    }
+    return true;
+}
+
+/**
+ * Write a little-endian number
+ * @param writer
+ * @param number
+ * @param bytes Number of it's bytes
+ * @return true, if everything went ok;
+ *      false, if couldn't write
+ */
+bool
+put_number(byte_writer & writer, const uint64_t number, const size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        if (!put_byte(writer, static_cast<unsigned char>(number >> (i * BITS)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Count UTF-8 characters by their first bytes
+ * @param utf8
+ * @return Number of the characters
+ */
+uint64_t
+count_characters(const std::string & utf8) {
+    uint64_t count = 0;
+    for (char c: utf8) {
+        // 0xc0 = (11000000)bin, 0x80 = (10000000)bin
+        count += (c & 0xc0) != 0x80;
+    }
+    return count;
+}
+
+/**
+ * Run tasks on worker threads, every thread takes the next task until
+ * there are none
+ * @param tasks Number of the tasks
+ * @param threads Number of the threads
+ * @param task Function of the task's index
+ */
+template <typename Task>
+void
+run_parallel(const size_t tasks, const size_t threads, Task && task) {
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i; (i = next++) < tasks;) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(threads, tasks); i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto & worker: workers) {
+        worker.join();
+    }
+}
+
+/**
+ * Get the number of threads to use
+ * @param threads Requested number, 0 for all processors
+ * @return The number
+ */
+size_t
+count_threads(const size_t threads) {
+    return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
 
-const size_t MAX_BITS_IN_OTHER_BYTES = 6;
-const size_t BITS = 8;
+/**
+ * Decode blocks of a framed file (after it's magic), a batch of them
+ * at once on worker threads
+ * @param fib
+ * @param out
+ * @param threads
+ * @return true, if everything went ok;
+ *      false, if got invalid block or couldn't write
+ */
+bool
+framed_fibonacci_to_utf8(byte_reader & fib, byte_writer & out, const size_t threads) {
+    struct block {
+        std::string codes;
+        uint64_t characters;
+        std::string utf8;
+        bool decoded;
+    };
+    std::vector<block> batch(threads * FRAME_BATCH);
+    for (bool last = false; !last;) {
+        size_t count = 0;
+        for (; count < batch.size(); count++) {
+            uint64_t size;
+            if (!read_number(fib, size, FRAME_SIZE_BYTES)) {
+                return false;
+            }
+            // The index follows the last block, it's only needed to seek
+            if (!size) {
+                last = true;
+                break;
+            }
+            // Checked before allocating, the size might be damaged
+            if (size > FRAME_MAX_CODES_SIZE) {
+                return false;
+            }
+            block & current = batch[count];
+            current.codes.resize(size);
+            if (!read_number(fib, current.characters, FRAME_SIZE_BYTES)
+                || read_bytes(fib, &current.codes[0], size) != size) {
+                return false;
+            }
+        }
+
+        run_parallel(count, threads, [&](const size_t i) {
+            block & current = batch[i];
+            byte_reader reader = make_reader(current.codes.data(), current.codes.size());
+            byte_writer writer = make_writer(current.utf8);
+            current.decoded = raw_fibonacci_to_utf8(reader, writer)
+                              && count_characters(current.utf8) == current.characters;
+        });
+        for (size_t i = 0; i < count; i++) {
+            if (!batch[i].decoded || !put_bytes(out, batch[i].utf8.data(), batch[i].utf8.size())) {
+                return false;
+            }
+        }
+    }
+    return flush(out);
+}
 
 /**
- * Read the next byte of UTF-8 character
- * @param utf8
- * @param id
- * @param WHICH_BYTE
+ * Decode Fibonacci codes to UTF-8 characters, a framed file, or a raw
+ * stream of codes
+ * @param fib
+ * @param out
+ * @param threads Number of threads for a framed file, 0 for all processors
  * @return true, if everything went ok;
- *      false otherwise
+ *      false, if got invalid code or couldn't write
  */
 bool
-read_next_utf8_byte(std::ifstream & utf8, int32_t & id,
-                    const int WHICH_BYTE) {
-    char c;
-    utf8.get(c);
-    if (!utf8.good()) {
+fibonacci_to_utf8(byte_reader & fib, byte_writer & out, const size_t threads = 0) {
+    // A raw stream can't start with the magic, it'd be 32 '0's and then
+    // a code of a too big number
+    if (fib.size - fib.position < FRAME_MAGIC_SIZE) {
+        refill(fib);
+    }
+    if (fib.size - fib.position >= FRAME_MAGIC_SIZE
+        && !std::memcmp(fib.data + fib.position, FRAME_MAGIC, FRAME_MAGIC_SIZE)) {
+        fib.position += FRAME_MAGIC_SIZE;
+        return framed_fibonacci_to_utf8(fib, out, count_threads(threads));
+    }
+    return raw_fibonacci_to_utf8(fib, out);
+}
+
+bool
+fibonacciToUtf8(std::istream & in, std::ostream & out) {
+    byte_reader reader = make_reader(in);
+    byte_writer writer = make_writer(out);
+    return fibonacci_to_utf8(reader, writer);
+}
+
+bool
+fibonacciToUtf8(const char * data, const size_t size, std::string & out) {
+    byte_reader reader = make_reader(data, size);
+    byte_writer writer = make_writer(out);
+    return fibonacci_to_utf8(reader, writer);
+}
+
+bool
+fibonacciToUtf8(const char * inFile, const char * outFile) {
+    std::ifstream fib_file (inFile);
+    if (!fib_file.is_open()) {
         return false;
     }
 
-    // 0xc0 = (11000000)bin, 0x80 = (10000000)bin
-    if ((c & 0xc0) != 0x80) {
+    std::ofstream out;
+    out.open(outFile);
+    if (!out.is_open()) {
         return false;
     }
- 
-    // We ignore first 2 bits, so we're starting with 5 (6th bit)
-    for (int i = 5; i >= 0; i--) {
-        if ((c >> i) & 1) {
-            int current_bit = WHICH_BYTE * MAX_BITS_IN_OTHER_BYTES + i;
-            id |= 1 << current_bit;
-        }
+
+    if (!fibonacciToUtf8(fib_file, out)) {
+        return false;
     }
 
+    out.close();
+    if (!out.good()) {
+        return false;
+    }
     return true;
-} 
+}
 
 /**
- * Get UTF-8 character's ID
+ * Read the next block of UTF-8 characters to encode
  * @param utf8
- * @param id
- * @return 1, if everything was ok;
- *      EOF, if couldn't read the first byte;
- *          0, if got error
+ * @param text Bytes of a character cut by the last block, the block is
+ *      appended to them
+ * @param cut Bytes of a character cut by this block
+ * @param block_size
+ * @return true, if got anything;
+ *      false, if there is nothing more to read
  */
-int
-get_utf8_id(std::ifstream & utf8, int32_t & id) {
-    char c;
-    utf8.get(c);
-    if (!utf8.good()) {
-        return EOF;
+bool
+read_utf8_block(byte_reader & utf8, std::string & text, std::string & cut, const size_t block_size) {
+    for (;;) {
+        const size_t kept = text.size();
+        text.resize(kept + block_size);
+        const size_t read = read_bytes(utf8, &text[kept], block_size);
+        text.resize(kept + read);
+        cut.clear();
+        if (read < block_size) {
+            // The end of the input, nothing is left for the next block
+            return !text.empty();
+        }
+
+        // Find the first byte of the last character (other bytes start
+        // with "10"), if the character isn't whole, it's left for the next block
+        size_t first = text.size();
+        while (first > 1 && text.size() - first < MAX_UTF8_BYTES - 1 && (text[first - 1] & 0xc0) == 0x80) {
+            first--;
+        }
+        first--;
+        if (UTF8_LENGTH[static_cast<unsigned char>(text[first])] <= text.size() - first) {
+            return true;
+        }
+        cut.assign(text, first, std::string::npos);
+        text.resize(first);
+        if (!text.empty()) {
+            return true;
+        }
+        // The block is a part of one character, it needs more bytes
+        text.swap(cut);
     }
+}
 
-    // 1st stage: getting amount of bytes (maximum is 4 in UTF-8)
-    const int MAX_BYTES = 4;
-    unsigned short other_bytes = 0;
-    // If first bit is 1, then we must have valid prefix
-    if (c & 0x80) { // 0x80 = (10000000)bin
-        for (int i = 6; i >= 0; i--) {
-            if ((c >> i) & 1) {
-                other_bytes++;
-            }
-            else {
+/**
+ * Encode UTF-8 characters to a framed file of independently encoded
+ * blocks, a batch of them at once on worker threads
+ * @param utf8
+ * @param out
+ * @param threads
+ * @param block_size Bytes of UTF-8 characters in a block (at most FRAME_BLOCK_SIZE)
+ * @return true, if everything went ok;
+ *      false, if got invalid character, invalid block size or couldn't write
+ */
+bool
+utf8_to_fibonacci_framed(byte_reader & utf8, byte_writer & out, const size_t threads,
+                         const size_t block_size) {
+    struct block {
+        std::string utf8;
+        std::string codes;
+        bool encoded;
+    };
+    // Bigger blocks couldn't be decoded
+    if (!block_size || block_size > FRAME_BLOCK_SIZE
+        || !put_bytes(out, FRAME_MAGIC, FRAME_MAGIC_SIZE)) {
+        return false;
+    }
+
+    // Offsets of the blocks and numbers of their first characters
+    std::vector<std::pair<uint64_t, uint64_t>> index;
+    uint64_t offset = FRAME_MAGIC_SIZE, characters = 0;
+    std::vector<block> batch(threads * FRAME_BATCH);
+    std::string cut;
+    for (bool last = false; !last;) {
+        size_t count = 0;
+        for (; count < batch.size(); count++) {
+            batch[count].utf8 = cut;
+            if (!read_utf8_block(utf8, batch[count].utf8, cut, block_size)) {
+                last = true;
                 break;
             }
+        }
 
-            // Every character is encoded in 4 bytes max
-            if (!(MAX_BYTES > other_bytes)) {
-                return 0;
+        run_parallel(count, threads, [&](const size_t i) {
+            block & current = batch[i];
+            byte_reader reader = make_reader(current.utf8.data(), current.utf8.size());
+            byte_writer writer = make_writer(current.codes);
+            current.encoded = utf8_to_fibonacci(reader, writer);
+        });
+        for (size_t i = 0; i < count; i++) {
+            const block & current = batch[i];
+            const uint64_t block_characters = count_characters(current.utf8);
+            if (!current.encoded
+                || !put_number(out, current.codes.size(), FRAME_SIZE_BYTES)
+                || !put_number(out, block_characters, FRAME_SIZE_BYTES)
+                || !put_bytes(out, current.codes.data(), current.codes.size())) {
+                return false;
             }
+            index.emplace_back(offset, characters);
+            offset += 2 * FRAME_SIZE_BYTES + current.codes.size();
+            characters += block_characters;
         }
-        // We've got a beginning of prefix, but it's empty.
-        // What the fuck is wrong with this world?
-        if (!other_bytes) {
-            return 0;
+    }
+
+    // "0" instead of the next block's size, the index, the number
+    // of characters and the index's offset
+    if (!put_number(out, 0, FRAME_SIZE_BYTES)) {
+        return false;
+    }
+    offset += FRAME_SIZE_BYTES;
+    for (const auto & entry: index) {
+        if (!put_number(out, entry.first, sizeof(uint64_t))
+            || !put_number(out, entry.second, sizeof(uint64_t))) {
+            return false;
         }
     }
+    return put_number(out, characters, sizeof(uint64_t))
+           && put_number(out, offset, sizeof(uint64_t))
+           && flush(out);
+}
 
-    // 2nd stage: getting the ID itself
-    id = 0;
-    // Working out with the current byte (others are gonna be read
-    // with another function, if needed)
-    int i = 6;          // We always ignore first bit
-    i -= other_bytes;   // Ignore bits in a prefix
-    for (; i >= 0; i--) {
-        if ((c >> i) & 1) {
-            size_t current_bit = other_bytes * MAX_BITS_IN_OTHER_BYTES + i;
-            id |= 1 << current_bit;
+bool
+utf8ToFibonacciFramed(std::istream & in, std::ostream & out, const size_t threads = 0,
+                      const size_t block_size = FRAME_BLOCK_SIZE) {
+    byte_reader reader = make_reader(in);
+    byte_writer writer = make_writer(out);
+    return utf8_to_fibonacci_framed(reader, writer, count_threads(threads), block_size);
+}
+
+bool
+utf8ToFibonacciFramed(const char * data, const size_t size, std::string & out,
+                      const size_t threads = 0, const size_t block_size = FRAME_BLOCK_SIZE) {
+    byte_reader reader = make_reader(data, size);
+    byte_writer writer = make_writer(out);
+    return utf8_to_fibonacci_framed(reader, writer, count_threads(threads), block_size);
+}
+
+bool
+utf8ToFibonacciFramed(const char * inFile, const char * outFile, const size_t threads = 0) {
+    std::ifstream utf8_file;
+    utf8_file.open(inFile);
+    if (!utf8_file.is_open()) {
+        return false;
+    }
+
+    std::ofstream out;
+    out.open(outFile);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    if (!utf8ToFibonacciFramed(utf8_file, out, threads)) {
+        return false;
+    }
+
+    out.close();
+    if (!out.good()) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read a little-endian number at an offset of a file
+ * @param file
+ * @param offset
+ * @param number
+ * @return true, if everything went ok;
+ *      false otherwise
+ */
+bool
+read_number_at(std::istream & file, const uint64_t offset, uint64_t & number) {
+    unsigned char data[sizeof(uint64_t)];
+    if (!file.seekg(offset) || !file.read(reinterpret_cast<char *>(data), sizeof(data))) {
+        return false;
+    }
+    number = 0;
+    for (size_t i = 0; i < sizeof(data); i++) {
+        number |= static_cast<uint64_t>(data[i]) << (i * BITS);
+    }
+    return true;
+}
+
+/**
+ * Decode some characters of a framed file, without decoding the blocks
+ * before them (the block with the first one is found in the index by
+ * binary search)
+ * @param inFile
+ * @param first Number of the first character (from 0)
+ * @param count Number of the characters
+ * @param utf8 The characters
+ * @return true, if everything went ok;
+ *      false, if the file isn't framed, is invalid, or has less characters
+ */
+bool
+fibonacciFramedCharacters(const char * inFile, const uint64_t first, const uint64_t count,
+                          std::string & utf8) {
+    std::ifstream fib_file(inFile, std::ios::binary);
+    char magic[FRAME_MAGIC_SIZE];
+    if (!fib_file.read(magic, sizeof(magic)) || std::memcmp(magic, FRAME_MAGIC, sizeof(magic))
+        || !fib_file.seekg(0, std::ios::end)) {
+        return false;
+    }
+
+    // The file ends with the number of characters and the index's offset
+    const uint64_t size = fib_file.tellg(), TRAILER = 2 * sizeof(uint64_t), ENTRY = 2 * sizeof(uint64_t);
+    uint64_t characters, index;
+    if (size < FRAME_MAGIC_SIZE + TRAILER
+        || !read_number_at(fib_file, size - TRAILER, characters)
+        || !read_number_at(fib_file, size - TRAILER + sizeof(uint64_t), index)
+        || index > size - TRAILER || (size - TRAILER - index) % ENTRY
+        || first > characters || count > characters - first) {
+        return false;
+    }
+    utf8.clear();
+    if (!count) {
+        return true;
+    }
+
+    // The last block starting before (or with) the first character
+    uint64_t low = 0, high = (size - TRAILER - index) / ENTRY;
+    while (high - low > 1) {
+        uint64_t middle = (low + high) / 2, middle_first;
+        if (!read_number_at(fib_file, index + middle * ENTRY + sizeof(uint64_t), middle_first)) {
+            return false;
+        }
+        if (middle_first <= first) {
+            low = middle;
         }
+        else {
+            high = middle;
+        }
+    }
+    uint64_t offset, block_first;
+    if (!read_number_at(fib_file, index + low * ENTRY, offset)
+        || !read_number_at(fib_file, index + low * ENTRY + sizeof(uint64_t), block_first)
+        || block_first > first) {
+        return false;
     }
 
-    // Reading remaining bytes
-    for (i = other_bytes; i > 0; i--) {
-        if (!read_next_utf8_byte(utf8, id, i - 1)) {
-            return 0;
+    // Decode the blocks until there are enough characters
+    if (!fib_file.seekg(offset)) {
+        return false;
+    }
+    byte_reader reader = make_reader(fib_file);
+    std::string block_utf8;
+    uint64_t skip = first - block_first, left = count;
+    while (left) {
+        uint64_t block_size, block_characters;
+        std::string codes;
+        if (!read_number(reader, block_size, FRAME_SIZE_BYTES) || !block_size
+            || block_size > FRAME_MAX_CODES_SIZE
+            || !read_number(reader, block_characters, FRAME_SIZE_BYTES)) {
+            return false;
+        }
+        codes.resize(block_size);
+        byte_reader block_reader = make_reader(codes.data(), codes.size());
+        byte_writer block_writer = make_writer(block_utf8);
+        if (read_bytes(reader, &codes[0], block_size) != block_size
+            || !raw_fibonacci_to_utf8(block_reader, block_writer)) {
+            return false;
+        }
+
+        // The decoded characters are valid, so their first bytes tell
+        // their lengths
+        for (size_t i = 0; i < block_utf8.size() && left;) {
+            size_t bytes = UTF8_LENGTH[static_cast<unsigned char>(block_utf8[i])];
+            if (skip) {
+                skip--;
+            }
+            else {
+                utf8.append(block_utf8, i, bytes);
+                left--;
+            }
+            i += bytes;
         }
     }
+    return true;
+}
+  
+#ifndef __PROGTEST__
+/**
+ * Read a whole file
+ * @param file_name
+ * @return Content of the file
+ */
+std::string
+read_file(const char * file_name) {
+    std::ifstream file(file_name);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
 
-    return 1;
+bool
+identicalFiles(const char * file1, const char * file2) {
+    std::ifstream f1, f2;
+    f1.open(file1), f2.open(file2);
+    for (;;) {
+        char c1, c2;
+        f1.get(c1), f2.get(c2);
+        if (f1.good() != f2.good()) {
+            return false;
+        }
+        else if (c1 != c2) {
+            return false;
+        }
+
+        // We got either an end of file, or file reading failed.
+        // There won't be any errors like the latter on ProgTest
+        // (I'm 99% sure about this),
+        // so I don't even want to spend time detecting them
+        if (!f1.good()) {
+            break;
+        }
+    }
+    return true;
 }
 
 /**
- * Find the max possible fibonacci number
+ * Find the max possible fibonacci number (the original encoder, kept
+ * to check and to benchmark the table-driven one)
  * @param ch_id
  * @param i
  * @return This number
  */
 int
-find_max_fibonacci(int ch_id, long & i) {
+reference_find_max_fibonacci(int ch_id, long & i) {
     int first = 1, second = 2;
     i = 0;
 
@@ -131,92 +1817,35 @@ find_max_fibonacci(int ch_id, long & i) {
 }
 
 /**
- * Encode the number with Fibonacci code
- * @param ch_id
+ * Encode the number with Fibonacci code (the original encoder)
+ * @param num
  * @param highest_bit
  * @return Encoded number
  */
 int32_t
-encode_fibonacci(int32_t num, long & highest_bit) {
+reference_encode_fibonacci(int32_t num, long & highest_bit) {
     int32_t encoded = 0;
     while (num) {
         long bit = 0;
-        int next = find_max_fibonacci(num, bit);
+        int next = reference_find_max_fibonacci(num, bit);
         if (!highest_bit) {
             highest_bit = bit + 1;  // We will need to append '1' to the end
         }
         encoded |= 1 << bit;
-        num -= next;
-    }
-    encoded |= 1 << highest_bit;
-    return encoded;
-}
-
-bool
-utf8ToFibonacci(const char * inFile, const char * outFile) {
-    std::ifstream utf8_file;
-    utf8_file.open(inFile);
-    if (!utf8_file.is_open()) {
-        return false;
-    }
-
-    std::ofstream out;
-    out.open(outFile);
-    if (!out.is_open()) {
-        return false;
-    }
-
-    unsigned char write = 0;
-    size_t bits_written = 0;
-    for (;;) {
-        // We really EXPLICITLY want int32_t here
-        int32_t ch_id;
-        int get_utf8_id_status = get_utf8_id(utf8_file, ch_id);
-        if (!get_utf8_id_status) {
-            return false;
-        }
-        else if (get_utf8_id_status == EOF) {
-            break;
-        } 
-
-        long bits_to_write = 0;
-        int32_t encoded_ch_id = encode_fibonacci(ch_id + 1, bits_to_write);
-        // +1, because we need to shift number to the right
-        for (long i = 0; i <= bits_to_write; i++) {
-            if ((encoded_ch_id >> i) & 1) {
-                write |= 1 << bits_written;
-            }
-            if (++bits_written >= BITS) {
-                out << write;
-                if (!out.good()) {
-                    return false;
-                }
-                write = 0;
-                bits_written = 0;
-            }
-        }
-    }
-    if (write) {
-        out << write;
-        if (!out.good()) {
-            return false;
-        }
-    }
-
-    out.close();
-    if (!out.good()) {
-        return false;
+        num -= next;
     }
-    return true;
+    encoded |= 1 << highest_bit;
+    return encoded;
 }
 
 /**
- * Find fibonacci element by its ID
+ * Find fibonacci element by its ID (the original decoder, kept
+ * to benchmark the table-driven one)
  * @param ID
  * @return Fibonacci element with provided ID
  */
 int
-find_fib_elem(const size_t ID) {
+reference_find_fib_elem(const size_t ID) {
     int first = 1, second = 2;
     for (size_t i = 0; i < ID; i++) {
         int next = first + second;
@@ -227,7 +1856,7 @@ find_fib_elem(const size_t ID) {
 }
 
 /**
- * Try to decode number encoded in Fibonacci code
+ * Try to decode number encoded in Fibonacci code (the original decoder)
  * @param fib_file
  * @param c
  * @param bits_read
@@ -236,7 +1865,7 @@ find_fib_elem(const size_t ID) {
  *      false, if got error
  */
 int
-decode_fibonacci(std::ifstream & fib_file, char & c, size_t & bits_read,
+reference_decode_fibonacci(std::istream & fib_file, char & c, size_t & bits_read,
                  int32_t & decoded) {
     const bool IN = true, OUT = false;
     bool state = OUT, last_bit_was_one = false, read = false;
@@ -264,7 +1893,7 @@ decode_fibonacci(std::ifstream & fib_file, char & c, size_t & bits_read,
                 }
 
                 state = IN;
-                decoded += find_fib_elem(cur_elem);
+                decoded += reference_find_fib_elem(cur_elem);
 
                 if (decoded - 1 > 0x10ffff) {
                     return 0;   // Too big number
@@ -295,164 +1924,550 @@ decode_fibonacci(std::ifstream & fib_file, char & c, size_t & bits_read,
 }
 
 /**
- * Encode first UTF-8 byte
- * @param first_byte
- * @param BYTES_IN_TOTAL
- * @param TO_ENC
+ * Read the next byte of UTF-8 character (the original decoder, kept
+ * to check the bulk one accepts the same characters)
+ * @param utf8
+ * @param id
+ * @param WHICH_BYTE
+ * @return true, if everything went ok;
+ *      false otherwise
  */
-void
-encode_first_byte(unsigned char & first_byte, const int BYTES_IN_TOTAL,
-                  const int32_t TO_ENC) {
-    if (BYTES_IN_TOTAL > 1) {
-        for (size_t i = 7; i > BITS - 1 - BYTES_IN_TOTAL; i--) {
-            first_byte |= 1 << i;
-        }
+bool
+reference_read_next_utf8_byte(byte_reader & utf8, int32_t & id,
+                    const int WHICH_BYTE) {
+    unsigned char c;
+    if (!next_byte(utf8, c)) {
+        return false;
+    }
+
+    // 0xc0 = (11000000)bin, 0x80 = (10000000)bin
+    if ((c & 0xc0) != 0x80) {
+        return false;
     }
-    for (int i = BITS - BYTES_IN_TOTAL; i >= 0; i--) {
-        if ((TO_ENC >> (i + (BYTES_IN_TOTAL - 1) * MAX_BITS_IN_OTHER_BYTES)) & 1) {
-            first_byte |= 1 << i;
+ 
+    // We ignore first 2 bits, so we're starting with 5 (6th bit)
+    for (int i = 5; i >= 0; i--) {
+        if ((c >> i) & 1) {
+            int current_bit = WHICH_BYTE * MAX_BITS_IN_OTHER_BYTES + i;
+            id |= 1 << current_bit;
         }
     }
-}
+
+    return true;
+} 
 
 /**
- * Encode other UTF-8 byte
- * @param out
- * @param WHICH_BYTE
- * @param TO_ENC
- * @return Encoded byte
+ * Get UTF-8 character's ID (the original decoder)
+ * @param utf8
+ * @param id
+ * @return 1, if everything was ok;
+ *      EOF, if couldn't read the first byte;
+ *          0, if got error
  */
-unsigned char
-encode_other_byte(std::ofstream & out, const int WHICH_BYTE,
-                  const int32_t TO_ENC) {
-    unsigned char other_byte = 0x80;
-    for (int i = 5; i >= 0; i--) {
-        if ((TO_ENC >> (i + (WHICH_BYTE - 1) * MAX_BITS_IN_OTHER_BYTES)) & 1) {
-            other_byte |= 1 << i;
+int
+reference_get_utf8_id(byte_reader & utf8, int32_t & id) {
+    unsigned char c;
+    if (!next_byte(utf8, c)) {
+        return EOF;
+    }
+
+    // 1st stage: getting amount of bytes (maximum is 4 in UTF-8)
+    const int MAX_BYTES = 4;
+    unsigned short other_bytes = 0;
+    // If first bit is 1, then we must have valid prefix
+    if (c & 0x80) { // 0x80 = (10000000)bin
+        for (int i = 6; i >= 0; i--) {
+            if ((c >> i) & 1) {
+                other_bytes++;
+            }
+            else {
+                break;
+            }
+
+            // Every character is encoded in 4 bytes max
+            if (!(MAX_BYTES > other_bytes)) {
+                return 0;
+            }
+        }
+        // We've got a beginning of prefix, but it's empty.
+        // What the fuck is wrong with this world?
+        if (!other_bytes) {
+            return 0;
+        }
+    }
+
+    // 2nd stage: getting the ID itself
+    id = 0;
+    // Working out with the current byte (others are gonna be read
+    // with another function, if needed)
+    int i = 6;          // We always ignore first bit
+    i -= other_bytes;   // Ignore bits in a prefix
+    for (; i >= 0; i--) {
+        if ((c >> i) & 1) {
+            size_t current_bit = other_bytes * MAX_BITS_IN_OTHER_BYTES + i;
+            id |= 1 << current_bit;
+        }
+    }
+
+    // Reading remaining bytes
+    for (i = other_bytes; i > 0; i--) {
+        if (!reference_read_next_utf8_byte(utf8, id, i - 1)) {
+            return 0;
         }
     }
-    return other_byte;
+
+    return 1;
 }
 
 /**
- * Tries to encode characters to UTF-8. If for whatever reason
- * can't encode any character, returns false
- * @param out
- * @param num
- * @return true, if everything went fine;
+ * Check, that the table-driven encoder gives the original codes
+ * @param id
+ * @return true, if the codes are the same;
  *      false otherwise
  */
 bool
-encode_utf8(std::ofstream & out, int32_t num) {
-    // 0x10ffff = (100001111111111111111)bin
-    if (num > 0x10ffff) {
-        return false;
-    }
-
-    unsigned char first_byte = 0;
-    int other_bytes = 0;    // 1 byte by default
-    // 0xffff = (1111111111111111)bin
-    if (num > 0xffff) {
-        // 4 bytes
-        other_bytes = 3;
-    }
-
-    // 0x7ff = (11111111111)bin
-    else if (num > 0x7ff) {
-        // 3 bytes
-        other_bytes = 2;
-    }
+same_code(const uint32_t id) {
+    long highest_bit = 0;
+    int32_t expected = reference_encode_fibonacci(id + 1, highest_bit);
+    fib_code code = encode_code_point(id);
+    return code.bits == static_cast<uint32_t>(expected)
+           && code.length == static_cast<uint32_t>(highest_bit + 1);
+}
 
-    // 0x7f = (1111111)bin
-    else if (num > 0x7f) {
-        // 2 bytes
-        other_bytes = 1;
+/**
+ * Check, that the bulk UTF-8 decoder accepts the same characters
+ * as the original one and gives the same IDs
+ * @param utf8
+ * @return true, if the decoders agree;
+ *      false otherwise
+ */
+bool
+same_utf8(const std::string & utf8) {
+    byte_reader reader = make_reader(utf8.data(), utf8.size());
+    std::vector<uint32_t> expected;
+    int status;
+    for (int32_t id; (status = reference_get_utf8_id(reader, id)) == 1;) {
+        expected.push_back(id);
     }
 
-    encode_first_byte(first_byte, other_bytes + 1, num);
-    out << first_byte;
-    if (!out.good()) {
+    std::vector<uint32_t> ids(utf8.size());
+    size_t consumed, count;
+    bool decoded = decode_utf8(reinterpret_cast<const unsigned char *>(utf8.data()), utf8.size(),
+                               ids.data(), consumed, count)
+                   && consumed == utf8.size();
+    if (decoded != (status == EOF)) {
         return false;
     }
+    ids.resize(count);
+    return !decoded || ids == expected;
+}
 
-    // Encoding other bytes
-    for (int i = other_bytes; i > 0; i--) {
-        unsigned char next_byte = encode_other_byte(out, i, num);
-        out << next_byte;
-        if (!out.good()) {
+/**
+ * Check an ASCII fast path: it copies ASCII characters and stops
+ * before the first other one
+ * @param ascii_prefix
+ * @return true, if it works;
+ *      false otherwise
+ */
+bool
+check_ascii_prefix(const ascii_prefix_function ascii_prefix) {
+    for (size_t other = 0; other <= 100; other++) {
+        std::vector<unsigned char> data(100);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<unsigned char>(i);
+        }
+        if (other < data.size()) {
+            data[other] = 0xc3;
+        }
+        std::vector<uint32_t> ids(data.size());
+        size_t count = ascii_prefix(data.data(), data.size(), ids.data());
+        if (count > other) {
             return false;
         }
+        for (size_t i = 0; i < count; i++) {
+            if (ids[i] != data[i]) {
+                return false;
+            }
+        }
     }
     return true;
 }
-  
-bool
-fibonacciToUtf8(const char * inFile, const char * outFile) {
-    std::ifstream fib_file (inFile);
-    if (!fib_file.is_open()) {
-        return false;
-    }
-    char c;
-    size_t bits_read = 0;
 
-    std::ofstream out;
-    out.open(outFile);
-    if (!out.is_open()) {
+/**
+ * Encode text with a code and decode it back
+ * @tparam Code
+ * @param utf8
+ * @return true, if the text is the same and it isn't the same without
+ *      the last byte of the codes;
+ *      false otherwise
+ */
+template <typename Code>
+bool
+same_after_code(const std::string & utf8) {
+    std::string codes, decoded;
+    if (!utf8ToCode<Code>(utf8.data(), utf8.size(), codes)
+        || !codeToUtf8<Code>(codes.data(), codes.size(), decoded) || decoded != utf8) {
         return false;
     }
+    return codes.empty() || !codeToUtf8<Code>(codes.data(), codes.size() - 1, decoded) || decoded != utf8;
+}
 
-    for (;;) {
-        int32_t num = 0;
-        int decode_fibonacci_status = decode_fibonacci(fib_file, c, bits_read,
-                                                       num);
-        if (!decode_fibonacci_status) {
+/**
+ * Check a code on the example files and on all code points (every 7th,
+ * if the code is short enough for that), it's decoder has to reject
+ * numbers above the highest code point and too long codes
+ * @tparam Code
+ * @param all_code_points
+ * @return true, if it works;
+ *      false otherwise
+ */
+template <typename Code>
+bool
+check_code(const bool all_code_points) {
+    std::string text, codes, decoded;
+    for (const char * file_name: { "example/src_0.utf8", "example/src_1.utf8", "example/src_2.utf8",
+                                   "example/src_3.utf8", "example/src_4.utf8" }) {
+        if (!same_after_code<Code>(read_file(file_name))) {
             return false;
         }
-        else if (decode_fibonacci_status == EOF) {
-            break;
+        text += read_file(file_name);
+    }
+    if (!same_after_code<Code>(text) || !same_after_code<Code>("")) {
+        return false;
+    }
+    if (all_code_points) {
+        std::string characters;
+        byte_writer writer = make_writer(characters);
+        for (int32_t id = 0; id <= 0x10ffff; id += 7) {
+            encode_utf8(writer, id);
         }
-
-        if (!encode_utf8(out, num)) {
-            // This will never happen though
+        encode_utf8(writer, 0x10ffff);
+        flush(writer);
+        if (!same_after_code<Code>(characters)) {
             return false;
         }
     }
 
-    out.close();
-    if (!out.good()) {
+    const std::string invalid = read_file("example/src_5.utf8"),
+                      too_big = "\xf4\x90\x80\x80",
+                      too_long(MAX_ENCODED / BITS + 1, '\0');
+    return !utf8ToCode<Code>(invalid.data(), invalid.size(), codes)
+           && utf8ToCode<Code>(too_big.data(), too_big.size(), codes)
+           && !codeToUtf8<Code>(codes.data(), codes.size(), decoded)
+           && !codeToUtf8<Code>((too_long + "\x01").data(), too_long.size() + 1, decoded);
+}
+
+/**
+ * Text to benchmark with
+ */
+struct corpus {
+    std::string name;
+    std::vector<uint32_t> ids;
+};
+
+/**
+ * Generate text from random characters of some ranges
+ * @param name
+ * @param ranges Pairs of the lowest and the highest ID
+ * @param length Number of characters
+ * @return The text
+ */
+corpus
+generate_corpus(const std::string & name,
+                const std::vector<std::pair<uint32_t, uint32_t>> & ranges,
+                const size_t length) {
+    corpus text = { name, {} };
+    text.ids.reserve(length);
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    for (size_t i = 0; i < length; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        uint32_t random = static_cast<uint32_t>(state >> 33);
+        const std::pair<uint32_t, uint32_t> & range = ranges[random % ranges.size()];
+        text.ids.push_back(range.first + (random >> 8) % (range.second - range.first + 1));
+    }
+    return text;
+}
+
+/**
+ * Read characters of UTF-8 file
+ * @param file_name
+ * @param text
+ * @return true, if the file was read;
+ *      false otherwise
+ */
+bool
+read_corpus(const char * file_name, corpus & text) {
+    std::ifstream utf8_file(file_name);
+    if (!utf8_file.is_open()) {
         return false;
     }
+    const std::string utf8 = read_file(file_name);
+    text = { file_name, std::vector<uint32_t>(utf8.size()) };
+    size_t consumed, count;
+    if (!decode_utf8(reinterpret_cast<const unsigned char *>(utf8.data()), utf8.size(),
+                     text.ids.data(), consumed, count) || consumed != utf8.size()) {
+        return false;
+    }
+    text.ids.resize(count);
     return true;
 }
-  
-#ifndef __PROGTEST__
-bool
-identicalFiles(const char * file1, const char * file2) {
-    std::ifstream f1, f2;
-    f1.open(file1), f2.open(file2);
-    for (;;) {
-        char c1, c2;
-        f1.get(c1), f2.get(c2);
-        if (f1.good() != f2.good()) {
-            return false;
+
+/**
+ * Encode characters with Fibonacci code in memory
+ * @param ids
+ * @return The codes, as utf8ToFibonacci() writes them
+ */
+std::string
+encode_corpus(const std::vector<uint32_t> & ids) {
+    std::string encoded;
+    uint64_t pending = 0;
+    size_t pending_bits = 0;
+    for (uint32_t id: ids) {
+        fib_code code = encode_code_point(id);
+        pending |= static_cast<uint64_t>(code.bits) << pending_bits;
+        for (pending_bits += code.length; pending_bits >= BITS; pending_bits -= BITS) {
+            encoded.push_back(static_cast<char>(pending));
+            pending >>= BITS;
         }
-        else if (c1 != c2) {
-            return false;
+    }
+    if (pending_bits) {
+        encoded.push_back(static_cast<char>(pending));
+    }
+    return encoded;
+}
+
+/**
+ * Measure how long a function takes (the best of a few runs)
+ * @param function
+ * @return Seconds
+ */
+template <typename Function>
+double
+measure(Function && function) {
+    double best = 0;
+    for (int i = 0; i < 3; i++) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+        if (!i || took.count() < best) {
+            best = took.count();
         }
+    }
+    return best;
+}
 
-        // We got either an end of file, or file reading failed.
-        // There won't be any errors like the latter on ProgTest
-        // (I'm 99% sure about this),
-        // so I don't even want to spend time detecting them
-        if (!f1.good()) {
-            break;
+/**
+ * Measure a code on all texts: how big it's codes are and how fast
+ * it transcodes
+ * @tparam Code
+ * @param name
+ * @param corpora
+ * @param utf8 The texts in UTF-8
+ */
+template <typename Code>
+void
+benchmark_code(const char * name, const std::vector<corpus> & corpora,
+               const std::vector<std::string> & utf8) {
+    for (size_t i = 0; i < corpora.size(); i++) {
+        std::string codes, decoded;
+        double encode = measure([&]() {
+            utf8ToCode<Code>(utf8[i].data(), utf8[i].size(), codes);
+        });
+        double decode = measure([&]() {
+            codeToUtf8<Code>(codes.data(), codes.size(), decoded);
+        });
+        assert(decoded == utf8[i]);
+        const double chars = corpora[i].ids.empty() ? 1 : corpora[i].ids.size(),
+                     bytes = utf8[i].empty() ? 1 : utf8[i].size(),
+                     megabytes = utf8[i].size() / 1e6;
+        std::printf("%-12s %-10s %9.2f %7.3f %13.1f %13.1f\n", name, corpora[i].name.c_str(),
+                    codes.size() * BITS / chars, codes.size() / bytes, megabytes / encode, megabytes / decode);
+    }
+}
+
+/**
+ * Compare the original and the table-driven encoder and decoder on UTF-8
+ * files (or on generated text, if no files are given) and measure
+ * the whole transcoding
+ * @param files
+ * @param count
+ * @return 0, if everything went ok;
+ *      1, if couldn't read a file
+ */
+int
+benchmark(char * files[], const int count) {
+    const size_t LENGTH = 1 << 22;
+    std::vector<corpus> corpora;
+    for (int i = 0; i < count; i++) {
+        corpora.emplace_back();
+        if (!read_corpus(files[i], corpora.back())) {
+            std::cerr << "Couldn't read " << files[i] << std::endl;
+            return 1;
         }
     }
-    return true;
+    if (corpora.empty()) {
+        corpora.push_back(generate_corpus("ascii", { { 0x20, 0x7e } }, LENGTH));
+        corpora.push_back(generate_corpus("latin", { { 0x20, 0x7e }, { 0xc0, 0x17f } }, LENGTH));
+        corpora.push_back(generate_corpus("cyrillic", { { 0x20, 0x40 }, { 0x410, 0x44f } }, LENGTH));
+        corpora.push_back(generate_corpus("cjk", { { 0x4e00, 0x9fff } }, LENGTH));
+        corpora.push_back(generate_corpus("emoji", { { 0x20, 0x7e }, { 0x1f600, 0x1f64f } }, LENGTH));
+    }
+
+    std::cout << "Encoder:" << std::endl
+              << "corpus        chars   original ns/char   table ns/char   speedup" << std::endl;
+    for (const corpus & text: corpora) {
+        // Sums of the codes, so the compiler can't skip the encoding
+        volatile uint32_t sink = 0;
+        double original = measure([&]() {
+            uint32_t sum = 0;
+            for (uint32_t id: text.ids) {
+                long highest_bit = 0;
+                sum += reference_encode_fibonacci(id + 1, highest_bit) + highest_bit;
+            }
+            sink = sum;
+        });
+        double table = measure([&]() {
+            uint32_t sum = 0;
+            for (uint32_t id: text.ids) {
+                fib_code code = encode_code_point(id);
+                sum += code.bits + code.length;
+            }
+            sink = sum;
+        });
+        const double chars = text.ids.empty() ? 1 : text.ids.size();
+        std::printf("%-10s %8zu %18.2f %15.2f %9.1fx\n", text.name.c_str(), text.ids.size(),
+                    original * 1e9 / chars, table * 1e9 / chars, original / table);
+    }
+
+    // The original decoder reads a stream, the new one is given
+    // the words (reading them is the same for both)
+    std::cout << std::endl << "Decoder:" << std::endl
+              << "corpus        bytes   original MB/s    words MB/s   speedup" << std::endl;
+    for (const corpus & text: corpora) {
+        const std::string encoded = encode_corpus(text.ids);
+        volatile uint32_t sink = 0;
+        double original = measure([&]() {
+            std::istringstream fib_stream(encoded);
+            char c = 0;
+            size_t bits_read = 0;
+            uint32_t sum = 0;
+            for (;;) {
+                int32_t decoded = 0;
+                if (reference_decode_fibonacci(fib_stream, c, bits_read, decoded) != 1) {
+                    break;
+                }
+                sum += decoded;
+            }
+            sink = sum;
+        });
+        double table = measure([&]() {
+            fib_decoder decoder = { 0, 0, 0 };
+            uint32_t sum = 0;
+            for (size_t i = 0; i < encoded.size(); i += WORD_BITS / BITS) {
+                size_t bytes = std::min(encoded.size() - i, WORD_BITS / BITS);
+                uint64_t word = 0;
+                for (size_t j = 0; j < bytes; j++) {
+                    word |= static_cast<uint64_t>(static_cast<unsigned char>(encoded[i + j])) << (j * BITS);
+                }
+                int32_t ids[WORD_BITS / 2];
+                size_t decoded = 0;
+                if (!decode_fibonacci(decoder, word, bytes * BITS, ids, decoded)) {
+                    break;
+                }
+                for (size_t j = 0; j < decoded; j++) {
+                    sum += ids[j];
+                }
+            }
+            sink = sum;
+        });
+        const double megabytes = encoded.size() / 1e6;
+        std::printf("%-10s %8zu %15.1f %12.1f %9.1fx\n", text.name.c_str(), encoded.size(),
+                    megabytes / original, megabytes / table, original / table);
+    }
+
+    // Whole transcoding through the buffered readers and writers
+    std::cout << std::endl << "Transcoding (memory to memory):" << std::endl
+              << "corpus   UTF-8 bytes   to Fibonacci MB/s   to UTF-8 MB/s" << std::endl;
+    std::vector<std::string> texts;
+    for (const corpus & text: corpora) {
+        const std::string encoded = encode_corpus(text.ids);
+        std::string utf8, fib;
+        if (!fibonacciToUtf8(encoded.data(), encoded.size(), utf8)) {
+            std::cerr << "Couldn't decode " << text.name << std::endl;
+            return 1;
+        }
+        texts.push_back(utf8);
+        double to_fibonacci = measure([&]() {
+            utf8ToFibonacci(utf8.data(), utf8.size(), fib);
+        });
+        double to_utf8 = measure([&]() {
+            std::string decoded;
+            fibonacciToUtf8(fib.data(), fib.size(), decoded);
+        });
+        assert(fib == encoded);
+        const double megabytes = utf8.size() / 1e6;
+        std::printf("%-10s %11zu %19.1f %15.1f\n", text.name.c_str(), utf8.size(),
+                    megabytes / to_fibonacci, megabytes / to_utf8);
+    }
+
+    // The other codes through the same UTF-8 decoder and bit writer
+    // and reader (Fibonacci code here decodes a code at a time too)
+    std::cout << std::endl << "Codes (memory to memory, ratio = code bytes / UTF-8 bytes):" << std::endl
+              << "code         corpus     bits/char   ratio   encode MB/s   decode MB/s" << std::endl;
+    benchmark_code<fibonacci_code>("fibonacci", corpora, texts);
+    benchmark_code<elias_gamma_code>("gamma", corpora, texts);
+    benchmark_code<elias_delta_code>("delta", corpora, texts);
+    benchmark_code<elias_omega_code>("omega", corpora, texts);
+    benchmark_code<rice_code<8>>("rice 8", corpora, texts);
+    benchmark_code<rice_code<12>>("rice 12", corpora, texts);
+    benchmark_code<golomb_code<3000>>("golomb 3000", corpora, texts);
+    return 0;
 }
 
 int
-main(void) {
+main(int argc, char * argv[]) {
+    // Run "./hw01 --bench [file.utf8 ...]" to benchmark the encoder and the decoder
+    if (argc > 1 && !std::strcmp(argv[1], "--bench")) {
+        return benchmark(argv + 2, argc - 2);
+    }
+
+    // 0th stage: The table-driven encoder gives the same codes as
+    // the original one (all IDs with up to 3 UTF-8 bytes, some with 4)
+    for (uint32_t id = 0; id < 0x10000; id++) {
+        assert(same_code(id));
+    }
+    for (uint32_t id = 0x10000; id < MAX_ENCODED; id += 61) {
+        assert(same_code(id));
+    }
+    assert(same_code(MAX_ENCODED - 1));
+
+    // 0th stage: The bulk UTF-8 decoder accepts the same characters as
+    // the original one (all of 1 and 2 bytes, 3 and 4 bytes with some
+    // last bytes), after ASCII and cut by the end
+    assert(check_ascii_prefix(ascii_prefix_scalar));
+    assert(check_ascii_prefix(ASCII_PREFIX));
+#ifdef SIMD_X86
+    assert(check_ascii_prefix(ascii_prefix_sse2));
+#endif  /* SIMD_X86 */
+    const std::string ascii(40, 'a');
+    const unsigned char LAST[] = { 0x00, 0x7f, 0x80, 0xbf, 0xc0, 0xff };
+    for (unsigned first = 0; first < 0x100; first++) {
+        for (unsigned second = 0; second < 0x100; second++) {
+            std::string utf8 = ascii;
+            utf8 += static_cast<char>(first);
+            utf8 += static_cast<char>(second);
+            assert(same_utf8(utf8));
+            for (unsigned char third: LAST) {
+                for (unsigned char fourth: LAST) {
+                    if (first >= 0xe0) {
+                        assert(same_utf8(utf8 + static_cast<char>(third) + static_cast<char>(fourth)));
+                        assert(same_utf8(utf8 + static_cast<char>(third) + static_cast<char>(fourth) + ascii));
+                    }
+                }
+            }
+        }
+    }
+
     // 1st stage: UTF-8 to Fibonacci
     assert(utf8ToFibonacci("example/src_0.utf8", "output.fib")
            &&identicalFiles("output.fib", "example/dst_0.fib"));
@@ -483,6 +2498,77 @@ main(void) {
     assert(!fibonacciToUtf8("example/src_12.fib", "output.utf8"));
     assert(!fibonacciToUtf8("example/src_13.fib", "output.utf8"));
 
+    // 4th stage: Memory and streams give the same as the files
+    std::string fib, utf8;
+    assert(utf8ToFibonacci(read_file("example/src_4.utf8").data(),
+                           read_file("example/src_4.utf8").size(), fib)
+           && fib == read_file("example/dst_4.fib"));
+    assert(fibonacciToUtf8(fib.data(), fib.size(), utf8)
+           && utf8 == read_file("example/src_4.utf8"));
+    std::string invalid;
+    assert(!utf8ToFibonacci(read_file("example/src_5.utf8").data(),
+                            read_file("example/src_5.utf8").size(), invalid));
+    std::istringstream fib_stream(read_file("example/src_10.fib"));
+    std::ostringstream utf8_stream;
+    assert(fibonacciToUtf8(fib_stream, utf8_stream)
+           && utf8_stream.str() == read_file("example/dst_10.utf8"));
+
+    // 5th stage: Framed files (here with tiny blocks, cutting characters)
+    // are decoded like raw streams, and their characters can be read
+    // without the blocks before them
+    assert(utf8ToFibonacciFramed("example/src_4.utf8", "output.fib")
+           && fibonacciToUtf8("output.fib", "output.utf8")
+           && identicalFiles("output.utf8", "example/src_4.utf8"));
+    assert(!utf8ToFibonacciFramed("example/src_5.utf8", "output.fib"));
+    assert(!fibonacciFramedCharacters("example/dst_4.fib", 0, 1, utf8));
+    std::string text;
+    for (const char * file_name: { "example/src_1.utf8", "example/src_2.utf8",
+                                   "example/src_3.utf8", "example/src_4.utf8" }) {
+        text += read_file(file_name);
+    }
+    std::vector<std::string> characters;
+    for (size_t i = 0; i < text.size(); i += UTF8_LENGTH[static_cast<unsigned char>(text[i])]) {
+        characters.emplace_back(text, i, UTF8_LENGTH[static_cast<unsigned char>(text[i])]);
+    }
+    for (size_t block_size = 1; block_size <= 9; block_size += 4) {
+        std::string framed;
+        assert(utf8ToFibonacciFramed(text.data(), text.size(), framed, 3, block_size)
+               && fibonacciToUtf8(framed.data(), framed.size(), utf8) && utf8 == text);
+        std::ofstream("output.fib") << framed;
+        for (size_t first = 0; first <= characters.size(); first++) {
+            std::string expected;
+            for (size_t count = 0; first + count <= characters.size(); count++) {
+                assert(fibonacciFramedCharacters("output.fib", first, count, utf8) && utf8 == expected);
+                if (first + count < characters.size()) {
+                    expected += characters[first + count];
+                }
+            }
+            assert(!fibonacciFramedCharacters("output.fib", first, characters.size() - first + 1, utf8));
+        }
+    }
+
+
+    // 6th stage: Every code decodes what it encodes, Fibonacci code
+    // gives the same files as before
+    for (int i = 1; i <= 4; i++) {
+        const std::string name = "example/src_" + std::to_string(i) + ".utf8",
+                          fib_name = "example/dst_" + std::to_string(i) + ".fib";
+        assert(utf8ToCode<fibonacci_code>(read_file(name.c_str()).data(), read_file(name.c_str()).size(), fib)
+               && fib == read_file(fib_name.c_str()));
+    }
+    fib = read_file("example/src_10.fib");
+    assert(codeToUtf8<fibonacci_code>(fib.data(), fib.size(), utf8)
+           && utf8 == read_file("example/dst_10.utf8"));
+    assert(check_code<fibonacci_code>(true));
+    assert(check_code<elias_gamma_code>(true));
+    assert(check_code<elias_delta_code>(true));
+    assert(check_code<elias_omega_code>(true));
+    assert(check_code<rice_code<12>>(true));
+    assert(check_code<golomb_code<3000>>(true));
+    assert(check_code<rice_code<0>>(false));
+    assert(check_code<golomb_code<3>>(false));
+    assert(check_code<golomb_code<MAX_ENCODED>>(true));
+
     return 0;
 }
 #endif  /* __PROGTEST__ */
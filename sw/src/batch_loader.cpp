@@ -0,0 +1,361 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+#include "batch_loader.hpp"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+Batch_Loader::Batch_Loader(const unsigned queue_depth)
+    : m_QUEUE_DEPTH(queue_depth) {
+    // Allows comparing both ways of loading
+    if (std::getenv("NOTEPAD_NO_IO_URING") || !setup_ring()) {
+        m_Ring_Fd = -1;
+    }
+}
+
+Batch_Loader::~Batch_Loader() {
+    release_ring();
+}
+
+void Batch_Loader::release_ring() {
+#ifdef HAVE_IO_URING
+    if (m_SQEs) {
+        munmap(m_SQEs, m_SQEs_Size);
+    }
+    if (m_CQ_Ring && m_CQ_Ring != m_SQ_Ring) {
+        munmap(m_CQ_Ring, m_CQ_Ring_Size);
+    }
+    if (m_SQ_Ring) {
+        munmap(m_SQ_Ring, m_SQ_Ring_Size);
+    }
+    if (m_Ring_Fd >= 0) {
+        close(m_Ring_Fd);
+    }
+#endif
+    m_SQEs = m_CQ_Ring = m_SQ_Ring = nullptr;
+    m_Ring_Fd = -1;
+    m_To_Submit = 0;
+}
+
+bool Batch_Loader::uses_io_uring() const {
+    return m_Ring_Fd >= 0;
+}
+
+bool Batch_Loader::setup_ring() {
+#ifdef HAVE_IO_URING
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    long fd = syscall(__NR_io_uring_setup, m_QUEUE_DEPTH, &params);
+    if (fd < 0) {
+        return false;
+    }
+    m_Ring_Fd = static_cast<int>(fd);
+
+    m_SQ_Ring_Size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_CQ_Ring_Size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        // Both rings are in a single mapping then
+        m_SQ_Ring_Size = m_CQ_Ring_Size = std::max(m_SQ_Ring_Size, m_CQ_Ring_Size);
+    }
+    m_SQ_Ring = mmap(nullptr, m_SQ_Ring_Size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, m_Ring_Fd, IORING_OFF_SQ_RING);
+    if (m_SQ_Ring == MAP_FAILED) {
+        m_SQ_Ring = nullptr;
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        m_CQ_Ring = m_SQ_Ring;
+    }
+    else {
+        m_CQ_Ring = mmap(nullptr, m_CQ_Ring_Size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, m_Ring_Fd, IORING_OFF_CQ_RING);
+        if (m_CQ_Ring == MAP_FAILED) {
+            m_CQ_Ring = nullptr;
+            return false;
+        }
+    }
+    m_SQEs_Size = params.sq_entries * sizeof(io_uring_sqe);
+    m_SQEs = mmap(nullptr, m_SQEs_Size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, m_Ring_Fd, IORING_OFF_SQES);
+    if (m_SQEs == MAP_FAILED) {
+        m_SQEs = nullptr;
+        return false;
+    }
+
+    char * sq = static_cast<char *>(m_SQ_Ring), * cq = static_cast<char *>(m_CQ_Ring);
+    m_SQ_Head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    m_SQ_Tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_SQ_Mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_SQ_Array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    m_CQ_Head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_CQ_Tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_CQ_Mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_CQEs = cq + params.cq_off.cqes;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Batch_Loader::load(const std::vector<std::string> & paths,
+                        const std::vector<size_t> & size_hints,
+                        const Callback & on_loaded) {
+    if (uses_io_uring()) {
+        load_with_ring(paths, size_hints, on_loaded);
+    }
+    else {
+        load_sequentially(paths, on_loaded);
+    }
+}
+
+void Batch_Loader::load_sequentially(const std::vector<std::string> & paths,
+                                     const Callback & on_loaded) const {
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::ifstream file(paths.at(i), std::ios::binary);
+        std::string content;
+        if (file.is_open()) {
+            content.assign(std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>());
+        }
+        bool ok = file.is_open() && !file.bad();
+        on_loaded(i, ok ? std::move(content) : std::string(), ok);
+    }
+}
+
+void Batch_Loader::queue(const uint8_t opcode, const int fd, const void * addr,
+                         const unsigned len, const uint64_t offset,
+                         const uint32_t op_flags, const uint64_t user_data) {
+#ifdef HAVE_IO_URING
+    const unsigned tail = *m_SQ_Tail + m_To_Submit, index = tail & *m_SQ_Mask;
+    io_uring_sqe * sqe = static_cast<io_uring_sqe *>(m_SQEs) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(addr);
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->open_flags = op_flags;
+    sqe->user_data = user_data;
+    m_SQ_Array[index] = index;
+    m_To_Submit++;
+#else
+    (void) opcode, (void) fd, (void) addr, (void) len,
+    (void) offset, (void) op_flags, (void) user_data;
+#endif
+}
+
+bool Batch_Loader::submit_and_wait() {
+#ifdef HAVE_IO_URING
+    // Kernel must see the entries before the new tail
+    __atomic_store_n(m_SQ_Tail, *m_SQ_Tail + m_To_Submit, __ATOMIC_RELEASE);
+    const unsigned to_submit = m_To_Submit;
+    m_To_Submit = 0;
+    for (;;) {
+        long ret = syscall(__NR_io_uring_enter, m_Ring_Fd, to_submit, 1,
+                           IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret >= 0) {
+            return true;
+        }
+        else if (errno != EINTR) {
+            return false;
+        }
+    }
+#else
+    return false;
+#endif
+}
+
+void Batch_Loader::load_with_ring(const std::vector<std::string> & paths,
+                                  const std::vector<size_t> & size_hints,
+                                  const Callback & on_loaded) {
+#ifdef HAVE_IO_URING
+    enum Stage : uint64_t { OPEN = 0, READ = 1, CLOSE = 2 };
+    struct Job {
+        size_t m_Index = 0;
+        // -1 before the file is opened and while it's being closed
+        int m_Fd = -1;
+        std::string m_Buffer;
+        size_t m_Done = 0;
+        // Whether the file was passed to on_loaded
+        bool m_Reported = false;
+    };
+    // Every job has at most one operation in flight, so a number
+    // of jobs is bounded by the queue depth
+    std::vector<Job> jobs(m_QUEUE_DEPTH);
+    std::vector<size_t> free_jobs;
+    for (size_t i = m_QUEUE_DEPTH; i > 0; i--) {
+        free_jobs.push_back(i - 1);
+    }
+
+    auto queue_read = [&](const size_t slot) {
+        Job & job = jobs.at(slot);
+        if (job.m_Done == job.m_Buffer.size()) {
+            job.m_Buffer.resize(std::max<size_t>(job.m_Buffer.size() * 2, 4096));
+        }
+        queue(IORING_OP_READ, job.m_Fd, job.m_Buffer.data() + job.m_Done,
+              static_cast<unsigned>(job.m_Buffer.size() - job.m_Done),
+              job.m_Done, 0, slot << 2 | READ);
+    };
+    auto finish = [&](const size_t slot, const bool ok) {
+        Job & job = jobs.at(slot);
+        job.m_Buffer.resize(ok ? job.m_Done : 0);
+        on_loaded(job.m_Index, std::move(job.m_Buffer), ok);
+        job.m_Buffer = std::string();
+        job.m_Reported = true;
+        if (job.m_Fd >= 0) {
+            queue(IORING_OP_CLOSE, job.m_Fd, nullptr, 0, 0, 0, slot << 2 | CLOSE);
+            job.m_Fd = -1;
+        }
+        else {
+            free_jobs.push_back(slot);
+        }
+    };
+
+    // Every operation taken by the kernel gets a completion
+    const unsigned first_submitted = __atomic_load_n(m_SQ_Head, __ATOMIC_ACQUIRE);
+    unsigned completed = 0;
+
+    size_t next = 0;
+    while (next < paths.size() || free_jobs.size() < jobs.size()) {
+        while (next < paths.size() && free_jobs.size()) {
+            const size_t slot = free_jobs.back();
+            free_jobs.pop_back();
+            Job & job = jobs.at(slot);
+            job.m_Index = next;
+            job.m_Fd = -1;
+            job.m_Done = 0;
+            job.m_Reported = false;
+            // One more byte, so the buffer doesn't have to grow
+            // for the empty read at the end of the file
+            job.m_Buffer.resize((next < size_hints.size() ? size_hints.at(next) : 0) + 1);
+            queue(IORING_OP_OPENAT, AT_FDCWD, paths.at(next).c_str(), 0, 0,
+                  O_RDONLY | O_CLOEXEC, slot << 2 | OPEN);
+            next++;
+        }
+
+        if (!submit_and_wait()) {
+            // The ring is unusable. Operations in flight can still write
+            // to the buffers, so their completions are waited for first
+            // (if even that fails, the buffers are never freed)
+            bool drained = true;
+            unsigned head = *m_CQ_Head;
+            while (completed != __atomic_load_n(m_SQ_Head, __ATOMIC_ACQUIRE) - first_submitted) {
+                const unsigned tail = __atomic_load_n(m_CQ_Tail, __ATOMIC_ACQUIRE);
+                if (head == tail) {
+                    long ret = syscall(__NR_io_uring_enter, m_Ring_Fd, 0, 1,
+                                       IORING_ENTER_GETEVENTS, nullptr, 0);
+                    if (ret < 0 && errno != EINTR) {
+                        drained = false;
+                        break;
+                    }
+                    continue;
+                }
+                const io_uring_cqe & cqe = static_cast<io_uring_cqe *>(m_CQEs)[head & *m_CQ_Mask];
+                if ((cqe.user_data & 3) == OPEN && cqe.res >= 0) {
+                    jobs.at(cqe.user_data >> 2).m_Fd = cqe.res;
+                }
+                head++;
+                completed++;
+                __atomic_store_n(m_CQ_Head, head, __ATOMIC_RELEASE);
+            }
+            release_ring();
+
+            // Files in flight and the rest are loaded the ordinary way
+            std::vector<size_t> indices;
+            for (size_t slot = 0; slot < jobs.size(); slot++) {
+                const Job & job = jobs.at(slot);
+                if (std::find(free_jobs.begin(), free_jobs.end(), slot) == free_jobs.end() && !job.m_Reported) {
+                    indices.push_back(job.m_Index);
+                }
+                if (drained && job.m_Fd >= 0) {
+                    close(job.m_Fd);
+                }
+            }
+            if (!drained) {
+                // Leaked on purpose, the kernel may still write to them
+                new std::vector<Job>(std::move(jobs));
+            }
+            for (; next < paths.size(); next++) {
+                indices.push_back(next);
+            }
+            std::vector<std::string> rest;
+            for (const size_t x: indices) {
+                rest.push_back(paths.at(x));
+            }
+            load_sequentially(rest, [&](size_t index, std::string && content, bool ok) {
+                on_loaded(indices.at(index), std::move(content), ok);
+            });
+            return;
+        }
+
+        unsigned head = *m_CQ_Head;
+        const unsigned tail = __atomic_load_n(m_CQ_Tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const io_uring_cqe & cqe = static_cast<io_uring_cqe *>(m_CQEs)[head & *m_CQ_Mask];
+            const size_t slot = cqe.user_data >> 2;
+            const int res = cqe.res;
+            Job & job = jobs.at(slot);
+            completed++;
+            switch (cqe.user_data & 3) {
+                case OPEN:
+                    if (res == -EINVAL || res == -EOPNOTSUPP) {
+                        // Kernel doesn't support the operation
+                        load_sequentially({ paths.at(job.m_Index) },
+                                          [&](size_t, std::string && content, bool ok) {
+                            on_loaded(job.m_Index, std::move(content), ok);
+                        });
+                        free_jobs.push_back(slot);
+                        break;
+                    }
+                    else if (res < 0) {
+                        finish(slot, false);
+                        break;
+                    }
+                    job.m_Fd = res;
+                    queue_read(slot);
+                    break;
+                case READ:
+                    if (res == -EINTR || res == -EAGAIN) {
+                        queue_read(slot);
+                        break;
+                    }
+                    else if (res < 0) {
+                        finish(slot, false);
+                        break;
+                    }
+                    // Reads can be short before the end (e.g. on network
+                    // file systems), only an empty one means the end
+                    if (!res) {
+                        finish(slot, true);
+                        break;
+                    }
+                    job.m_Done += static_cast<size_t>(res);
+                    queue_read(slot);
+                    break;
+                case CLOSE:
+                    free_jobs.push_back(slot);
+                    break;
+            }
+        }
+        __atomic_store_n(m_CQ_Head, head, __ATOMIC_RELEASE);
+    }
+#else
+    (void) size_hints;
+    load_sequentially(paths, on_loaded);
+#endif
+}
@@ -0,0 +1,123 @@
+#ifndef BATCH_LOADER_HPP
+#define BATCH_LOADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+/**
+ * Loads many small files at once.
+ *
+ * On Linux uses io_uring: opens, reads and closes of up to "m_QUEUE_DEPTH"
+ * files are queued together, so a scan doesn't wait for every file one
+ * by one. If io_uring isn't available (old kernel, seccomp, other OS),
+ * files are read one by one with std::ifstream. The fallback can be forced
+ * by setting an environment variable NOTEPAD_NO_IO_URING.
+ */
+class Batch_Loader {
+    public:
+        /**
+         * Called for every loaded file, in order of completion.
+         *
+         * @param index   An index of the file in the requested list.
+         * @param content Content of the file.
+         * @param ok      false, if the file couldn't be read
+         *                ("content" is empty then).
+         */
+        using Callback = std::function<void (size_t index, std::string && content, bool ok)>;
+
+        explicit Batch_Loader(const unsigned queue_depth = 64);
+        ~Batch_Loader();
+
+        Batch_Loader(const Batch_Loader &) = delete;
+        Batch_Loader & operator = (const Batch_Loader &) = delete;
+
+        /**
+         * Load files.
+         *
+         * @param paths       Paths to files to load.
+         * @param size_hints  Expected sizes of the files (may be empty),
+         *                    used to allocate the buffers.
+         * @param on_loaded   A callback for every file.
+         */
+        void load(const std::vector<std::string> & paths,
+                  const std::vector<size_t> & size_hints,
+                  const Callback & on_loaded);
+
+        /**
+         * Check whether or not io_uring is used.
+         *
+         * @return true, if is;
+         *      false, if fell back to std::ifstream.
+         */
+        bool uses_io_uring() const;
+
+    private:
+        const unsigned m_QUEUE_DEPTH;
+
+        // io_uring file descriptor and it's mapped rings (-1 / nullptr,
+        // if io_uring isn't available).
+        int m_Ring_Fd = -1;
+        void * m_SQ_Ring = nullptr, * m_CQ_Ring = nullptr, * m_SQEs = nullptr;
+        size_t m_SQ_Ring_Size = 0, m_CQ_Ring_Size = 0, m_SQEs_Size = 0;
+        unsigned * m_SQ_Head = nullptr, * m_SQ_Tail = nullptr,
+                 * m_SQ_Mask = nullptr, * m_SQ_Array = nullptr,
+                 * m_CQ_Head = nullptr, * m_CQ_Tail = nullptr,
+                 * m_CQ_Mask = nullptr;
+        void * m_CQEs = nullptr;
+        unsigned m_To_Submit = 0;
+
+        /**
+         * Try to set up io_uring.
+         *
+         * @return true, if succeeded;
+         *      false otherwise.
+         */
+        bool setup_ring();
+
+        /**
+         * Unmap the rings and close io_uring (files are loaded
+         * with std::ifstream afterwards).
+         */
+        void release_ring();
+
+        /**
+         * Load files one by one with std::ifstream.
+         */
+        void load_sequentially(const std::vector<std::string> & paths,
+                               const Callback & on_loaded) const;
+
+        /**
+         * Load files with io_uring.
+         */
+        void load_with_ring(const std::vector<std::string> & paths,
+                            const std::vector<size_t> & size_hints,
+                            const Callback & on_loaded);
+
+        /**
+         * Queue an operation. Submission queue must have a free entry.
+         *
+         * @param opcode    IORING_OP_*.
+         * @param fd        A file descriptor (or a dirfd for openat).
+         * @param addr      A buffer (or a path for openat).
+         * @param len       A length of the buffer.
+         * @param offset    An offset in the file.
+         * @param op_flags  Flags of the operation (e.g. open flags).
+         * @param user_data An identifier returned in the completion.
+         */
+        void queue(const uint8_t opcode, const int fd, const void * addr,
+                   const unsigned len, const uint64_t offset,
+                   const uint32_t op_flags, const uint64_t user_data);
+
+        /**
+         * Submit queued operations and wait for at least one completion.
+         *
+         * @return true, if succeeded;
+         *      false otherwise.
+         */
+        bool submit_and_wait();
+};
+
+#endif  // BATCH_LOADER_HPP
@@ -0,0 +1,233 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <ostream>
+#include <stdexcept>
+#include <filesystem>
+#include <algorithm>
+#include "bulk_importer.hpp"
+#include "note_storage.hpp"
+#include "content_hash.hpp"
+#include "notes/note.hpp"
+
+namespace {
+    /**
+     * Run "work" for indexes [0; cnt) in parallel.
+     */
+    template <typename Work>
+    void run_parallel(const size_t cnt, const unsigned threads, Work && work) {
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            for (size_t i = next++; i < cnt; i = next++) {
+                work(i);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads && i < cnt; i++) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto & x: workers) {
+            x.join();
+        }
+    }
+}
+
+Bulk_Importer::Bulk_Importer(Note_Storage & notes_store)
+    : m_Notes_Store(notes_store) { }
+
+void Bulk_Importer::load_known(const unsigned threads) {
+    std::vector<size_t> sizes;
+    const std::vector<std::string> paths = m_Notes_Store.list_note_files("", sizes);
+    std::vector<uint64_t> hashes(paths.size());
+    std::vector<char> ok(paths.size(), false);
+    run_parallel(paths.size(), threads, [&](size_t i) {
+        std::string body, timestamp;
+        try {
+            if (Note_Storage::split_note_text(m_Notes_Store.read_text(paths.at(i)), body, timestamp)) {
+                hashes.at(i) = content_hash(body);
+                ok.at(i) = true;
+            }
+        }
+        catch (const std::runtime_error &) {
+            // Broken notes can't be duplicates of anything
+        }
+    });
+
+    m_Known.clear();
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (ok.at(i)) {
+            m_Known[hashes.at(i)].push_back(paths.at(i));
+        }
+    }
+}
+
+std::string Bulk_Importer::find_known(const uint64_t hash, const std::string & body,
+                                      const std::vector<std::pair<std::string, std::string>> & pending) const {
+    auto it = m_Known.find(hash);
+    if (it == m_Known.end()) {
+        return "";
+    }
+    // Bodies are compared as well, so a hash collision can't drop a note
+    for (const auto & path: it->second) {
+        std::string text, other_body, timestamp;
+        auto in_batch = std::find_if(pending.begin(), pending.end(),
+                                     [&](const auto & x) { return x.first == path; });
+        try {
+            text = in_batch != pending.end() ? in_batch->second : m_Notes_Store.read_text(path);
+        }
+        catch (const std::runtime_error &) {
+            continue;
+        }
+        if (Note_Storage::split_note_text(text, other_body, timestamp) && other_body == body) {
+            return path;
+        }
+    }
+    return "";
+}
+
+std::vector<Import_Result> Bulk_Importer::import(const std::string & source, const std::string & dir,
+                                                 unsigned threads) {
+    namespace fs = std::filesystem;
+
+    if (!fs::is_directory(source)) {
+        throw std::runtime_error("Bulk_Importer::import(): Source isn't a directory.");
+    }
+    if (dir.find('.') != std::string::npos) {
+        throw std::runtime_error("Bulk_Importer::import(): Used forbidden character in directory.");
+    }
+    if (!threads) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    load_known(threads);
+
+    // Files to import and directories where to save them
+    std::vector<std::string> paths, target_dirs;
+    for (auto it = fs::recursive_directory_iterator(source);
+         it != fs::recursive_directory_iterator(); it++) {
+        const auto & entry = *it;
+        if (entry.path().filename().string().front() == '.') {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        std::string target = dir;
+        while (target.size() && target.back() == '/') {
+            target.pop_back();
+        }
+        std::string sub_dir = entry.path().parent_path().lexically_relative(source).string();
+        if (sub_dir != ".") {
+            std::replace(sub_dir.begin(), sub_dir.end(), '.', '_');
+            target += (target.size() ? "/" : "") + sub_dir;
+        }
+        if (target.size()) {
+            target.push_back('/');
+        }
+        paths.push_back(entry.path().string());
+        target_dirs.push_back(target);
+    }
+
+    std::vector<Import_Result> results(paths.size());
+    std::vector<std::string> texts;
+    for (size_t begin = 0; begin < paths.size(); begin += m_BATCH_SIZE) {
+        const size_t end = std::min(begin + m_BATCH_SIZE, paths.size());
+        texts.assign(end - begin, "");
+
+        // Parsing and validating
+        run_parallel(end - begin, threads, [&](size_t i) {
+            Import_Result & result = results.at(begin + i);
+            result.m_Path = paths.at(begin + i);
+            try {
+                std::unique_ptr<Note> note = m_Notes_Store.read(result.m_Path, true);
+                // Creation timestamp is a file name
+                const std::string & name = note->get_file_name();
+                if (name.empty() || name.front() == '.' || name.find('/') != std::string::npos) {
+                    throw std::runtime_error("Bulk_Importer::import(): Invalid creation timestamp.");
+                }
+                std::ostringstream os;
+                note->save(os);
+                texts.at(i) = os.str();
+            }
+            catch (const std::runtime_error & e) {
+                result.m_Status = "failed";
+                result.m_Message = e.what();
+            }
+        });
+
+        // Deduplicating and choosing file names
+        std::vector<std::pair<std::string, std::string>> pending;
+        std::set<std::string> pending_paths;
+        std::vector<size_t> pending_results;
+        for (size_t i = 0; i < texts.size(); i++) {
+            Import_Result & result = results.at(begin + i);
+            std::string body, timestamp;
+            if (result.m_Status == "failed") {
+                continue;
+            }
+            if (!Note_Storage::split_note_text(texts.at(i), body, timestamp)) {
+                result.m_Status = "failed";
+                result.m_Message = "Bulk_Importer::import(): Invalid note.";
+                continue;
+            }
+            const uint64_t hash = content_hash(body);
+            std::string duplicate = find_known(hash, body, pending);
+            if (duplicate.size()) {
+                result.m_Status = "duplicate";
+                result.m_Destination = duplicate;
+                continue;
+            }
+
+            std::string destination = target_dirs.at(begin + i) + timestamp;
+            if (pending_paths.count(destination)
+                || m_Notes_Store.note_exists(destination)) {
+                timestamp = m_Notes_Store.get_file_timestamp();
+                destination = target_dirs.at(begin + i) + timestamp;
+                // Putting the new timestamp in place of the old one
+                size_t type_end = body.find('\n');
+                texts.at(i) = body.substr(0, type_end + 1) + '\n' + timestamp + "\n\n" + body.substr(type_end + 1);
+            }
+            result.m_Status = "imported";
+            result.m_Destination = destination;
+            pending.emplace_back(destination, std::move(texts.at(i)));
+            pending_paths.insert(destination);
+            pending_results.push_back(begin + i);
+            m_Known[hash].push_back(destination);
+        }
+
+        try {
+            m_Notes_Store.write_batch(pending);
+        }
+        catch (const std::runtime_error & e) {
+            // Nothing of the batch was written
+            for (const auto & x: pending_results) {
+                results.at(x).m_Status = "failed";
+                results.at(x).m_Message = e.what();
+            }
+        }
+    }
+    return results;
+}
+
+void Bulk_Importer::write_summary(std::ostream & os, const std::vector<Import_Result> & results) {
+    std::map<std::string, size_t> statuses;
+    for (const auto & x: results) {
+        statuses[x.m_Status]++;
+        if (x.m_Status == "failed") {
+            os << x.m_Path << '\n'
+               << "\tERROR: " << x.m_Message << '\n' << '\n';
+        }
+    }
+    os << "INFO: Imported " << statuses["imported"] << " of " << results.size() << " notes, "
+       << statuses["duplicate"] << " duplicates skipped, "
+       << statuses["failed"] << " failed." << std::endl;
+}
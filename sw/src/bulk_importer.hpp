@@ -0,0 +1,94 @@
+#ifndef BULK_IMPORTER_HPP
+#define BULK_IMPORTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <ostream>
+#include "note_storage.hpp"
+
+/**
+ * A result of importing one file.
+ */
+struct Import_Result {
+    // A path of the imported file.
+    std::string m_Path;
+    // "imported", "duplicate" (the same note is already in the storage)
+    // or "failed".
+    std::string m_Status;
+    // Where the note was saved (relative to storage's root) or what note
+    // it's a duplicate of.
+    std::string m_Destination;
+    std::string m_Message;
+};
+
+/**
+ * Imports whole directory trees of notes (e.g. someone else's archive)
+ * into a Note_Storage.
+ *
+ * Files are parsed and validated in parallel, notes already in the storage
+ * (or imported earlier in the same run) are skipped and the rest is written
+ * with Note_Storage::write_batch(), "m_BATCH_SIZE" notes at a time.
+ */
+class Bulk_Importer {
+    private:
+        // How many notes are parsed and written at once.
+        static constexpr size_t m_BATCH_SIZE = 1024;
+
+        Note_Storage & m_Notes_Store;
+        // Body hash -> paths of notes with it (relative to storage's root).
+        std::map<uint64_t, std::vector<std::string>> m_Known;
+
+        /**
+         * Hash bodies of all notes already in the storage.
+         *
+         * @param threads Amount of worker threads.
+         */
+        void load_known(const unsigned threads);
+
+        /**
+         * Find a note with the same body.
+         *
+         * @param  hash    A hash of the body.
+         * @param  body    The body.
+         * @param  pending Notes of the current batch, not written yet.
+         * @return A path of the note, empty if there is none.
+         */
+        std::string find_known(const uint64_t hash, const std::string & body,
+                               const std::vector<std::pair<std::string, std::string>> & pending) const;
+
+    public:
+        explicit Bulk_Importer(Note_Storage & notes_store);
+
+        /**
+         * Import all files in a directory, including sub-directories.
+         *
+         * Sub-directories are kept ('.' in their names is replaced by '_',
+         * as it's forbidden in the storage). A note whose file name is taken
+         * gets a new one.
+         *
+         * Throws std::runtime_error if "source" isn't a directory
+         * or if a batch couldn't be written.
+         *
+         * @param  source  A directory to import.
+         * @param  dir     A directory where to import, relative to storage's root.
+         * @param  threads Amount of worker threads (0 for all cores).
+         * @return Results in the order of the files.
+         */
+        std::vector<Import_Result> import(const std::string & source, const std::string & dir,
+                                          unsigned threads = 0);
+
+        /**
+         * Write a summary of an import: counts and every failed file
+         * with the reason.
+         *
+         * @param os      A stream where to write the summary.
+         * @param results Results of import().
+         */
+        static void write_summary(std::ostream & os, const std::vector<Import_Result> & results);
+};
+
+#endif  // BULK_IMPORTER_HPP
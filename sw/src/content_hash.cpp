@@ -0,0 +1,48 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "content_hash.hpp"
+
+uint64_t content_hash(const std::string & data) {
+    const uint64_t M = 0xc6a4a7935bd1e995ULL;
+    const int R = 47;
+    uint64_t hash = 0x8445d61a4e774912ULL ^ (data.size() * M);
+
+    size_t pos = 0;
+    for (; pos + 8 <= data.size(); pos += 8) {
+        // Little-endian on every machine, hashes are saved (names
+        // of shared notes, sync manifests); compilers turn it to one load
+        uint64_t block = 0;
+        for (size_t i = 8; i > 0; i--) {
+            block = block << 8 | static_cast<unsigned char>(data[pos + i - 1]);
+        }
+        block *= M;
+        block ^= block >> R;
+        block *= M;
+        hash ^= block;
+        hash *= M;
+    }
+    // Remaining 0-7 bytes
+    uint64_t tail = 0;
+    for (size_t i = data.size(); i > pos; i--) {
+        tail = tail << 8 | static_cast<unsigned char>(data.at(i - 1));
+    }
+    if (pos < data.size()) {
+        hash ^= tail;
+        hash *= M;
+    }
+
+    hash ^= hash >> R;
+    hash *= M;
+    hash ^= hash >> R;
+    return hash;
+}
+
+std::string hash_to_hex(const uint64_t hash) {
+    const char DIGITS[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (size_t i = 0; i < hex.size(); i++) {
+        hex.at(hex.size() - 1 - i) = DIGITS[(hash >> (4 * i)) & 0xf];
+    }
+    return hex;
+}
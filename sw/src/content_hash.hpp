@@ -0,0 +1,27 @@
+#ifndef CONTENT_HASH_HPP
+#define CONTENT_HASH_HPP
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Compute a fast non-cryptographic 64-bit hash of the data.
+ *
+ * Processes 8 bytes at a time with a multiply-xorshift mix
+ * (MurmurHash64A-style), so it's cheap enough to hash whole archives.
+ * Blocks are read as little-endian, so hashes are the same on every machine.
+ *
+ * @param  data Data to hash.
+ * @return A hash.
+ */
+uint64_t content_hash(const std::string & data);
+
+/**
+ * Format a hash as 16 hexadecimal digits (e.g. for file names).
+ *
+ * @param  hash A hash.
+ * @return Hexadecimal representation.
+ */
+std::string hash_to_hex(const uint64_t hash);
+
+#endif  // CONTENT_HASH_HPP
@@ -0,0 +1,174 @@
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <memory>
+#include <fstream>
+#include <ostream>
+#include <vector>
+#include <utility>
+#include <cstring>
+#include "export.hpp"
+#include "csv_export.hpp"
+#include "record_writer.hpp"
+#include "../timestamp.hpp"
+#include "../trace.hpp"
+
+namespace {
+    // Columns of the CSV file, in order
+    const char * const COLUMNS[] = {"type", "name", "tags", "creation_date",
+                                    "items", "deadlines", "text", "changelog"};
+    const size_t COLUMNS_CNT = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+
+    /**
+     * Writes a record as a CSV row.
+     *
+     * Fields may come in any order, so the row is collected into per-column
+     * buffers first. The buffers are owned by CSV_Export and kept between
+     * the records, so once they grow enough, no more allocations are needed.
+     */
+    class CSV_Record_Writer: public Record_Writer {
+        private:
+            std::ostream & m_OS;
+            std::vector<std::string> & m_Cells;
+
+            /**
+             * Get a buffer of a column.
+             *
+             * @param  key A name of the column.
+             * @return A buffer, nullptr if there is no such column.
+             */
+            std::string * cell(const char * key) {
+                for (size_t i = 0; i < COLUMNS_CNT; i++) {
+                    if (!std::strcmp(COLUMNS[i], key)) {
+                        return &m_Cells[i];
+                    }
+                }
+                return nullptr;
+            }
+
+            /**
+             * Write a cell, quoted only if needed.
+             */
+            void write_cell(const std::string & value) {
+                if (value.find_first_of(",\"\r\n") == std::string::npos) {
+                    m_OS.write(value.data(), value.size());
+                    return;
+                }
+
+                m_OS.put('"');
+                size_t run = 0, quote;
+                while ((quote = value.find('"', run)) != std::string::npos) {
+                    // Doubling quotes
+                    m_OS.write(value.data() + run, quote + 1 - run);
+                    m_OS.put('"');
+                    run = quote + 1;
+                }
+                m_OS.write(value.data() + run, value.size() - run);
+                m_OS.put('"');
+            }
+
+        public:
+            CSV_Record_Writer(std::ostream & os, std::vector<std::string> & cells)
+                : m_OS(os), m_Cells(cells) {
+                m_Cells.resize(COLUMNS_CNT);
+            }
+
+            virtual void begin_record() override {
+                for (auto & x: m_Cells) {
+                    x.clear();
+                }
+            }
+
+            virtual void end_record() override {
+                for (size_t i = 0; i < COLUMNS_CNT; i++) {
+                    if (i) {
+                        m_OS.put(',');
+                    }
+                    write_cell(m_Cells[i]);
+                }
+                // RFC 4180 line break
+                m_OS.write("\r\n", 2);
+            }
+
+            virtual void string_field(const char * key, std::string_view value) override {
+                if (std::string * x = cell(key)) {
+                    x->assign(value.data(), value.size());
+                }
+            }
+
+            virtual void list_field(const char * key, const std::vector<std::string> & values) override {
+                std::string * x = cell(key);
+                if (!x) {
+                    return;
+                }
+                for (size_t i = 0; i < values.size(); i++) {
+                    if (i) {
+                        x->push_back('\n');
+                    }
+                    x->append(values[i]);
+                }
+            }
+
+            virtual void pair_fields(const char * first_key, const char * second_key,
+                                     const std::vector<std::pair<std::string, std::string>> & values) override {
+                std::string * first = cell(first_key), * second = cell(second_key);
+                for (size_t i = 0; i < values.size(); i++) {
+                    if (first) {
+                        if (i) {
+                            first->push_back('\n');
+                        }
+                        first->append(values[i].first);
+                    }
+                    if (second) {
+                        if (i) {
+                            second->push_back('\n');
+                        }
+                        second->append(values[i].second);
+                    }
+                }
+            }
+
+            virtual void changelog_field(const char * key,
+                                         const std::vector<std::pair<Timestamp, std::string>> & changes) override {
+                std::string * x = cell(key);
+                if (!x) {
+                    return;
+                }
+                char date[Timestamp::m_TEXT_SIZE];
+                for (size_t i = 0; i < changes.size(); i++) {
+                    if (i) {
+                        x->push_back('\n');
+                    }
+                    x->append(changes[i].first.view(date));
+                    x->push_back('\t');
+                    x->append(changes[i].second);
+                }
+            }
+    };
+}
+
+CSV_Export::CSV_Export(const std::string & path)
+    : Export(path) { }
+
+void CSV_Export::begin(std::ofstream & os) const {
+    for (size_t i = 0; i < COLUMNS_CNT; i++) {
+        if (i) {
+            os.put(',');
+        }
+        os << COLUMNS[i];
+    }
+    os.write("\r\n", 2);
+}
+
+void CSV_Export::operator () (const std::unique_ptr<Note> & to_export,
+                              std::ofstream & os) const {
+    Trace_Scope trace("CSV_Export::operator()");
+    const std::streampos begin = Trace::enabled() ? os.tellp() : std::streampos(0);
+    CSV_Record_Writer writer(os, m_Cells);
+    writer.begin_record();
+    to_export->write_record(writer);
+    writer.end_record();
+    if (Trace::enabled()) {
+        Trace::add_bytes_written(static_cast<uint64_t>(os.tellp() - begin));
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef CSV_EXPORT_HPP
+#define CSV_EXPORT_HPP
+
+#include <string>
+#include <memory>
+#include <fstream>
+#include <vector>
+#include "export.hpp"
+#include "../notes/note.hpp"
+
+/**
+ * Export notes to CSV file format (RFC 4180, one row per note).
+ *
+ * Lists (tags, items, deadlines) are stored in one cell, with elements
+ * separated by newlines. Changelog is stored the same way, each change
+ * as "<date>\t<change>".
+ */
+struct CSV_Export: public Export {
+    private:
+        // Per-column buffers reused between notes
+        mutable std::vector<std::string> m_Cells;
+
+    public:
+        explicit CSV_Export(const std::string & path);
+
+        virtual void begin(std::ofstream & os) const override;
+
+        virtual void operator () (const std::unique_ptr<Note> & to_export,
+                                  std::ofstream & os) const override;
+};
+
+#endif  // CSV_EXPORT_HPP
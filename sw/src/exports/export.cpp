@@ -1,5 +1,8 @@
 #include <string>
+#include <fstream>
 #include "export.hpp"
 
 Export::Export(const std::string & path)
     : m_PATH(path) { }
+
+void Export::begin(std::ofstream &) const { }
@@ -13,6 +13,17 @@ struct Export {
     public:
         explicit Export(const std::string & path);
 
+        virtual ~Export() = default;
+
+        /**
+         * Write everything which precedes the first note (e.g. a CSV header).
+         *
+         * Does nothing by default.
+         *
+         * @param os A file to export notes to.
+         */
+        virtual void begin(std::ofstream & os) const;
+
         /**
          * Export the provided note to the standard file format.
          *
@@ -0,0 +1,154 @@
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <memory>
+#include <fstream>
+#include <ostream>
+#include <vector>
+#include <utility>
+#include "export.hpp"
+#include "json_lines_export.hpp"
+#include "record_writer.hpp"
+#include "../timestamp.hpp"
+#include "../trace.hpp"
+
+namespace {
+    /**
+     * Writes a record as a single line of JSON straight to the stream.
+     */
+    class JSON_Record_Writer: public Record_Writer {
+        private:
+            std::ostream & m_OS;
+            bool m_First;
+
+            /**
+             * Write a string as a JSON string literal.
+             *
+             * Runs of characters which don't need escaping are written at once.
+             */
+            void write_string(std::string_view text) {
+                static const char HEX[] = "0123456789abcdef";
+
+                m_OS.put('"');
+                const char * data = text.data();
+                size_t run = 0;
+                for (size_t i = 0; i < text.size(); i++) {
+                    const unsigned char c = static_cast<unsigned char>(data[i]);
+                    if (c >= 0x20 && c != '"' && c != '\\') {
+                        continue;
+                    }
+                    m_OS.write(data + run, i - run);
+                    run = i + 1;
+                    switch (c) {
+                        case '"':  m_OS.write("\\\"", 2); break;
+                        case '\\': m_OS.write("\\\\", 2); break;
+                        case '\n': m_OS.write("\\n", 2); break;
+                        case '\t': m_OS.write("\\t", 2); break;
+                        default: {
+                            const char escaped[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf]};
+                            m_OS.write(escaped, sizeof(escaped));
+                        }
+                    }
+                }
+                m_OS.write(data + run, text.size() - run);
+                m_OS.put('"');
+            }
+
+            void write_key(const char * key) {
+                if (!m_First) {
+                    m_OS.put(',');
+                }
+                m_First = false;
+                m_OS.put('"');
+                m_OS << key;
+                m_OS.write("\":", 2);
+            }
+
+        public:
+            explicit JSON_Record_Writer(std::ostream & os)
+                : m_OS(os), m_First(true) { }
+
+            virtual void begin_record() override {
+                m_OS.put('{');
+                m_First = true;
+            }
+
+            virtual void end_record() override {
+                m_OS.write("}\n", 2);
+            }
+
+            virtual void string_field(const char * key, std::string_view value) override {
+                write_key(key);
+                write_string(value);
+            }
+
+            virtual void list_field(const char * key, const std::vector<std::string> & values) override {
+                write_key(key);
+                m_OS.put('[');
+                for (size_t i = 0; i < values.size(); i++) {
+                    if (i) {
+                        m_OS.put(',');
+                    }
+                    write_string(values[i]);
+                }
+                m_OS.put(']');
+            }
+
+            virtual void pair_fields(const char * first_key, const char * second_key,
+                                     const std::vector<std::pair<std::string, std::string>> & values) override {
+                write_key(first_key);
+                m_OS.put('[');
+                for (size_t i = 0; i < values.size(); i++) {
+                    if (i) {
+                        m_OS.put(',');
+                    }
+                    write_string(values[i].first);
+                }
+                m_OS.put(']');
+
+                write_key(second_key);
+                m_OS.put('[');
+                for (size_t i = 0; i < values.size(); i++) {
+                    if (i) {
+                        m_OS.put(',');
+                    }
+                    write_string(values[i].second);
+                }
+                m_OS.put(']');
+            }
+
+            virtual void changelog_field(const char * key,
+                                         const std::vector<std::pair<Timestamp, std::string>> & changes) override {
+                char date[Timestamp::m_TEXT_SIZE];
+                write_key(key);
+                m_OS.put('[');
+                for (size_t i = 0; i < changes.size(); i++) {
+                    if (i) {
+                        m_OS.put(',');
+                    }
+                    m_OS.write("{\"date\":", 8);
+                    write_string(changes[i].first.view(date));
+                    m_OS.write(",\"change\":", 10);
+                    write_string(changes[i].second);
+                    m_OS.put('}');
+                }
+                m_OS.put(']');
+            }
+    };
+}
+
+JSON_Lines_Export::JSON_Lines_Export(const std::string & path)
+    : Export(path) { }
+
+void JSON_Lines_Export::operator () (const std::unique_ptr<Note> & to_export,
+                                     std::ofstream & os) const {
+    Trace_Scope trace("JSON_Lines_Export::operator()");
+    const std::streampos begin = Trace::enabled() ? os.tellp() : std::streampos(0);
+    JSON_Record_Writer writer(os);
+    writer.begin_record();
+    to_export->write_record(writer);
+    writer.end_record();
+    if (Trace::enabled()) {
+        Trace::add_bytes_written(static_cast<uint64_t>(os.tellp() - begin));
+    }
+}
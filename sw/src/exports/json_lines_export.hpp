@@ -0,0 +1,24 @@
+#ifndef JSON_LINES_EXPORT_HPP
+#define JSON_LINES_EXPORT_HPP
+
+#include <string>
+#include <memory>
+#include <fstream>
+#include "export.hpp"
+#include "../notes/note.hpp"
+
+/**
+ * Export notes to JSON Lines file format (one JSON object per note).
+ *
+ * Lists (tags, items, deadlines) are JSON arrays, changelog is an array
+ * of {"date", "change"} objects.
+ */
+struct JSON_Lines_Export: public Export {
+    public:
+        explicit JSON_Lines_Export(const std::string & path);
+
+        virtual void operator () (const std::unique_ptr<Note> & to_export,
+                                  std::ofstream & os) const override;
+};
+
+#endif  // JSON_LINES_EXPORT_HPP
@@ -1,14 +1,19 @@
 #include <string>
+#include <cstdint>
 #include <memory>
 #include <fstream>
 #include "export.hpp"
 #include "markdown_export.hpp"
+#include "../trace.hpp"
 
 Markdown_Export::Markdown_Export(const std::string & path)
     : Export(path) { }
 
 void Markdown_Export::operator () (const std::unique_ptr<Note> & to_export,
                                    std::ofstream & os) const {
+    Trace_Scope trace("Markdown_Export::operator()");
+    // tellp() isn't free, so it's only used when tracing
+    const std::streampos begin = Trace::enabled() ? os.tellp() : std::streampos(0);
     // TODO
     os << "# " << to_export->get_name() << std::endl
        << std::endl
@@ -24,4 +29,7 @@ void Markdown_Export::operator () (const std::unique_ptr<Note> & to_export,
             os << x;
         }
     }
+    if (Trace::enabled()) {
+        Trace::add_bytes_written(static_cast<uint64_t>(os.tellp() - begin));
+    }
 }
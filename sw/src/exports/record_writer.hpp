@@ -0,0 +1,62 @@
+#ifndef RECORD_WRITER_HPP
+#define RECORD_WRITER_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include "../timestamp.hpp"
+
+/**
+ * A base abstract class for writing a note as a record with typed fields
+ * (used by record-based exports, e.g. JSON Lines or CSV).
+ *
+ * Notes write their fields themselves (see Note::write_record()),
+ * straight from their members.
+ */
+class Record_Writer {
+    public:
+        virtual ~Record_Writer() = default;
+
+        virtual void begin_record() = 0;
+
+        virtual void end_record() = 0;
+
+        /**
+         * Write a string field.
+         *
+         * @param key   A name of the field.
+         * @param value A value of the field.
+         */
+        virtual void string_field(const char * key, std::string_view value) = 0;
+
+        /**
+         * Write a list of strings.
+         *
+         * @param key    A name of the field.
+         * @param values Values of the field.
+         */
+        virtual void list_field(const char * key, const std::vector<std::string> & values) = 0;
+
+        /**
+         * Write a list of pairs as two parallel lists
+         * (e.g. tasks and their deadlines).
+         *
+         * @param first_key  A name of the field with first elements.
+         * @param second_key A name of the field with second elements.
+         * @param values     Values of the fields.
+         */
+        virtual void pair_fields(const char * first_key, const char * second_key,
+                                 const std::vector<std::pair<std::string, std::string>> & values) = 0;
+
+        /**
+         * Write a changelog.
+         *
+         * @param key     A name of the field.
+         * @param changes Pairs of timestamps and changes.
+         */
+        virtual void changelog_field(const char * key,
+                                     const std::vector<std::pair<Timestamp, std::string>> & changes) = 0;
+};
+
+#endif  // RECORD_WRITER_HPP
@@ -0,0 +1,507 @@
+#include <cstddef>
+#include <cstdint>
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <filesystem>
+#include <system_error>
+#include <charconv>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "site_export.hpp"
+#include "record_writer.hpp"
+#include "../notes/note.hpp"
+#include "../content_hash.hpp"
+#include "../timestamp.hpp"
+#include "../trace.hpp"
+
+namespace {
+    /**
+     * A page written to a file through a buffer of a bounded size.
+     *
+     * Every worker reuses one, so the buffer is allocated only once.
+     */
+    class Page_Output {
+        private:
+            // Buffered text is written out when it's bigger than this.
+            static constexpr size_t m_BUFFER_SIZE = 1 << 16;
+
+            std::ofstream m_File;
+            std::string m_Buffer;
+
+            void flush() {
+                m_File.write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+                m_Buffer.clear();
+            }
+
+        public:
+            Page_Output() {
+                m_Buffer.reserve(m_BUFFER_SIZE);
+            }
+
+            /**
+             * Start writing a page (a page which wasn't closed is dropped).
+             *
+             * Throws std::runtime_error if couldn't create the file.
+             */
+            void open(const std::string & path) {
+                if (m_File.is_open()) {
+                    m_File.close();
+                }
+                m_File.clear();
+                m_Buffer.clear();
+                m_File.open(path, std::ios::binary | std::ios::trunc);
+                if (!m_File.is_open()) {
+                    throw std::runtime_error("Site_Export: Couldn't create a page " + path + '.');
+                }
+            }
+
+            void write(std::string_view text) {
+                // Text longer than the buffer isn't copied at all
+                if (text.size() >= m_BUFFER_SIZE) {
+                    flush();
+                    m_File.write(text.data(), static_cast<std::streamsize>(text.size()));
+                    return;
+                }
+                m_Buffer.append(text.data(), text.size());
+                if (m_Buffer.size() >= m_BUFFER_SIZE) {
+                    flush();
+                }
+            }
+
+            /**
+             * Write text with HTML special characters escaped.
+             *
+             * Runs of characters which don't need escaping are written at once.
+             */
+            void write_escaped(std::string_view text) {
+                size_t run = 0;
+                for (size_t i = 0; i < text.size(); i++) {
+                    const char * entity;
+                    switch (text[i]) {
+                        case '&': entity = "&amp;"; break;
+                        case '<': entity = "&lt;"; break;
+                        case '>': entity = "&gt;"; break;
+                        case '"': entity = "&quot;"; break;
+                        default: continue;
+                    }
+                    write(text.substr(run, i - run));
+                    write(entity);
+                    run = i + 1;
+                }
+                write(text.substr(run));
+            }
+
+            /**
+             * Finish writing the page.
+             *
+             * Throws std::runtime_error if couldn't write it.
+             */
+            void close() {
+                flush();
+                m_File.close();
+                if (!m_File.good()) {
+                    throw std::runtime_error("Site_Export: Couldn't write a page.");
+                }
+            }
+    };
+
+    /**
+     * Get a link to a logical path (special characters percent-encoded).
+     */
+    std::string to_href(const std::string & path) {
+        static const char HEX[] = "0123456789ABCDEF";
+
+        std::string href;
+        href.reserve(path.size());
+        for (const unsigned char c: path) {
+            if (std::isalnum(c) || c == '/' || c == '-' || c == '_' || c == '.' || c == '~') {
+                href.push_back(static_cast<char>(c));
+            }
+            else {
+                href.push_back('%');
+                href.push_back(HEX[c >> 4]);
+                href.push_back(HEX[c & 0xf]);
+            }
+        }
+        return href;
+    }
+
+    /**
+     * Get a relative link to the root of the site from a page.
+     *
+     * @param path A logical path of the page (without ".html").
+     */
+    std::string get_root(const std::string & path) {
+        std::string root;
+        for (size_t i = path.find('/'); i != std::string::npos; i = path.find('/', i + 1)) {
+            root.append("../");
+        }
+        return root;
+    }
+
+    /**
+     * Get an id of a tag's section in the index of tags (tags can
+     * contain anything, ids can't).
+     */
+    std::string get_tag_anchor(const std::string & tag) {
+        return "tag-" + hash_to_hex(content_hash(tag));
+    }
+
+    void begin_page(Page_Output & page, std::string_view title, const std::string & root) {
+        page.write("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>");
+        page.write_escaped(title);
+        page.write("</title>\n</head>\n<body>\n<nav><a href=\"");
+        page.write(root);
+        page.write("index.html\">Notes</a> | <a href=\"index.html\">Directory</a> | <a href=\"");
+        page.write(root);
+        page.write("tags.html\">Tags</a></nav>\n<h1>");
+        page.write_escaped(title);
+        page.write("</h1>\n");
+    }
+
+    void end_page(Page_Output & page) {
+        page.write("</body>\n</html>\n");
+    }
+
+    /**
+     * Writes a record as an HTML description list.
+     */
+    class HTML_Record_Writer: public Record_Writer {
+        private:
+            Page_Output & m_Page;
+            // A relative link to the root of the site
+            const std::string & m_Root;
+
+            void write_key(const char * key) {
+                m_Page.write("<dt>");
+                std::string label = key;
+                std::replace(label.begin(), label.end(), '_', ' ');
+                m_Page.write(label);
+                m_Page.write("</dt>\n");
+            }
+
+            void write_row(std::string_view first, std::string_view second) {
+                m_Page.write("<tr><td>");
+                m_Page.write_escaped(first);
+                m_Page.write("</td><td>");
+                m_Page.write_escaped(second);
+                m_Page.write("</td></tr>\n");
+            }
+
+        public:
+            HTML_Record_Writer(Page_Output & page, const std::string & root)
+                : m_Page(page), m_Root(root) { }
+
+            virtual void begin_record() override {
+                m_Page.write("<dl>\n");
+            }
+
+            virtual void end_record() override {
+                m_Page.write("</dl>\n");
+            }
+
+            virtual void string_field(const char * key, std::string_view value) override {
+                write_key(key);
+                // Text keeps it's lines
+                const bool text = std::string_view(key) == "text";
+                m_Page.write(text ? "<dd><pre>" : "<dd>");
+                m_Page.write_escaped(value);
+                m_Page.write(text ? "</pre></dd>\n" : "</dd>\n");
+            }
+
+            virtual void list_field(const char * key, const std::vector<std::string> & values) override {
+                const bool tags = std::string_view(key) == "tags";
+                write_key(key);
+                m_Page.write("<dd><ul>\n");
+                for (const auto & x: values) {
+                    m_Page.write("<li>");
+                    if (tags) {
+                        m_Page.write("<a href=\"");
+                        m_Page.write(m_Root);
+                        m_Page.write("tags.html#");
+                        m_Page.write(get_tag_anchor(x));
+                        m_Page.write("\">");
+                    }
+                    m_Page.write_escaped(x);
+                    m_Page.write(tags ? "</a></li>\n" : "</li>\n");
+                }
+                m_Page.write("</ul></dd>\n");
+            }
+
+            virtual void pair_fields(const char * first_key, const char * second_key,
+                                     const std::vector<std::pair<std::string, std::string>> & values) override {
+                write_key(first_key);
+                m_Page.write("<dd><table>\n<tr><th>");
+                m_Page.write(first_key);
+                m_Page.write("</th><th>");
+                m_Page.write(second_key);
+                m_Page.write("</th></tr>\n");
+                for (const auto & x: values) {
+                    write_row(x.first, x.second);
+                }
+                m_Page.write("</table></dd>\n");
+            }
+
+            virtual void changelog_field(const char * key,
+                                         const std::vector<std::pair<Timestamp, std::string>> & changes) override {
+                char date[Timestamp::m_TEXT_SIZE];
+                write_key(key);
+                m_Page.write("<dd><table>\n<tr><th>date</th><th>change</th></tr>\n");
+                for (const auto & x: changes) {
+                    write_row(x.first.view(date), x.second);
+                }
+                m_Page.write("</table></dd>\n");
+            }
+    };
+}
+
+Site_Export::Site_Export(const std::string & destination, unsigned threads)
+    : m_DESTINATION(destination.size() && destination.back() != '/' ? destination + '/' : destination),
+      m_THREADS(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {
+    namespace fs = std::filesystem;
+
+    if (m_DESTINATION.empty()) {
+        throw std::runtime_error("Site_Export::Site_Export(): Destination can't be empty.");
+    }
+    if (fs::exists(m_DESTINATION) && !fs::is_directory(m_DESTINATION)) {
+        throw std::runtime_error("Site_Export::Site_Export(): Destination isn't a directory.");
+    }
+
+    // Nothing is created yet, so a rejected destination is left untouched
+    std::ifstream file(m_DESTINATION + m_MANIFEST);
+    std::string path, hash;
+    while (std::getline(file, path, '\t') && std::getline(file, hash)) {
+        // A damaged line only makes the note rendered again
+        uint64_t value;
+        const auto result = std::from_chars(hash.data(), hash.data() + hash.size(), value, 16);
+        if (result.ec == std::errc() && result.ptr == hash.data() + hash.size() && hash.size()) {
+            m_Previous[path] = value;
+        }
+    }
+}
+
+Site_Export::Directory & Site_Export::add_dir(const std::string & dir) {
+    namespace fs = std::filesystem;
+
+    auto it = m_Dirs.find(dir);
+    if (it != m_Dirs.end()) {
+        return it->second;
+    }
+    if (dir.size()) {
+        const size_t slash = dir.rfind('/');
+        add_dir(slash == std::string::npos ? "" : dir.substr(0, slash))
+            .m_Subdirs.insert(slash == std::string::npos ? dir : dir.substr(slash + 1));
+    }
+    // Directories are created here, before the workers write into them
+    std::error_code error;
+    fs::create_directories(m_DESTINATION + dir, error);
+    if (error) {
+        throw std::runtime_error("Site_Export::add_dir(): Couldn't create directory " + dir + '.');
+    }
+    return m_Dirs[dir];
+}
+
+void Site_Export::add(const std::vector<std::pair<std::string, std::unique_ptr<Note>>> & notes) {
+    namespace fs = std::filesystem;
+
+    Trace_Scope trace("Site_Export::add");
+    std::vector<std::string> summaries(notes.size());
+    for (size_t i = 0; i < notes.size(); i++) {
+        const std::string & path = notes.at(i).first;
+        const size_t slash = path.rfind('/');
+        summaries.at(i) = notes.at(i).second->get_summary();
+        add_dir(slash == std::string::npos ? "" : path.substr(0, slash))
+            .m_Notes[slash == std::string::npos ? path : path.substr(slash + 1)] = summaries.at(i);
+        for (const auto & tag: notes.at(i).second->get_tags()) {
+            m_Tags[tag][path] = summaries.at(i);
+        }
+    }
+
+    std::vector<uint64_t> hashes(notes.size());
+    std::vector<char> rendered(notes.size(), false);
+    std::vector<std::string> errors(notes.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        Page_Output page;
+        std::ostringstream text;
+        for (size_t i = next++; i < notes.size(); i = next++) {
+            const std::string & path = notes.at(i).first;
+            const Note & note = *notes.at(i).second;
+            const std::string file = m_DESTINATION + path + ".html";
+            try {
+                text.str("");
+                note.save(text);
+                hashes.at(i) = content_hash(text.str());
+                auto previous = m_Previous.find(path);
+                if (previous != m_Previous.end() && previous->second == hashes.at(i) && fs::exists(file)) {
+                    continue;
+                }
+
+                const std::string root = get_root(path);
+                page.open(file);
+                begin_page(page, summaries.at(i), root);
+                HTML_Record_Writer writer(page, root);
+                writer.begin_record();
+                note.write_record(writer);
+                writer.end_record();
+                end_page(page);
+                page.close();
+                rendered.at(i) = true;
+            }
+            catch (const std::runtime_error & e) {
+                errors.at(i) = e.what();
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < m_THREADS && i < notes.size(); i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto & x: workers) {
+        x.join();
+    }
+
+    for (size_t i = 0; i < notes.size(); i++) {
+        if (errors.at(i).size()) {
+            // The manifest isn't saved, so the note is rendered again next time
+            throw std::runtime_error("Site_Export::add(): " + notes.at(i).first + ": " + errors.at(i));
+        }
+        m_Current[notes.at(i).first] = hashes.at(i);
+        if (rendered.at(i)) {
+            m_Stats.m_Rendered++;
+        }
+        else {
+            m_Stats.m_Unchanged++;
+        }
+    }
+}
+
+void Site_Export::write_indices() const {
+    Trace_Scope trace("Site_Export::write_indices");
+    Page_Output page;
+    for (const auto & dir: m_Dirs) {
+        const std::string path = dir.first.size() ? dir.first + '/' + m_DIR_INDEX : m_DIR_INDEX;
+        page.open(m_DESTINATION + path);
+        begin_page(page, '/' + dir.first, get_root(path));
+        page.write("<ul>\n");
+        for (const auto & x: dir.second.m_Subdirs) {
+            page.write("<li><a href=\"");
+            page.write(to_href(x));
+            page.write("/index.html\">");
+            page.write_escaped(x);
+            page.write("/</a></li>\n");
+        }
+        for (const auto & x: dir.second.m_Notes) {
+            page.write("<li><a href=\"");
+            page.write(to_href(x.first));
+            page.write(".html\">");
+            page.write_escaped(x.second);
+            page.write("</a> (");
+            page.write_escaped(x.first);
+            page.write(")</li>\n");
+        }
+        page.write("</ul>\n");
+        end_page(page);
+        page.close();
+    }
+
+    page.open(m_DESTINATION + m_TAG_INDEX);
+    begin_page(page, "Tags", "");
+    page.write("<ul>\n");
+    for (const auto & tag: m_Tags) {
+        page.write("<li><a href=\"#");
+        page.write(get_tag_anchor(tag.first));
+        page.write("\">");
+        page.write_escaped(tag.first);
+        page.write("</a> (");
+        page.write(std::to_string(tag.second.size()));
+        page.write(")</li>\n");
+    }
+    page.write("</ul>\n");
+    for (const auto & tag: m_Tags) {
+        page.write("<h2 id=\"");
+        page.write(get_tag_anchor(tag.first));
+        page.write("\">");
+        page.write_escaped(tag.first);
+        page.write("</h2>\n<ul>\n");
+        for (const auto & x: tag.second) {
+            page.write("<li><a href=\"");
+            page.write(to_href(x.first));
+            page.write(".html\">");
+            page.write_escaped(x.second);
+            page.write("</a> (");
+            page.write_escaped(x.first);
+            page.write(")</li>\n");
+        }
+        page.write("</ul>\n");
+    }
+    end_page(page);
+    page.close();
+}
+
+void Site_Export::save_manifest() const {
+    namespace fs = std::filesystem;
+
+    const std::string path = m_DESTINATION + m_MANIFEST,
+                      temporary = path + ".tmp";
+    std::ofstream file(temporary, std::ios::trunc);
+    for (const auto & x: m_Current) {
+        file << x.first << '\t' << hash_to_hex(x.second) << '\n';
+    }
+    file.close();
+    if (!file.good()) {
+        throw std::runtime_error("Site_Export::save_manifest(): Couldn't save the manifest.");
+    }
+    fs::rename(temporary, path);
+}
+
+Site_Stats Site_Export::finish() {
+    namespace fs = std::filesystem;
+
+    Trace_Scope trace("Site_Export::finish");
+    // The destination itself, if no note was added
+    add_dir("");
+    std::set<std::string> stale_dirs;
+    for (const auto & x: m_Previous) {
+        if (m_Current.count(x.first)) {
+            continue;
+        }
+        std::error_code error;
+        if (fs::remove(m_DESTINATION + x.first + ".html", error)) {
+            m_Stats.m_Removed++;
+        }
+        for (size_t slash = x.first.rfind('/'); slash != std::string::npos && slash;
+             slash = x.first.rfind('/', slash - 1)) {
+            stale_dirs.insert(x.first.substr(0, slash));
+        }
+    }
+    // Deepest directories first, so their parents can be removed after them
+    for (auto it = stale_dirs.rbegin(); it != stale_dirs.rend(); ++it) {
+        if (m_Dirs.count(*it)) {
+            continue;
+        }
+        std::error_code error;
+        fs::remove(m_DESTINATION + *it + '/' + m_DIR_INDEX, error);
+        // Fails (and is kept), if something else is in there
+        fs::remove(m_DESTINATION + *it, error);
+    }
+
+    write_indices();
+    save_manifest();
+    return m_Stats;
+}
+
+const std::string & Site_Export::get_destination() const {
+    return m_DESTINATION;
+}
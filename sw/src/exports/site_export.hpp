@@ -0,0 +1,129 @@
+#ifndef SITE_EXPORT_HPP
+#define SITE_EXPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <utility>
+#include "../notes/note.hpp"
+
+/**
+ * Statistics of a static site export.
+ */
+struct Site_Stats {
+    // Pages of new or changed notes
+    size_t m_Rendered = 0;
+    // Notes, which didn't change since the last export
+    size_t m_Unchanged = 0;
+    // Pages of notes, which don't exist anymore
+    size_t m_Removed = 0;
+};
+
+/**
+ * Export notes as a static HTML site.
+ *
+ * Every note gets a page at "<destination>/<logical path>.html", every
+ * directory an index of it's notes and sub-directories ("index.html")
+ * and the whole site an index of tags ("tags.html"). Links are relative,
+ * so the site can be moved or opened straight from the disk.
+ *
+ * Notes are added in batches, which are rendered in parallel. Every
+ * worker renders into it's own buffer of a bounded size, so big notes
+ * are written out in pieces. Hashes of rendered notes are kept
+ * in "<destination>/.manifest", so the next export of the same notes
+ * renders only notes which changed since then (index pages are always
+ * rendered again, they are cheap).
+ */
+class Site_Export {
+    private:
+        // "<logical path>\t<hash>" of rendered notes (inside the destination)
+        const std::string m_MANIFEST = ".manifest",
+                          m_DIR_INDEX = "index.html",
+                          m_TAG_INDEX = "tags.html";
+
+        /**
+         * Notes and sub-directories of a directory.
+         */
+        struct Directory {
+            std::set<std::string> m_Subdirs;
+            // Summaries of the notes by file names
+            std::map<std::string, std::string> m_Notes;
+        };
+
+        const std::string m_DESTINATION;
+        const unsigned m_THREADS;
+        // Hashes of notes by logical paths from the last export
+        // and from this one.
+        std::map<std::string, uint64_t> m_Previous, m_Current;
+        // Directories by logical paths ("" for the root)
+        std::map<std::string, Directory> m_Dirs;
+        // Summaries of notes by logical paths, by tags
+        std::map<std::string, std::map<std::string, std::string>> m_Tags;
+        Site_Stats m_Stats;
+
+        /**
+         * Add a directory and all directories above it to the index.
+         *
+         * Creates the directory in the destination, if it wasn't added yet.
+         *
+         * @param  dir A logical path of the directory ("" for the root).
+         * @return The directory.
+         */
+        Directory & add_dir(const std::string & dir);
+
+        /**
+         * Write index pages of all directories and the index of tags.
+         *
+         * Throws std::runtime_error if couldn't write a page.
+         */
+        void write_indices() const;
+
+        /**
+         * Save hashes of the rendered notes.
+         *
+         * Throws std::runtime_error if couldn't save them.
+         */
+        void save_manifest() const;
+
+    public:
+        // How many notes to render at once (see add()).
+        static constexpr size_t m_BATCH_SIZE = 1024;
+
+        /**
+         * Prepare an export into a directory.
+         *
+         * Throws std::runtime_error if the destination isn't a directory.
+         *
+         * @param destination A directory of the site (created by add() or finish(),
+         *                    if it doesn't exist).
+         * @param threads     How many threads render notes (0 for all cores).
+         */
+        explicit Site_Export(const std::string & destination, unsigned threads = 0);
+
+        /**
+         * Render pages of notes, which changed since the last export.
+         *
+         * Throws std::runtime_error if couldn't create a directory or write a page.
+         *
+         * @param notes Pairs of logical paths and notes.
+         */
+        void add(const std::vector<std::pair<std::string, std::unique_ptr<Note>>> & notes);
+
+        /**
+         * Remove pages of notes, which weren't added this time, write index
+         * pages and save the manifest.
+         *
+         * Throws std::runtime_error if got error.
+         *
+         * @return Statistics of the export.
+         */
+        Site_Stats finish();
+
+        const std::string & get_destination() const;
+};
+
+#endif  // SITE_EXPORT_HPP
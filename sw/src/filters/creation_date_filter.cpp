@@ -7,6 +7,7 @@
 #include "filter.hpp"
 #include "creation_date_filter.hpp"
 #include "../notes/note.hpp"
+#include "../trace.hpp"
 
 bool Creation_Date_Filter::check_creation_date_validity() {
     std::istringstream iss (m_Creation_Date_Criteria);
@@ -49,6 +50,9 @@ void Creation_Date_Filter::request_criteria() {
 }
 
 bool Creation_Date_Filter::operator () (const std::pair<std::string, std::unique_ptr<Note>> & check) const {
-    return m_Reverse ? check.second->get_creation_date().compare(m_Creation_Date_Criteria) < 0
-                     : check.second->get_creation_date().compare(m_Creation_Date_Criteria) > 0;
+    Trace_Scope trace("Creation_Date_Filter::operator()");
+    char date[Timestamp::m_TEXT_SIZE];
+    const std::string_view creation_date = check.second->get_creation_date().view(date);
+    return m_Reverse ? creation_date.compare(m_Creation_Date_Criteria) < 0
+                     : creation_date.compare(m_Creation_Date_Criteria) > 0;
 }
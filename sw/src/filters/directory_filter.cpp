@@ -6,6 +6,7 @@
 #include "filter.hpp"
 #include "directory_filter.hpp"
 #include "../notes/note.hpp"
+#include "../trace.hpp"
 
 void Directory_Filter::request_criteria() {
     std::cout << "Enter a directory by which to search the notes." << std::endl
@@ -29,6 +30,7 @@ void Directory_Filter::request_criteria() {
 }
 
 bool Directory_Filter::operator () (const std::pair<std::string, std::unique_ptr<Note>> & check) const {
+    Trace_Scope trace("Directory_Filter::operator()");
     bool result = check.first.find(m_Directory_Criteria) == 0;
     return m_Reverse ? !result
                      : result;
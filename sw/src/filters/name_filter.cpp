@@ -5,6 +5,7 @@
 #include <memory>
 #include "name_filter.hpp"
 #include "../notes/note.hpp"
+#include "../trace.hpp"
 
 void Name_Filter::request_criteria() {
     std::cout << "Enter a name by which to search the notes:" << std::endl
@@ -23,6 +24,7 @@ void Name_Filter::request_criteria() {
 }
 
 bool Name_Filter::operator () (const std::pair<std::string, std::unique_ptr<Note>> & check) const {
+    Trace_Scope trace("Name_Filter::operator()");
     // We don't want a name to be exact, it's enough for the name
     // to contain (or NOT contain, depending on "m_Reverse") the criteria
     return m_Reverse ? check.second->get_name().find(m_Name_Criteria) == std::string::npos
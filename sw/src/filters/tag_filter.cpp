@@ -7,6 +7,7 @@
 #include "filter.hpp"
 #include "tag_filter.hpp"
 #include "../notes/note.hpp"
+#include "../trace.hpp"
 
 void Tag_Filter::request_criteria() {
     std::cout << "Enter a tag by which to search the notes:" << std::endl
@@ -25,6 +26,7 @@ void Tag_Filter::request_criteria() {
 }
 
 bool Tag_Filter::operator () (const std::pair<std::string, std::unique_ptr<Note>> & check) const {
+    Trace_Scope trace("Tag_Filter::operator()");
     bool result = std::find(check.second->get_tags().begin(), check.second->get_tags().end(),
                             m_Tag_Criteria) != check.second->get_tags().end();
     return m_Reverse ? !result
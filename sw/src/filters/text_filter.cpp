@@ -6,6 +6,7 @@
 #include "filter.hpp"
 #include "text_filter.hpp"
 #include "../notes/note.hpp"
+#include "../trace.hpp"
 
 void Text_Filter::request_criteria() {
     std::cout << "Enter a contained text by which to search the notes:" << std::endl
@@ -24,6 +25,7 @@ void Text_Filter::request_criteria() {
 }
 
 bool Text_Filter::operator () (const std::pair<std::string, std::unique_ptr<Note>> & check) const {
+    Trace_Scope trace("Text_Filter::operator()");
     return m_Reverse ? !check.second->contains(m_Text_Criteria)
                      : check.second->contains(m_Text_Criteria);
 }
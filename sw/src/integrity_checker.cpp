@@ -0,0 +1,348 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <ostream>
+#include <iomanip>
+#include <stdexcept>
+#include <filesystem>
+#include <algorithm>
+#include "integrity_checker.hpp"
+#include "note_storage.hpp"
+#include "menu.hpp"
+#include "notes/note_registry.hpp"
+#include "notes/text.hpp"
+#include "notes/shopping_list.hpp"
+#include "notes/todo_list.hpp"
+
+namespace {
+    /**
+     * A line of a note file.
+     */
+    struct Line {
+        std::string m_Text;
+        // Whether or not the line ends with '\n' (std::getline() leaves
+        // the stream good only then).
+        bool m_Terminated;
+    };
+
+    std::vector<Line> split_lines(const std::string & text) {
+        std::vector<Line> lines;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t end = text.find('\n', pos);
+            if (end == std::string::npos) {
+                lines.push_back({ text.substr(pos), false });
+                break;
+            }
+            lines.push_back({ text.substr(pos, end - pos), true });
+            pos = end + 1;
+        }
+        return lines;
+    }
+
+    /**
+     * Escape a string for JSON.
+     */
+    std::string json_escape(const std::string & text) {
+        std::ostringstream os;
+        for (const auto & c: text) {
+            switch (c) {
+                case '"':  os << "\\\""; break;
+                case '\\': os << "\\\\"; break;
+                case '\n': os << "\\n"; break;
+                case '\t': os << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                           << static_cast<int>(c) << std::dec;
+                    }
+                    else {
+                        os << c;
+                    }
+            }
+        }
+        return os.str();
+    }
+}
+
+Integrity_Checker::Integrity_Checker(Note_Storage & notes_store)
+    : m_Notes_Store(notes_store) { }
+
+void Integrity_Checker::scan(const std::string & path, const std::string & text,
+                             Check_Result & result, std::string & salvaged) const {
+    const std::vector<Line> lines = split_lines(text);
+    size_t pos = 0;
+    // Stops the scan at the first problem
+    bool failed = false;
+    auto fail = [&](const std::string & status, const std::string & section,
+                    const std::string & message) {
+        if (!failed) {
+            failed = true;
+            result.m_Status = status;
+            result.m_Section = section;
+            result.m_Line = std::min(pos, lines.size()) + 1;
+            result.m_Message = message;
+        }
+    };
+    // Same as std::getline() followed by a check of good()
+    auto next = [&](const std::string & section, std::string & line) {
+        if (failed) {
+            return false;
+        }
+        if (pos >= lines.size() || !lines.at(pos).m_Terminated) {
+            fail("damaged", section, "Unexpected end of file.");
+            return false;
+        }
+        line = lines.at(pos++).m_Text;
+        return true;
+    };
+    auto separator = [&](const std::string & section) {
+        std::string line;
+        if (next(section, line) && line.size()) {
+            pos--;
+            fail("corrupted", section, "Expected an empty line.");
+        }
+    };
+
+    // The file name is the creation timestamp, so the header can be
+    // restored even if it's lost
+    std::string type, name;
+    const std::string file_name = std::filesystem::path(path).filename();
+    std::vector<std::string> tags;
+    std::vector<std::pair<std::string, std::string>> changes;
+    std::vector<std::string> items;
+
+    if (next("type", type) && !Note_Registry::find(type)) {
+        pos--;
+        fail("corrupted", "type", "Unknown note type.");
+        type.clear();
+    }
+    if (type.empty()) {
+        // There's no way to tell what the note was
+        return;
+    }
+    separator("header");
+    std::string timestamp;
+    next("header", timestamp);
+    separator("header");
+    next("name", name);
+    separator("name");
+
+    for (std::string tag; next("tags", tag) && tag.size();) {
+        tags.push_back(tag);
+    }
+    for (std::string change_timestamp; next("changelog", change_timestamp)
+                                       && change_timestamp.size();) {
+        // Change itself doesn't need a newline, the next line does
+        if (pos >= lines.size()) {
+            fail("damaged", "changelog", "Unexpected end of file.");
+            break;
+        }
+        const std::string & change = lines.at(pos).m_Text;
+        if (change.size() < 2 || change.front() != '\t') {
+            fail("corrupted", "changelog", "A change must start with a tab.");
+            break;
+        }
+        pos++;
+        changes.emplace_back(change_timestamp, change.substr(1));
+    }
+    if (!failed && changes.empty()) {
+        pos--;
+        fail("corrupted", "changelog", "Changelog can't be empty.");
+    }
+    separator("changelog");
+
+    if (type == Text::m_TYPE) {
+        std::string note_text;
+        if (next("content", note_text)) {
+            if (note_text.empty()) {
+                pos--;
+                fail("corrupted", "content", "Text can't be empty.");
+            }
+            else {
+                items.push_back(note_text);
+            }
+        }
+    }
+    else if (type == Shopping_List::m_TYPE) {
+        // Reading stops at the end of file, a last item without a newline
+        // is dropped by the parser as well
+        for (; !failed && pos < lines.size() && lines.at(pos).m_Terminated; pos++) {
+            items.push_back(lines.at(pos).m_Text);
+        }
+    }
+    else {
+        std::set<std::string> unique;
+        while (!failed && pos < lines.size() && lines.at(pos).m_Terminated) {
+            const std::string & task = lines.at(pos).m_Text;
+            if (!unique.insert(task).second) {
+                fail("corrupted", "content", "Tasks must be unique.");
+                break;
+            }
+            pos++;
+            std::string deadline;
+            if (!next("content", deadline)) {
+                break;
+            }
+            if (deadline.size() < 2 || deadline.front() != '\t') {
+                pos--;
+                fail("corrupted", "content", "A deadline must start with a tab.");
+                break;
+            }
+            items.push_back(task);
+            items.push_back(deadline);
+        }
+    }
+
+    // Building the salvaged note
+    std::ostringstream os;
+    os << type << "\n\n" << file_name << "\n\n" << name << "\n\n";
+    for (const auto & x: tags) {
+        os << x << '\n';
+    }
+    os << '\n';
+    if (changes.empty()) {
+        // "YYYY_MM_DD__HH_MM_SS" to "YYYY-MM-DD, HH:MM:SS"
+        std::string created = get_timestamp();
+        if (file_name.size() >= 20 && file_name.at(10) == '_' && file_name.at(11) == '_') {
+            created = file_name.substr(0, 4) + '-' + file_name.substr(5, 2) + '-'
+                      + file_name.substr(8, 2) + ", " + file_name.substr(12, 2) + ':'
+                      + file_name.substr(15, 2) + ':' + file_name.substr(18, 2);
+        }
+        os << created << "\n\tCreated note.\n";
+    }
+    for (const auto & x: changes) {
+        os << x.first << "\n\t" << x.second << '\n';
+    }
+    if (failed) {
+        os << get_timestamp() << "\n\tSalvaged note (" << result.m_Status
+           << " at line " << result.m_Line << ").\n";
+    }
+    os << "\n\n";
+    if (type == Text::m_TYPE) {
+        os << (items.size() ? items.front() : "(lost)") << '\n';
+    }
+    else {
+        for (size_t i = 0; i < items.size(); i++) {
+            os << items.at(i) << '\n';
+        }
+    }
+
+    result.m_Salvaged_Tags = tags.size();
+    result.m_Salvaged_Changes = changes.size();
+    result.m_Salvaged_Items = type == TODO_List::m_TYPE ? items.size() / 2 : items.size();
+    salvaged = os.str();
+}
+
+Check_Result Integrity_Checker::check_file(const std::string & path, const bool repair) const {
+    namespace fs = std::filesystem;
+
+    Check_Result result;
+    result.m_Path = path;
+    std::string text;
+    try {
+        text = m_Notes_Store.read_text(path);
+    }
+    catch (const std::runtime_error & e) {
+        result.m_Status = "unreadable";
+        result.m_Message = e.what();
+        return result;
+    }
+
+    // The parser has the last word, the scan only tells where is the problem
+    std::string parser_error;
+    try {
+        std::istringstream is(text);
+        m_Notes_Store.parse(is);
+    }
+    catch (const std::runtime_error & e) {
+        parser_error = e.what();
+    }
+    std::string salvaged;
+    scan(path, text, result, salvaged);
+    if (parser_error.empty()) {
+        result = Check_Result();
+        result.m_Path = path;
+        return result;
+    }
+    else if (result.m_Status == "ok") {
+        // Shouldn't happen, but the parser is right
+        result.m_Status = parser_error.find("damaged") != std::string::npos ? "damaged"
+                                                                            : "corrupted";
+        result.m_Section = "unknown";
+    }
+    if (result.m_Message.empty()) {
+        result.m_Message = parser_error;
+    }
+
+    std::unique_ptr<Note> note;
+    if (salvaged.size()) {
+        try {
+            std::istringstream is(salvaged);
+            note = m_Notes_Store.parse(is);
+            result.m_Salvageable = true;
+        }
+        catch (const std::runtime_error &) { }
+    }
+    if (repair && note) {
+        const fs::path file = m_Notes_Store.get_notes_path() + path;
+        std::string dir = fs::path(path).parent_path();
+        try {
+            Note_Storage::Write_Lock lock(m_Notes_Store);
+            fs::rename(file, file.parent_path() / ('.' + file.filename().string() + ".damaged"));
+            m_Notes_Store.update(*note, dir);
+            result.m_Repaired = true;
+        }
+        catch (const std::exception & e) {
+            result.m_Message += std::string(" Repair failed: ") + e.what();
+        }
+    }
+    return result;
+}
+
+std::vector<Check_Result> Integrity_Checker::check(const bool repair, unsigned threads) const {
+    std::vector<size_t> sizes;
+    const std::vector<std::string> paths = m_Notes_Store.list_note_files("", sizes);
+    std::vector<Check_Result> results(paths.size());
+
+    if (!threads) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Files are handed out one by one, so a few big ones don't stall others
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            results.at(i) = check_file(paths.at(i), repair);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto & x: workers) {
+        x.join();
+    }
+    return results;
+}
+
+void Integrity_Checker::write_report(std::ostream & os, const std::vector<Check_Result> & results) {
+    for (const auto & x: results) {
+        os << "{\"path\":\"" << json_escape(x.m_Path) << "\",\"status\":\"" << x.m_Status << '"';
+        if (x.m_Status != "ok") {
+            os << ",\"line\":" << x.m_Line
+               << ",\"section\":\"" << x.m_Section << '"'
+               << ",\"message\":\"" << json_escape(x.m_Message) << '"'
+               << ",\"salvageable\":" << (x.m_Salvageable ? "true" : "false")
+               << ",\"salvaged\":{\"tags\":" << x.m_Salvaged_Tags
+               << ",\"changes\":" << x.m_Salvaged_Changes
+               << ",\"items\":" << x.m_Salvaged_Items << '}'
+               << ",\"repaired\":" << (x.m_Repaired ? "true" : "false");
+        }
+        os << "}\n";
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef INTEGRITY_CHECKER_HPP
+#define INTEGRITY_CHECKER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <ostream>
+#include "note_storage.hpp"
+
+/**
+ * A result of checking one note file.
+ */
+struct Check_Result {
+    std::string m_Path;
+    // "ok", "damaged" (ends too early), "corrupted" (invalid content)
+    // or "unreadable" (couldn't read / decompress the file).
+    std::string m_Status = "ok";
+    // A line (starting with 1) and a section of the note where the problem
+    // was found: "type", "header", "name", "tags", "changelog" or "content".
+    size_t m_Line = 0;
+    std::string m_Section;
+    std::string m_Message;
+
+    // How much of the note could be salvaged.
+    bool m_Salvageable = false;
+    size_t m_Salvaged_Tags = 0, m_Salvaged_Changes = 0, m_Salvaged_Items = 0;
+    // Whether or not the salvaged note was written in place of the damaged
+    // one (the original is kept as ".<name>.damaged").
+    bool m_Repaired = false;
+};
+
+/**
+ * An fsck-like checker of all notes in a Note_Storage.
+ *
+ * Scans files in parallel, finds where each of them is broken
+ * and salvages it's valid prefix (header, name, tags, complete changelog
+ * records and items) into a note that can be read again.
+ */
+class Integrity_Checker {
+    private:
+        Note_Storage & m_Notes_Store;
+
+        /**
+         * Find the first problem in a note file and build a salvaged note.
+         *
+         * Follows the same format as Note::read() and it's overrides,
+         * but doesn't stop at the first problem without recording where
+         * it was.
+         *
+         * @param  path     A path of the note, relative to storage's root.
+         * @param  text     Content of the note file.
+         * @param  result   Where to store the problem.
+         * @param  salvaged Where to store the salvaged note (empty, if
+         *                  nothing could be salvaged).
+         */
+        void scan(const std::string & path, const std::string & text,
+                  Check_Result & result, std::string & salvaged) const;
+
+        /**
+         * Check one note file.
+         *
+         * @param  path   A path of the note, relative to storage's root.
+         * @param  repair Whether or not to replace a broken note
+         *                with the salvaged one.
+         * @return A result of the check.
+         */
+        Check_Result check_file(const std::string & path, const bool repair) const;
+
+    public:
+        explicit Integrity_Checker(Note_Storage & notes_store);
+
+        /**
+         * Check all notes in the storage.
+         *
+         * @param  repair  Whether or not to replace broken notes
+         *                 with salvaged ones.
+         * @param  threads Amount of worker threads (0 for all cores).
+         * @return Results in the order of the files.
+         */
+        std::vector<Check_Result> check(const bool repair, unsigned threads = 0) const;
+
+        /**
+         * Write results as JSON Lines (one JSON object per file).
+         *
+         * @param os      A stream where to write the report.
+         * @param results Results of check().
+         */
+        static void write_report(std::ostream & os, const std::vector<Check_Result> & results);
+};
+
+#endif  // INTEGRITY_CHECKER_HPP
@@ -0,0 +1,242 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include "lz_codec.hpp"
+
+LZ_Codec::LZ_Codec(const std::string & dictionary)
+    : m_Dictionary(dictionary.size() > m_MAX_DICTIONARY
+                   ? dictionary.substr(dictionary.size() - m_MAX_DICTIONARY)
+                   : dictionary),
+      m_Dictionary_Head(static_cast<size_t>(1) << m_HASH_BITS, m_NONE),
+      m_Dictionary_Prev(m_Dictionary.size(), m_NONE) {
+    // The last 2 positions (their 3 bytes would reach into the data)
+    // aren't candidates, it costs a match only rarely
+    const unsigned char * buf = reinterpret_cast<const unsigned char *>(m_Dictionary.data());
+    for (size_t i = 0; i + m_MIN_MATCH <= m_Dictionary.size(); i++) {
+        const size_t h = hash3(buf + i);
+        m_Dictionary_Prev.at(i) = m_Dictionary_Head.at(h);
+        m_Dictionary_Head.at(h) = i;
+    }
+}
+
+size_t LZ_Codec::hash3(const unsigned char * data) {
+    uint32_t value = data[0] | data[1] << 8 | data[2] << 16;
+    // Knuth's multiplicative hashing
+    return (value * 2654435761u) >> (32 - m_HASH_BITS);
+}
+
+std::string LZ_Codec::compress(const std::string & data) const {
+    // How many previous occurrences to check for every position.
+    const size_t MAX_CHAIN = 32;
+
+    // The dictionary is a virtual prefix of the data: positions below
+    // "begin" are in the dictionary, the others in the data
+    const size_t begin = m_Dictionary.size(), end = begin + data.size();
+    const unsigned char * dict = reinterpret_cast<const unsigned char *>(m_Dictionary.data()),
+                        * raw = reinterpret_cast<const unsigned char *>(data.data());
+    auto at = [&](size_t pos) {
+        return pos < begin ? dict[pos] : raw[pos - begin];
+    };
+
+    // Only the data are hashed here, to a table sized by them (its buckets
+    // are the top bits of hash3(), so they contain whole buckets of it)
+    size_t bits = 8;
+    while (bits < m_HASH_BITS && static_cast<size_t>(1) << bits < data.size()) {
+        bits++;
+    }
+    std::vector<size_t> head(static_cast<size_t>(1) << bits, m_NONE),
+                        prev(data.size(), m_NONE);
+    // 3 bytes starting at "pos", which may begin in the dictionary
+    auto hash_at = [&](size_t pos) {
+        const unsigned char bytes[m_MIN_MATCH] = { at(pos), at(pos + 1), at(pos + 2) };
+        return hash3(bytes);
+    };
+    auto insert = [&](size_t pos) {
+        if (pos + m_MIN_MATCH <= end) {
+            size_t h = hash_at(pos) >> (m_HASH_BITS - bits);
+            prev.at(pos - begin) = head.at(h);
+            head.at(h) = pos;
+        }
+    };
+    std::string compressed;
+    compressed.reserve(data.size() / 2 + 16);
+    size_t flags_pos = 0, tokens = 8;
+    for (size_t pos = begin; pos < end;) {
+        if (tokens == 8) {
+            // Every 8 tokens are preceded by a byte of flags
+            flags_pos = compressed.size();
+            compressed.push_back(0);
+            tokens = 0;
+        }
+
+        size_t best_len = 0, best_offset = 0;
+        if (pos + m_MIN_MATCH <= end) {
+            const size_t max_len = std::min(m_MAX_MATCH, end - pos);
+            const size_t h = hash_at(pos);
+            // Nearer candidates in the data first, then the dictionary's
+            size_t candidate = head.at(h >> (m_HASH_BITS - bits));
+            bool in_dictionary = false;
+            for (size_t chain = 0; chain < MAX_CHAIN; chain++) {
+                if (candidate == m_NONE && !in_dictionary) {
+                    candidate = m_Dictionary_Head.at(h);
+                    in_dictionary = true;
+                }
+                if (candidate == m_NONE || pos - candidate > m_MAX_OFFSET) {
+                    break;
+                }
+                size_t len = 0;
+                while (len < max_len && at(candidate + len) == raw[pos - begin + len]) {
+                    len++;
+                }
+                if (len > best_len) {
+                    best_len = len;
+                    best_offset = pos - candidate;
+                    if (len == max_len) {
+                        break;
+                    }
+                }
+                candidate = in_dictionary ? m_Dictionary_Prev.at(candidate) : prev.at(candidate - begin);
+            }
+        }
+
+        if (best_len >= m_MIN_MATCH) {
+            compressed.at(flags_pos) |= static_cast<char>(1 << tokens);
+            compressed.push_back(static_cast<char>(best_offset & 0xff));
+            compressed.push_back(static_cast<char>(best_offset >> 8));
+            compressed.push_back(static_cast<char>(best_len - m_MIN_MATCH));
+            for (size_t i = 0; i < best_len; i++) {
+                insert(pos++);
+            }
+        }
+        else {
+            compressed.push_back(data.at(pos - begin));
+            insert(pos++);
+        }
+        tokens++;
+    }
+    return compressed;
+}
+
+std::string LZ_Codec::decompress(const std::string & data, const size_t raw_size) const {
+    const std::string corrupted = "LZ_Codec::decompress(): Data are corrupted.";
+
+    // The size comes from a file, a match of 3 bytes can't be longer
+    // than m_MAX_MATCH, so bigger sizes are damaged (and would
+    // allocate far more than needed)
+    if (raw_size > data.size() * (m_MAX_MATCH / 3)) {
+        throw std::runtime_error(corrupted);
+    }
+    // Matches reaching before the data are read from the dictionary
+    const size_t dictionary_size = m_Dictionary.size();
+    std::string out;
+    const unsigned char * in = reinterpret_cast<const unsigned char *>(data.data());
+    size_t pos = 0;
+    while (out.size() < raw_size) {
+        if (pos >= data.size()) {
+            throw std::runtime_error(corrupted);
+        }
+        const unsigned char flags = in[pos++];
+        for (size_t token = 0; token < 8 && out.size() < raw_size; token++) {
+            if (!((flags >> token) & 1)) {
+                if (pos >= data.size()) {
+                    throw std::runtime_error(corrupted);
+                }
+                out.push_back(static_cast<char>(in[pos++]));
+                continue;
+            }
+
+            if (pos + 3 > data.size()) {
+                throw std::runtime_error(corrupted);
+            }
+            const size_t offset = in[pos] | in[pos + 1] << 8,
+                         len = in[pos + 2] + m_MIN_MATCH;
+            pos += 3;
+            if (!offset || offset > dictionary_size + out.size() || out.size() + len > raw_size) {
+                throw std::runtime_error(corrupted);
+            }
+            // Matches may overlap with the data being written,
+            // so copy byte by byte
+            size_t from = dictionary_size + out.size() - offset;
+            for (size_t i = 0; i < len; i++, from++) {
+                out.push_back(from < dictionary_size ? m_Dictionary[from] : out[from - dictionary_size]);
+            }
+        }
+    }
+    if (pos != data.size()) {
+        throw std::runtime_error(corrupted);
+    }
+    return out;
+}
+
+uint32_t LZ_Codec::get_dictionary_id() const {
+    if (m_Dictionary.empty()) {
+        return 0;
+    }
+    uint32_t hash = 2166136261u;
+    for (const auto & x: m_Dictionary) {
+        hash ^= static_cast<unsigned char>(x);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+const std::string & LZ_Codec::get_dictionary() const {
+    return m_Dictionary;
+}
+
+std::string LZ_Codec::train(const std::vector<std::string> & samples,
+                            const size_t max_size) {
+    std::map<std::string, size_t> occurrences;
+    for (const auto & sample: samples) {
+        size_t line_begin = 0;
+        while (line_begin < sample.size()) {
+            size_t line_end = sample.find('\n', line_begin);
+            if (line_end == std::string::npos) {
+                line_end = sample.size();
+            }
+            // Include the newline, it's a part of the phrase as well
+            const std::string line = sample.substr(line_begin, line_end + 1 - line_begin);
+            if (line.size() > m_MIN_MATCH) {
+                occurrences[line]++;
+            }
+            size_t colon = line.find(": ");
+            if (colon != std::string::npos && colon + 2 < line.size()) {
+                occurrences[line.substr(0, colon + 2)]++;
+            }
+            line_begin = line_end + 1;
+        }
+    }
+
+    // Score is a number of bytes saved by having the phrase in a dictionary
+    std::vector<std::pair<size_t, std::string>> phrases;
+    for (const auto & x: occurrences) {
+        if (x.second > 1) {
+            phrases.emplace_back((x.second - 1) * x.first.size(), x.first);
+        }
+    }
+    std::sort(phrases.begin(), phrases.end(),
+              [](const auto & a, const auto & b) { return a.first > b.first; });
+
+    std::vector<std::string> chosen;
+    size_t total = 0;
+    for (const auto & x: phrases) {
+        if (total + x.second.size() > max_size) {
+            continue;
+        }
+        total += x.second.size();
+        chosen.push_back(x.second);
+    }
+
+    // The best phrases go to the end of the dictionary
+    std::string dictionary;
+    dictionary.reserve(total);
+    for (auto it = chosen.rbegin(); it != chosen.rend(); it++) {
+        dictionary.append(*it);
+    }
+    return dictionary;
+}
@@ -0,0 +1,92 @@
+#ifndef LZ_CODEC_HPP
+#define LZ_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A small dependency-free LZ77 (LZSS) codec, used by Note_Storage
+ * to compress note files.
+ *
+ * The codec can be primed with a shared dictionary: its content is treated
+ * as if it preceded the data, so even short notes can reference
+ * the repetitive changelog phrases ("Added item: ", " with deadline: ").
+ */
+class LZ_Codec {
+    private:
+        // Matches are encoded with 2 bytes of offset and 1 byte of length.
+        static constexpr size_t m_MIN_MATCH = 3,
+                                m_MAX_MATCH = m_MIN_MATCH + 255,
+                                m_MAX_OFFSET = 65535,
+                                m_HASH_BITS = 15;
+
+        std::string m_Dictionary;
+        // Hash chains of the dictionary, built once: the last position
+        // of every hash3() and the previous position with the same hash
+        // of every position (m_NONE, if there is none).
+        std::vector<size_t> m_Dictionary_Head, m_Dictionary_Prev;
+
+        static constexpr size_t m_NONE = static_cast<size_t>(-1);
+
+        /**
+         * Hash 3 bytes starting at "data" (used to find match candidates).
+         *
+         * @param  data A pointer to at least 3 readable bytes.
+         * @return A hash in range [0; 2^m_HASH_BITS).
+         */
+        static size_t hash3(const unsigned char * data);
+
+    public:
+        // The biggest dictionary that still leaves a room for the data
+        // in a window.
+        static constexpr size_t m_MAX_DICTIONARY = 32768;
+
+        explicit LZ_Codec(const std::string & dictionary = "");
+
+        /**
+         * Compress the data.
+         *
+         * @param  data Data to compress.
+         * @return Compressed data (without any header).
+         */
+        std::string compress(const std::string & data) const;
+
+        /**
+         * Decompress the data.
+         *
+         * Throws std::runtime_error if the data are corrupted.
+         *
+         * @param  data     Data returned by compress().
+         * @param  raw_size A size of the original data.
+         * @return Original data.
+         */
+        std::string decompress(const std::string & data, const size_t raw_size) const;
+
+        /**
+         * Get an identifier of the dictionary (FNV-1a hash of it's content).
+         *
+         * @return Dictionary ID, 0 if there is no dictionary.
+         */
+        uint32_t get_dictionary_id() const;
+
+        const std::string & get_dictionary() const;
+
+        /**
+         * Build a shared dictionary from samples.
+         *
+         * Collects the most frequent lines and line prefixes (everything
+         * up to the first ": ") and puts those which save the most bytes
+         * in a dictionary, so the most valuable phrases are the nearest
+         * to the data.
+         *
+         * @param  samples  Sample files (e.g. whole notes).
+         * @param  max_size A maximal size of the dictionary.
+         * @return A dictionary.
+         */
+        static std::string train(const std::vector<std::string> & samples,
+                                 const size_t max_size = m_MAX_DICTIONARY);
+};
+
+#endif  // LZ_CODEC_HPP
@@ -1,10 +1,434 @@
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <filesystem>
+#include <sstream>
 #include "note_storage.hpp"
+#include "integrity_checker.hpp"
+#include "bulk_importer.hpp"
 #include "menu.hpp"
+#include "server/note_server.hpp"
+#include "server/note_client.hpp"
+#include "exports/export.hpp"
+#include "exports/json_lines_export.hpp"
+#include "exports/csv_export.hpp"
+#include "exports/site_export.hpp"
+#include "trace.hpp"
+#include "retention_policy.hpp"
+#include "note_sync.hpp"
+#include "timestamp.hpp"
 
-int main() {
+/**
+ * Print usage of the command line modes.
+ *
+ * @param name A name of the binary.
+ */
+void print_usage(const char * name) {
+    std::cerr << "Usage: " << name << std::endl
+              << "       " << name << " fsck [--repair] [--threads N] [--report file]" << std::endl
+              << "       " << name << " dedup [--apply]" << std::endl
+              << "       " << name << " import [--threads N] <source> [directory]" << std::endl
+              << "       " << name << " export <jsonl|csv> <destination> [directory]" << std::endl
+              << "       " << name << " site [--threads N] <destination> [directory]" << std::endl
+              << "       " << name << " layout [flat|date]" << std::endl
+              << "       " << name << " layout bench [notes]" << std::endl
+              << "       " << name << " retention [off | [--entries N] [--days N] [--squash] [--archive]]" << std::endl
+              << "       " << name << " compact" << std::endl
+              << "       " << name << " history <path> [undo | redo | \"YYYY-MM-DD, HH:MM:SS\"]" << std::endl
+              << "       " << name << " sync <directory>" << std::endl
+              << "       " << name << " sync --socket socket" << std::endl
+              << "       " << name << " serve [socket]" << std::endl
+              << "       " << name << " client [--socket socket] list" << std::endl
+              << "       " << name << " client [--socket socket] read <path>" << std::endl
+              << "       " << name << " client [--socket socket] search <text>" << std::endl
+              << "       " << name << " client [--socket socket] export <path> <destination> [markdown]" << std::endl
+              << "       " << name << " client [--socket socket] create <directory> < note" << std::endl
+              << "       " << name << " client [--socket socket] reload" << std::endl
+              << std::endl
+              << "Set NOTEPAD_TRACE=<file> to write a Chrome trace to the file" << std::endl
+              << "and a summary of timings to stderr on exit." << std::endl;
+}
+
+/**
+ * Check integrity of all notes and possibly repair them.
+ *
+ * Writes a JSON Lines report to stdout or to a file and a summary
+ * to stderr. Throws std::invalid_argument if got invalid arguments.
+ *
+ * @param  notes_store A storage to check.
+ * @param  args        Command line arguments ("fsck" and it's options).
+ * @return 0, if all notes are fine;
+ *         1 otherwise.
+ */
+int check_storage(Note_Storage & notes_store, const std::vector<std::string> & args) {
+    bool repair = false;
+    unsigned threads = 0;
+    std::string report_path;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args.at(i) == "--repair") {
+            repair = true;
+        }
+        else if (args.at(i) == "--threads" && i + 1 < args.size()) {
+            threads = static_cast<unsigned>(std::stoul(args.at(++i)));
+        }
+        else if (args.at(i) == "--report" && i + 1 < args.size()) {
+            report_path = args.at(++i);
+        }
+        else {
+            throw std::invalid_argument("check_storage(): Invalid argument " + args.at(i) + '.');
+        }
+    }
+
+    const std::vector<Check_Result> results = Integrity_Checker(notes_store).check(repair, threads);
+    if (report_path.size()) {
+        std::ofstream report(report_path);
+        Integrity_Checker::write_report(report, results);
+        report.close();
+        if (!report.good()) {
+            throw std::runtime_error("check_storage(): Couldn't write the report.");
+        }
+    }
+    else {
+        Integrity_Checker::write_report(std::cout, results);
+    }
+
+    std::map<std::string, size_t> statuses;
+    size_t repaired = 0;
+    for (const auto & x: results) {
+        statuses[x.m_Status]++;
+        repaired += x.m_Repaired;
+    }
+    std::cerr << "INFO: Checked " << results.size() << " notes:";
+    for (const auto & x: statuses) {
+        std::cerr << ' ' << x.second << ' ' << x.first << ';';
+    }
+    std::cerr << ' ' << repaired << " repaired." << std::endl;
+    return statuses.size() == 1 && statuses.count("ok") ? 0 : 1;
+}
+
+/**
+ * Parse a retention policy of changelogs.
+ *
+ * Throws std::invalid_argument if got invalid arguments.
+ *
+ * @param  args Command line arguments ("retention" and it's options).
+ * @return A policy.
+ */
+Retention_Policy parse_retention(const std::vector<std::string> & args) {
+    if (args.size() == 2 && args.at(1) == "off") {
+        return Retention_Policy();
+    }
+    size_t max_entries = 0;
+    unsigned max_age_days = 0;
+    bool squash = false, archive = false;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args.at(i) == "--entries" && i + 1 < args.size()) {
+            max_entries = std::stoul(args.at(++i));
+        }
+        else if (args.at(i) == "--days" && i + 1 < args.size()) {
+            max_age_days = static_cast<unsigned>(std::stoul(args.at(++i)));
+        }
+        else if (args.at(i) == "--squash") {
+            squash = true;
+        }
+        else if (args.at(i) == "--archive") {
+            archive = true;
+        }
+        else {
+            throw std::invalid_argument("parse_retention(): Invalid argument " + args.at(i) + '.');
+        }
+    }
+    return Retention_Policy(max_entries, max_age_days, squash, archive);
+}
+
+/**
+ * Compare flat and date-sharded layouts: create notes spread over 3 years
+ * in a scratch directory, scan them, read and delete some of them.
+ *
+ * The storage's layout is restored afterwards.
+ *
+ * @param notes_store A storage where to run the benchmark.
+ * @param cnt         A number of notes.
+ */
+void benchmark_layouts(Note_Storage & notes_store, const size_t cnt) {
+    namespace fs = std::filesystem;
+    using Clock = std::chrono::steady_clock;
+
+    // Scratch directory is metadata, so it's not seen by anything else
+    const std::string dir = ".layout_bench";
+    const Note_Storage::Layout original = notes_store.get_layout();
+    auto seconds = [](Clock::time_point begin) {
+        return std::chrono::duration<double>(Clock::now() - begin).count();
+    };
+
+    std::cout << std::setw(8) << "layout" << std::setw(12) << "create/s"
+              << std::setw(12) << "scan/s" << std::setw(12) << "read/s"
+              << std::setw(12) << "delete/s" << std::endl;
+    try {
+        for (const auto layout: { Note_Storage::Layout::FLAT, Note_Storage::Layout::DATE }) {
+            notes_store.set_layout(layout);
+            fs::remove_all(notes_store.get_notes_path() + dir);
+
+            std::vector<std::string> paths;
+            std::mt19937 random(42);
+            auto begin = Clock::now();
+            for (size_t i = 0; i < cnt; i++) {
+                // About 3 years of notes
+                const long day = static_cast<long>(random() % 1095);
+                std::tm date = {};
+                date.tm_year = 121;
+                date.tm_mday = 1 + static_cast<int>(day);
+                std::mktime(&date);
+                std::ostringstream timestamp;
+                timestamp << std::put_time(&date, "%Y_%m_%d__%H_%M_%S") << '_' << std::setw(6)
+                          << std::setfill('0') << i;
+                std::istringstream text("text\n\n" + timestamp.str() + "\n\nBenchmark\n\n\n"
+                                        "2021-01-01, 00:00:00\n\tCreated note.\n\n\nBenchmark text.\n");
+                std::string note_dir = dir;
+                notes_store.update(*notes_store.parse(text), note_dir);
+                paths.push_back(note_dir + timestamp.str());
+            }
+            const double create = seconds(begin);
+
+            begin = Clock::now();
+            const size_t scanned = notes_store.read_recursively(dir).size();
+            const double scan = seconds(begin);
+
+            std::shuffle(paths.begin(), paths.end(), random);
+            const size_t sample = std::max<size_t>(1, cnt / 10);
+            begin = Clock::now();
+            for (size_t i = 0; i < sample; i++) {
+                notes_store.read(paths.at(i), false);
+            }
+            const double read = seconds(begin);
+
+            begin = Clock::now();
+            for (size_t i = 0; i < sample; i++) {
+                notes_store.delete_note(paths.at(i));
+            }
+            const double remove = seconds(begin);
+
+            std::cout << std::setw(8) << (layout == Note_Storage::Layout::FLAT ? "flat" : "date")
+                      << std::fixed << std::setprecision(0)
+                      << std::setw(12) << cnt / create << std::setw(12) << scanned / scan
+                      << std::setw(12) << sample / read << std::setw(12) << sample / remove << std::endl;
+            fs::remove_all(notes_store.get_notes_path() + dir);
+        }
+    }
+    catch (...) {
+        std::error_code error;
+        fs::remove_all(notes_store.get_notes_path() + dir, error);
+        notes_store.set_layout(original);
+        throw;
+    }
+    notes_store.set_layout(original);
+}
+
+int main(int argc, char ** argv) {
+    Trace::init_from_env();
     Note_Storage notes_store;
+    const std::string default_socket = notes_store.get_notes_path() + ".notepad.sock";
+
+    if (argc > 1) {
+        std::vector<std::string> args(argv + 1, argv + argc);
+        try {
+            if (args.front() == "fsck") {
+                return check_storage(notes_store, args);
+            }
+            else if (args.front() == "dedup" && args.size() == 1) {
+                for (const auto & group: notes_store.find_duplicates()) {
+                    for (const auto & path: group) {
+                        std::cout << path << std::endl;
+                    }
+                    std::cout << std::endl;
+                }
+                return 0;
+            }
+            else if (args.front() == "dedup" && args.size() == 2 && args.at(1) == "--apply") {
+                Dedup_Stats stats = notes_store.deduplicate();
+                std::cout << "INFO: Replaced " << stats.m_Replaced << " notes in "
+                          << stats.m_Groups << " groups of duplicates, saved "
+                          << stats.m_Bytes_Saved << " B, removed " << stats.m_Objects_Removed
+                          << " unreferenced shared notes." << std::endl;
+                return 0;
+            }
+            else if (args.front() == "import" && args.size() >= 2) {
+                unsigned threads = 0;
+                args.erase(args.begin());
+                if (args.front() == "--threads" && args.size() >= 3) {
+                    threads = static_cast<unsigned>(std::stoul(args.at(1)));
+                    args.erase(args.begin(), args.begin() + 2);
+                }
+                if (args.size() <= 2) {
+                    const std::vector<Import_Result> results = Bulk_Importer(notes_store).import(
+                        args.front(), args.size() == 2 ? args.at(1) : "", threads);
+                    Bulk_Importer::write_summary(std::cerr, results);
+                    for (const auto & x: results) {
+                        if (x.m_Status == "failed") {
+                            return 1;
+                        }
+                    }
+                    return 0;
+                }
+            }
+            else if (args.front() == "export" && (args.size() == 3 || args.size() == 4)) {
+                std::unique_ptr<Export> file_format;
+                if (args.at(1) == "jsonl") {
+                    file_format = std::make_unique<JSON_Lines_Export>(args.at(2));
+                }
+                else if (args.at(1) == "csv") {
+                    file_format = std::make_unique<CSV_Export>(args.at(2));
+                }
+                else {
+                    throw std::invalid_argument("main(): Invalid file format " + args.at(1) + '.');
+                }
+                size_t cnt = notes_store.export_notes_standard_format(file_format,
+                                                                      args.size() == 4 ? args.at(3) : "");
+                std::cerr << "INFO: Exported " << cnt << " notes." << std::endl;
+                return 0;
+            }
+            else if (args.front() == "site" && args.size() >= 2) {
+                unsigned threads = 0;
+                args.erase(args.begin());
+                if (args.front() == "--threads" && args.size() >= 3) {
+                    threads = static_cast<unsigned>(std::stoul(args.at(1)));
+                    args.erase(args.begin(), args.begin() + 2);
+                }
+                if (args.size() <= 2) {
+                    Site_Export site(args.front(), threads);
+                    Site_Stats stats = notes_store.export_site(site, args.size() == 2 ? args.at(1) : "");
+                    std::cerr << "INFO: Rendered " << stats.m_Rendered << " notes, "
+                              << stats.m_Unchanged << " unchanged, removed "
+                              << stats.m_Removed << " pages." << std::endl;
+                    return 0;
+                }
+            }
+            else if (args.front() == "layout" && args.size() == 1) {
+                std::cout << (notes_store.get_layout() == Note_Storage::Layout::DATE ? "date" : "flat")
+                          << std::endl;
+                return 0;
+            }
+            else if (args.front() == "layout" && args.size() == 2
+                     && (args.at(1) == "flat" || args.at(1) == "date")) {
+                notes_store.set_layout(args.at(1) == "date" ? Note_Storage::Layout::DATE
+                                                            : Note_Storage::Layout::FLAT);
+                std::cerr << "INFO: Moved " << notes_store.migrate_layout() << " notes." << std::endl;
+                return 0;
+            }
+            else if (args.front() == "layout" && args.size() <= 3 && args.at(1) == "bench") {
+                benchmark_layouts(notes_store, args.size() == 3 ? std::stoul(args.at(2)) : 100000);
+                return 0;
+            }
+            else if (args.front() == "retention") {
+                if (args.size() > 1) {
+                    notes_store.set_retention(parse_retention(args));
+                }
+                std::cout << notes_store.get_retention() << std::endl;
+                return 0;
+            }
+            else if (args.front() == "compact" && args.size() == 1) {
+                Compaction_Stats stats = notes_store.compact_notes();
+                std::cout << "INFO: Trimmed " << stats.m_Entries << " changes of "
+                          << stats.m_Notes << " notes, saved " << stats.m_Bytes_Saved
+                          << " B." << std::endl;
+                return 0;
+            }
+            else if (args.front() == "history" && (args.size() == 2 || args.size() == 3)) {
+                std::unique_ptr<Note> note = notes_store.read(args.at(1), false);
+                notes_store.load_history(args.at(1), *note);
+                if (args.size() == 2) {
+                    note->get_history().print(std::cout);
+                    return 0;
+                }
+                else if (args.at(2) == "undo" || args.at(2) == "redo") {
+                    if (args.at(2) == "undo") {
+                        note->undo();
+                    }
+                    else {
+                        note->redo();
+                    }
+                    const size_t slash = args.at(1).find_last_of('/');
+                    std::string dir = slash == std::string::npos ? "" : args.at(1).substr(0, slash);
+                    notes_store.update(*note, dir);
+                    note->print(std::cout);
+                    return 0;
+                }
+                const Timestamp date(args.at(2));
+                if (!date.is_valid()) {
+                    throw std::invalid_argument("main(): Invalid date " + args.at(2) + '.');
+                }
+                else if (!note->rewind(date)) {
+                    throw std::invalid_argument("main(): History of the note starts after " + args.at(2) + '.');
+                }
+                note->print(std::cout);
+                return 0;
+            }
+            else if (args.front() == "sync" && (args.size() == 2 || (args.size() == 3 && args.at(1) == "--socket"))) {
+                std::vector<Sync_Result> results;
+                uint64_t transferred = 0;
+                if (args.size() == 3) {
+                    Remote_Peer peer(args.at(2));
+                    results = Note_Sync(notes_store).sync(peer, args.at(2));
+                    transferred = peer.get_transferred();
+                }
+                else {
+                    // Both storages are locked, it would wait for itself
+                    if (std::filesystem::exists(args.at(1))
+                        && std::filesystem::equivalent(args.at(1), notes_store.get_notes_path())) {
+                        throw std::invalid_argument("main(): Can't synchronize the storage with itself.");
+                    }
+                    Note_Storage other_store(args.at(1));
+                    Local_Peer peer(other_store);
+                    results = Note_Sync(notes_store).sync(peer, std::filesystem::weakly_canonical(args.at(1)).string());
+                    transferred = peer.get_transferred();
+                }
+                Note_Sync::write_summary(std::cerr, results, transferred);
+                for (const auto & x: results) {
+                    if (x.m_Action == "failed") {
+                        return 1;
+                    }
+                }
+                return 0;
+            }
+            else if (args.front() == "serve" && args.size() <= 2) {
+                Note_Server server(notes_store, args.size() == 2 ? args.at(1) : default_socket);
+                server.run();
+                return 0;
+            }
+            else if (args.front() == "client" && args.size() >= 2) {
+                std::string socket = default_socket;
+                args.erase(args.begin());
+                if (args.front() == "--socket" && args.size() >= 3) {
+                    socket = args.at(1);
+                    args.erase(args.begin(), args.begin() + 2);
+                }
+                std::string body;
+                if (args.front() == "create") {
+                    body.assign(std::istreambuf_iterator<char>(std::cin),
+                                std::istreambuf_iterator<char>());
+                }
+                Note_Client client(socket);
+                std::cout << client.request(args, body);
+                return 0;
+            }
+        }
+        catch (const std::exception & e) {
+            std::cerr << "ERROR: " << e.what() << std::endl;
+            return 1;
+        }
+        print_usage(argv[0]);
+        return 1;
+    }
+
     Menu menu_emulation(notes_store);
     menu_emulation.print_heading();
     for (;;) {
@@ -5,15 +5,10 @@
 #include <memory>
 #include <filesystem>
 #include <cstddef>
-#include <chrono>
-#include <iomanip>
-#include <sstream>
 #include "menu.hpp"
 #include "note_storage.hpp"
 #include "notes/note.hpp"
-#include "notes/text.hpp"
-#include "notes/shopping_list.hpp"
-#include "notes/todo_list.hpp"
+#include "notes/note_registry.hpp"
 #include "filters/filter.hpp"
 #include "filters/name_filter.hpp"
 #include "filters/creation_date_filter.hpp"
@@ -22,7 +17,14 @@
 #include "filters/text_filter.hpp"
 #include "exports/export.hpp"
 #include "exports/markdown_export.hpp"
+#include "exports/json_lines_export.hpp"
+#include "exports/csv_export.hpp"
+#include "exports/site_export.hpp"
 #include "heading.hpp"
+#include "result_order.hpp"
+#include "note_presenter.hpp"
+#include "bulk_importer.hpp"
+#include "timestamp.hpp"
 
 void Menu::create_note() const {
     std::string current_date = m_Notes_Store.get_file_timestamp();
@@ -30,29 +32,21 @@ void Menu::create_note() const {
 
     // We shouldn't leave creating a note, unless we got an stdin error
     for (;;) {
-        std::cout << "Please enter the type of note you'd like to create:" << std::endl
-                  << "\t\"Text\" ('T') for a text note;" << std::endl
-                  << "\t\"Shopping List\" (\"ST\") for a shopping list;" << std::endl
-                  << "\t\"To-do list\" (\"TDL\") for a to-do list;" << std::endl;
+        std::cout << "Please enter the type of note you'd like to create:" << std::endl;
+        for (const auto & x: Note_Registry::get_types()) {
+            const char quote = x.m_Short_Name.size() == 1 ? '\'' : '"';
+            std::cout << "\t\"" << x.m_Title << "\" (" << quote << x.m_Short_Name << quote
+                      << ") for " << x.m_Description << ';' << std::endl;
+        }
         std::string note_type;
         std::getline(std::cin, note_type);
         if (!std::cin.good()) {
             throw std::runtime_error("Menu::create_note(): Couldn't read a type of a new note.");
         }
 
-        std::transform(note_type.begin(), note_type.end(),
-                       note_type.begin(), ::tolower);
-
-        if (!note_type.compare("text") || !note_type.compare("t")) {
-            new_note = std::make_unique<Text>(current_date);
-            break;
-        }
-        else if (!note_type.compare("shopping list") || !note_type.compare("st")) {
-            new_note = std::make_unique<Shopping_List>(current_date);
-            break;
-        }
-        else if (!note_type.compare("to-do list") || !note_type.compare("tdl")) {
-            new_note = std::make_unique<TODO_List>(current_date);
+        const Note_Type * type = Note_Registry::find_by_user_name(note_type);
+        if (type) {
+            new_note = type->m_Create(current_date);
             break;
         }
         std::cerr << "ERROR: Menu::create_note(): Invalid note type." << std::endl << std::endl;
@@ -99,11 +93,13 @@ void Menu::display_note() const {
         std::transform(answer.begin(), answer.end(),
                        answer.begin(), ::tolower);
         if (!answer.compare("yes") || !answer.compare("y")) {
+            Note_Presenter presenter(std::cout, std::cin, m_PAGE_LINES, m_RESULT_LIMITS);
             for (const auto & x: m_Notes_Store.m_Filtered) {
-                std::cout << x.first << std::endl;
-                x.second->print(std::cout);
-                std::cout << std::endl << std::endl;
+                if (!presenter.show(x.first, *x.second)) {
+                    break;
+                }
             }
+            presenter.finish();
         }
     }
 
@@ -125,18 +121,21 @@ void Menu::display_note() const {
     if (path.back() != '/') {
         path.push_back('/');
     }
+    Note_Presenter presenter(std::cout, std::cin, m_PAGE_LINES);
     try {
         auto list_to_print = m_Notes_Store.read_recursively(path);
         for (const auto & x: list_to_print) {
-            std::cout << x.first << std::endl
-                      << x.second->get_summary() << std::endl << std::endl;
+            if (!presenter.show_summary(x.first, *x.second)) {
+                break;
+            }
         }
     }
     catch (const std::filesystem::filesystem_error & e) {
         // Not a dir - trying as a file
         path.pop_back();
-        m_Notes_Store.read(path, false)->print(std::cout);
+        presenter.show(path, *m_Notes_Store.read(path, false));
     }
+    presenter.finish();
 }
 
 void Menu::search_notes() const {
@@ -205,17 +204,33 @@ void Menu::search_notes() const {
             }
         }
     }
+    for (;;) {
+        std::cout << std::endl;
+        try {
+            Result_Order order;
+            order.request_order();
+            order.apply(m_Notes_Store.m_Filtered);
+            break;
+        }
+        catch (const std::invalid_argument & e) {
+            std::cerr << "ERROR: " << e.what() << std::endl;
+        }
+    }
+
     std::cout << std::endl
               << "INFO: Notes were successfully filtered." << std::endl
               << "INFO: You can now either list (display) or export them." << std::endl;
 }
 
 void Menu::list_all() const {
+    Note_Presenter presenter(std::cout, std::cin, m_PAGE_LINES);
     auto list_to_print = m_Notes_Store.read_recursively("");
     for (const auto & x: list_to_print) {
-        std::cout << x.first << std::endl
-                  << x.second->get_summary() << std::endl << std::endl;
+        if (!presenter.show_summary(x.first, *x.second)) {
+            break;
+        }
     }
+    presenter.finish();
 }
 
 void Menu::edit_note() const {
@@ -247,6 +262,78 @@ void Menu::edit_note() const {
     std::cout << "INFO: Successfully saved file with edited note." << std::endl;
 }
 
+void Menu::note_history() const {
+    std::cout << "Please write a path to a note, which history you want to see." << std::endl
+              << "Enter empty line to return to the previous screen:" << std::endl
+              << '\t';
+    std::string path;
+    std::getline(std::cin, path);
+    if (!std::cin.good()) {
+        throw std::runtime_error("Menu::note_history(): Couldn't read path.");
+    }
+    else if (!path.size()) {
+        return;
+    }
+
+    std::cout << std::endl;
+    std::unique_ptr<Note> note = m_Notes_Store.read(path, false);
+    m_Notes_Store.load_history(path, *note);
+    note->get_history().print(std::cout);
+    std::cout << std::endl
+              << "Enter \"undo\" ('U') to undo the last change," << std::endl
+              << "\"redo\" ('R') to redo the last undone change," << std::endl
+              << "a date (\"YYYY-MM-DD, HH:MM:SS\") to show the note as of the date," << std::endl
+              << "or nothing to return to the previous screen." << std::endl
+              << '\t';
+    std::string answer;
+    std::getline(std::cin, answer);
+    if (!std::cin.good()) {
+        throw std::runtime_error("Menu::note_history(): Couldn't read answer.");
+    }
+    else if (!answer.size()) {
+        return;
+    }
+
+    std::cout << std::endl;
+    std::string lower = answer;
+    std::transform(lower.begin(), lower.end(),
+                   lower.begin(), ::tolower);
+    const bool undo = !lower.compare("undo") || !lower.compare("u"),
+               redo = !lower.compare("redo") || !lower.compare("r");
+    if (undo || redo) {
+        try {
+            if (undo) {
+                note->undo();
+            }
+            else {
+                note->redo();
+            }
+        }
+        catch (const std::invalid_argument & e) {
+            std::cerr << "ERROR: " << e.what() << std::endl;
+            return;
+        }
+        const size_t slash = path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "" : path.substr(0, slash);
+        m_Notes_Store.update(*note, dir);
+        std::cout << "INFO: Successfully saved the note." << std::endl;
+        return;
+    }
+
+    const Timestamp date(answer);
+    if (!date.is_valid()) {
+        std::cerr << "ERROR: Menu::note_history(): Invalid date." << std::endl;
+    }
+    else if (!note->rewind(date)) {
+        std::cerr << "ERROR: Menu::note_history(): History of the note starts after the date." << std::endl;
+    }
+    else {
+        Note_Presenter presenter(std::cout, std::cin, m_PAGE_LINES);
+        presenter.show(path, *note);
+        presenter.finish();
+    }
+}
+
 void Menu::delete_note() const {
     std::cout << "Please write a path to a note (or a directory of notes) you want to delete." << std::endl
               << "If you're not sure, you should use \"List All\" to see all available notes." << std::endl
@@ -286,6 +373,74 @@ void Menu::export_notes() const {
         std::transform(answer.begin(), answer.end(),
                        answer.begin(), ::tolower);
         if (!answer.compare("yes") || !answer.compare("y")) {
+            std::cout << std::endl
+                      << "Do you want to export all of them into one file?" << std::endl
+                      << "\t\"JSON Lines\" ('J') for JSON Lines;" << std::endl
+                      << "\t\"CSV\" ('C') for CSV;" << std::endl
+                      << "\t\"HTML\" ('H') for a static HTML site (a directory);" << std::endl
+                      << "\tAnything else to choose notes one by one." << std::endl
+                      << '\t';
+            std::getline(std::cin, answer);
+            if (!std::cin.good()) {
+                throw std::runtime_error("Menu::export_notes(): Couldn't read answer.");
+            }
+
+            std::transform(answer.begin(), answer.end(),
+                           answer.begin(), ::tolower);
+            const bool json_lines = !answer.compare("json lines") || !answer.compare("j"),
+                       csv = !answer.compare("csv") || !answer.compare("c"),
+                       html = !answer.compare("html") || !answer.compare("h");
+            if (json_lines || csv || html) {
+                std::string path;
+                for (;;) {
+                    std::cout << std::endl
+                              << "Enter an absolute path where you want to export the notes." << std::endl
+                              << '\t';
+                    std::getline(std::cin, path);
+                    if (!std::cin.good()) {
+                        throw std::runtime_error("Menu::export_notes(): Couldn't read path where to export the notes to.");
+                    }
+                    else if (path.front() != '/') {
+                        std::cerr << "ERROR: Menu::export_notes(): Path must be absolute." << std::endl;
+                    }
+                    else {
+                        break;
+                    }
+                }
+
+                if (html) {
+                    std::cout << std::endl;
+                    try {
+                        Site_Export site(path);
+                        Site_Stats stats = m_Notes_Store.export_filtered_site(site);
+                        std::cout << "INFO: Successfully exported the notes (rendered "
+                                  << stats.m_Rendered << ", " << stats.m_Unchanged
+                                  << " unchanged)." << std::endl;
+                    }
+                    catch (const std::runtime_error & e) {
+                        std::cerr << "ERROR: " << e.what() << std::endl;
+                    }
+                    return;
+                }
+
+                std::unique_ptr<Export> file_format;
+                if (json_lines) {
+                    file_format = std::make_unique<JSON_Lines_Export>(path);
+                }
+                else {
+                    file_format = std::make_unique<CSV_Export>(path);
+                }
+                std::cout << std::endl;
+                try {
+                    m_Notes_Store.export_filtered_standard_format(file_format);
+                    std::cout << "INFO: Successfully exported the notes." << std::endl;
+                }
+                catch (const std::runtime_error & e) {
+                    std::cerr << "ERROR: " << e.what() << std::endl;
+                }
+                return;
+            }
+
             for (const auto & x: m_Notes_Store.m_Filtered) {
                 std::cout << std::endl
                           << x.first << std::endl
@@ -370,6 +525,8 @@ void Menu::export_note(const std::unique_ptr<Note> & to_export) const {
         for (;;) {
             std::cout << "Enter a format you want to export the note to:" << std::endl
                       << "\t\"Markdown\" ('M') for Markdown;" << std::endl
+                      << "\t\"JSON Lines\" ('J') for JSON Lines;" << std::endl
+                      << "\t\"CSV\" ('C') for CSV;" << std::endl
                       << '\t';
             std::getline(std::cin, answer);
             if (!std::cin.good()) {
@@ -381,6 +538,12 @@ void Menu::export_note(const std::unique_ptr<Note> & to_export) const {
             if (!answer.compare("markdown") || !answer.compare("m")) {
                 file_format = std::make_unique<Markdown_Export>(path);
             }
+            else if (!answer.compare("json lines") || !answer.compare("j")) {
+                file_format = std::make_unique<JSON_Lines_Export>(path);
+            }
+            else if (!answer.compare("csv") || !answer.compare("c")) {
+                file_format = std::make_unique<CSV_Export>(path);
+            }
             else {
                 std::cerr << "ERROR: Menu::export_note(): Invalid file format." << std::endl << std::endl;
                 continue;
@@ -410,7 +573,8 @@ void Menu::export_note(const std::unique_ptr<Note> & to_export) const {
 }
 
 void Menu::import_note() const {
-    std::cout << "Enter the path to a file with a note you want to import.";
+    std::cout << "Enter the path to a file with a note you want to import" << std::endl
+              << "(or to a directory to import all notes in it).";
     std::string path;
     for (;;) {
         std::cout << std::endl
@@ -427,9 +591,13 @@ void Menu::import_note() const {
     }
 
     std::cout << std::endl;
+    const std::string source = path;
+    const bool bulk = std::filesystem::is_directory(source);
     std::unique_ptr<Note> to_import;
     try {
-        to_import = m_Notes_Store.read(path, true);
+        if (!bulk) {
+            to_import = m_Notes_Store.read(path, true);
+        }
     }
     catch (const std::runtime_error & e) {
         std::cerr << "ERROR: " << e.what() << std::endl;
@@ -453,10 +621,79 @@ void Menu::import_note() const {
         }
     }
     std::cout << std::endl;
+    if (bulk) {
+        try {
+            Bulk_Importer::write_summary(std::cout, Bulk_Importer(m_Notes_Store).import(source, path));
+        }
+        catch (const std::runtime_error & e) {
+            std::cerr << "ERROR: " << e.what() << std::endl;
+        }
+        return;
+    }
     m_Notes_Store.update(*to_import.get(), path);
     std::cout << "INFO: Successfully imported a note." << std::endl;
 }
 
+void Menu::compression() const {
+    std::cout << "Compression of saved notes is "
+              << (m_Notes_Store.get_compression() ? "ON" : "OFF") << '.' << std::endl
+              << "Please enter what you'd like to do:" << std::endl
+              << "\t\"Enable\" ('E') to compress notes on save;" << std::endl
+              << "\t\"Disable\" ('D') to save notes uncompressed;" << std::endl
+              << "\t\"Train\" ('T') to train a compression dictionary on existing notes;" << std::endl
+              << "\t\"Rewrite\" ('R') to save all notes again with current settings;" << std::endl
+              << "\t\"Statistics\" ('S') to show compression ratio and decoding speed." << std::endl
+              << "Enter empty line to return to the previous screen:" << std::endl
+              << '\t';
+    std::string action;
+    std::getline(std::cin, action);
+    if (!std::cin.good()) {
+        throw std::runtime_error("Menu::compression(): Couldn't read an action.");
+    }
+
+    std::cout << std::endl;
+    std::transform(action.begin(), action.end(),
+                   action.begin(), ::tolower);
+    try {
+        if (!action.compare("enable") || !action.compare("e")) {
+            m_Notes_Store.set_compression(true);
+            std::cout << "INFO: Notes will be compressed from now on." << std::endl;
+        }
+        else if (!action.compare("disable") || !action.compare("d")) {
+            m_Notes_Store.set_compression(false);
+            std::cout << "INFO: Notes won't be compressed from now on." << std::endl;
+        }
+        else if (!action.compare("train") || !action.compare("t")) {
+            size_t size = m_Notes_Store.train_dictionary();
+            std::cout << "INFO: Trained a dictionary of " << size << " bytes." << std::endl;
+        }
+        else if (!action.compare("rewrite") || !action.compare("r")) {
+            size_t cnt = m_Notes_Store.rewrite_all();
+            std::cout << "INFO: Rewrote " << cnt << " notes." << std::endl;
+        }
+        else if (!action.compare("statistics") || !action.compare("s")) {
+            m_Notes_Store.reset_compression_stats();
+            m_Notes_Store.read_recursively("");
+            Compression_Stats stats = m_Notes_Store.get_compression_stats();
+            std::cout << "Compressed notes: " << stats.m_Notes << std::endl;
+            if (stats.m_Notes) {
+                std::cout << "Original size: " << stats.m_Raw_Bytes << " B" << std::endl
+                          << "Compressed size: " << stats.m_Compressed_Bytes << " B" << std::endl
+                          << "Compression ratio: "
+                          << static_cast<double>(stats.m_Raw_Bytes) / stats.m_Compressed_Bytes << std::endl
+                          << "Decoding speed: "
+                          << stats.m_Raw_Bytes / (stats.m_Decode_Seconds + 1e-9) / 1e6 << " MB/s" << std::endl;
+            }
+        }
+        else if (action.size()) {
+            std::cerr << "ERROR: Menu::compression(): Invalid action." << std::endl;
+        }
+    }
+    catch (const std::runtime_error & e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+    }
+}
+
 Menu::Menu(Note_Storage & notes_store)
     : m_Notes_Store(notes_store) { }
 
@@ -471,9 +708,11 @@ Menu::User_Choice Menu::ask_user() const {
               << "\t\"Search\" ('S') to search for a note with some filters;" << std::endl
               << "\t\"List All\" ('LA') to get brief description of all existing notes;" << std::endl
               << "\t\"Edit\" (\"ED\") to edit an existing note;" << std::endl
+              << "\t\"History\" (\"HI\") to undo changes of a note or to see it's older version;" << std::endl
               << "\t\"Delete\" (\"DD\") to delete an existing note;" << std::endl
               << "\t\"Export\" (\"EX\") to export an existing note to a file;" << std::endl
               << "\t\"Import\" ('I') to import a note from a file;" << std::endl
+              << "\t\"Compression\" (\"CM\") to set up compression of the notes;" << std::endl
               << "\t\"Quit\" ('Q') to close application." << std::endl;
 
     std::string action;
@@ -500,6 +739,9 @@ Menu::User_Choice Menu::ask_user() const {
     else if (!action.compare("edit") || !action.compare("ed")) {
         return User_Choice::EDIT;
     }
+    else if (!action.compare("history") || !action.compare("hi")) {
+        return User_Choice::HISTORY;
+    }
     else if (!action.compare("delete") || !action.compare("dd")) {
         return User_Choice::DELETE;
     }
@@ -509,6 +751,9 @@ Menu::User_Choice Menu::ask_user() const {
     else if (!action.compare("import") || !action.compare("i")) {
         return User_Choice::IMPORT;
     }
+    else if (!action.compare("compression") || !action.compare("cm")) {
+        return User_Choice::COMPRESSION;
+    }
     else if (!action.compare("quit") || !action.compare("q")) {
         return User_Choice::EXIT;
     }
@@ -545,6 +790,14 @@ bool Menu::process_request(const User_Choice & requested_action) {
         case User_Choice::EDIT:
             edit_note();
             break;
+        case User_Choice::HISTORY:
+            try {
+                note_history();
+            }
+            catch (const std::runtime_error & e) {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+            }
+            break;
         case User_Choice::DELETE:
             delete_note();
             break;
@@ -554,6 +807,9 @@ bool Menu::process_request(const User_Choice & requested_action) {
         case User_Choice::IMPORT:
             import_note();
             break;
+        case User_Choice::COMPRESSION:
+            compression();
+            break;
         case User_Choice::EXIT:
             return false;
     }
@@ -564,15 +820,5 @@ bool Menu::process_request(const User_Choice & requested_action) {
 // ---------------------------------------------------------------------------
 
 const std::string get_timestamp() {
-    // Get current time
-    auto now = std::chrono::system_clock::now();
-    std::time_t time = std::chrono::system_clock::to_time_t(now);
-
-    // Convert time to local time
-    std::tm localTime = *std::localtime(&time);
-
-    // Format time into a string
-    std::stringstream ss;
-    ss << std::put_time(&localTime, "%Y-%m-%d, %H:%M:%S");
-    return ss.str();
+    return Timestamp::now().to_string();
 }
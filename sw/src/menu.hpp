@@ -15,6 +15,10 @@
 struct Menu {
     private:
         const size_t m_DIST = 5;
+        // How many lines to display at once.
+        const size_t m_PAGE_LINES = 40;
+        // Limits of notes displayed from the filtered history.
+        const Print_Limits m_RESULT_LIMITS = { 10, 10 };
 
         Note_Storage & m_Notes_Store;
 
@@ -29,7 +33,8 @@ struct Menu {
          * Asks the user for the type of note they want to display.
          *
          * If there are some notes filtered in "m_Filtered",
-         * asks the user whether or not to display them.
+         * asks the user whether or not to display them (page by page,
+         * with long lists and changelogs truncated).
          * Throws std::runtime_error if got stdin error.
          */
         void display_note() const;
@@ -37,13 +42,16 @@ struct Menu {
         /**
          * Search for the notes by using filters defined in filters/.
          *
-         * Resets "m_Filtered" in "m_Notes_Store" and fills it with new results.
+         * Resets "m_Filtered" in "m_Notes_Store" and fills it with new results,
+         * sorted and limited as the user wants (see Result_Order).
          * Filter type reading is case insensitive.
          */
         void search_notes() const;
 
         /**
-         * Prints brief summary of all available notes.
+         * Prints brief summary of all available notes (page by page).
+         *
+         * Throws std::runtime_error if got stdin error.
          */
         void list_all() const;
 
@@ -54,6 +62,14 @@ struct Menu {
          */
         void edit_note() const;
 
+        /**
+         * Asks the user which note's history to show and then whether
+         * to undo or redo a change, or to show the note as of some date.
+         *
+         * Throws std::runtime_error if got stdin error.
+         */
+        void note_history() const;
+
         /**
          * Asks the user which note to delete.
          *
@@ -65,7 +81,8 @@ struct Menu {
          * Asks the user which note to export,
          *
          * If there are some notes filtered in "m_Filtered",
-         * asks the user whether or not to export them.
+         * asks the user whether or not to export them
+         * (either all into one JSON Lines or CSV file, or one by one).
          * Throws std::runtime_error if got stdin error.
          */
         void export_notes() const;
@@ -84,10 +101,20 @@ struct Menu {
         /**
          * Asks the user for a path to file with a note to import.
          *
+         * If the path is a directory, imports all notes in it
+         * with Bulk_Importer.
          * Throws std::runtime_error if got stdin error.
          */
         void import_note() const;
 
+        /**
+         * Asks the user how to set up compression of the notes
+         * and prints compression statistics.
+         *
+         * Throws std::runtime_error if got stdin error.
+         */
+        void compression() const;
+
     public:
         explicit Menu(Note_Storage & notes_store);
 
@@ -97,8 +124,8 @@ struct Menu {
         void print_heading() const;
 
         enum class User_Choice { CREATE, DISP, SEARCH, LIST_ALL,
-                                 EDIT, DELETE,
-                                 EXPORT, IMPORT, EXIT };
+                                 EDIT, HISTORY, DELETE,
+                                 EXPORT, IMPORT, COMPRESSION, EXIT };
         /**
          * Asks user for what they want to do.
          *
@@ -106,8 +133,9 @@ struct Menu {
          *             display an existing one by it's filename,
          *             search for a note with some filters,
          *             list all notes,
-         *             edit some note, delete it, export it
-         *             or exit.
+         *             edit some note, undo or redo it's changes,
+         *             delete it, export it,
+         *             set up compression or exit.
          * Method throws std::invalid_argument upon catching invalid request.
          * Method is case insensitive.
          *
@@ -0,0 +1,84 @@
+#include <cstddef>
+#include <string>
+#include <sstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include "note_presenter.hpp"
+#include "notes/note.hpp"
+
+Note_Presenter::Note_Presenter(std::ostream & os, std::istream & is, const size_t page_lines,
+                               const Print_Limits & limits)
+    : m_OS(os), m_IS(is), m_PAGE_LINES(page_lines), m_LIMITS(limits) { }
+
+bool Note_Presenter::add(const std::string & text) {
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        end = end == std::string::npos ? text.size() : end + 1;
+        // The prompt is shown only if there is something to show after it
+        if (m_PAGE_LINES && m_Lines == m_PAGE_LINES && !end_page()) {
+            m_Stopped = true;
+            return false;
+        }
+        m_Buffer.append(text, begin, end - begin);
+        m_Lines++;
+        begin = end;
+    }
+    if (m_Buffer.size() >= m_BUFFER_SIZE) {
+        m_OS.write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+        m_Buffer.clear();
+    }
+    return true;
+}
+
+bool Note_Presenter::end_page() {
+    m_OS.write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+    m_Buffer.clear();
+    if (m_Shown) {
+        m_OS << "Shown " << m_Shown << " notes." << '\n';
+    }
+    m_OS << "Enter empty line to show the next page, anything else to stop:" << '\n'
+         << '\t' << std::flush;
+
+    std::string answer;
+    std::getline(m_IS, answer);
+    if (!m_IS.good()) {
+        throw std::runtime_error("Note_Presenter::end_page(): Couldn't read answer.");
+    }
+    m_OS << '\n';
+    m_Lines = 0;
+    return !answer.size();
+}
+
+bool Note_Presenter::show(const std::string & path, const Note & note) {
+    if (m_Stopped) {
+        return false;
+    }
+    m_Note.str("");
+    m_Note << path << '\n';
+    note.print(m_Note, m_LIMITS);
+    m_Note << "\n\n";
+    if (!add(m_Note.str())) {
+        return false;
+    }
+    m_Shown++;
+    return true;
+}
+
+bool Note_Presenter::show_summary(const std::string & path, const Note & note) {
+    if (m_Stopped) {
+        return false;
+    }
+    if (!add(path + '\n' + note.get_summary() + "\n\n")) {
+        return false;
+    }
+    m_Shown++;
+    return true;
+}
+
+void Note_Presenter::finish() {
+    m_OS.write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+    m_Buffer.clear();
+    m_OS.flush();
+}
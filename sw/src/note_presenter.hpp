@@ -0,0 +1,99 @@
+#ifndef NOTE_PRESENTER_HPP
+#define NOTE_PRESENTER_HPP
+
+#include <cstddef>
+#include <string>
+#include <sstream>
+#include <istream>
+#include <ostream>
+#include "notes/note.hpp"
+
+/**
+ * Shows notes page by page.
+ *
+ * Notes are rendered one by one into a buffer, which is written out
+ * (and flushed) only when a page is full or when finished. After every
+ * full page the user is asked whether or not to continue, so nothing
+ * after the last shown page is rendered.
+ */
+class Note_Presenter {
+    private:
+        // Buffered text is written out when it's bigger than this.
+        static constexpr size_t m_BUFFER_SIZE = 1 << 16;
+
+        std::ostream & m_OS;
+        std::istream & m_IS;
+        // Lines on a page (0 for no pagination).
+        const size_t m_PAGE_LINES;
+        const Print_Limits m_LIMITS;
+
+        // Rendered text, which wasn't written out yet.
+        std::string m_Buffer;
+        // A note being rendered (reused, so it keeps it's memory).
+        std::ostringstream m_Note;
+        size_t m_Lines = 0, m_Shown = 0;
+        bool m_Stopped = false;
+
+        /**
+         * Add text to the page, line by line. Asks the user whether
+         * or not to continue, if there is a line over a full page.
+         *
+         * Throws std::runtime_error if got problem in input.
+         *
+         * @param  text Text to add.
+         * @return true, if added the whole text;
+         *      false, if the user stopped.
+         */
+        bool add(const std::string & text);
+
+        /**
+         * Write out the page and ask the user whether or not to continue.
+         *
+         * Throws std::runtime_error if got problem in input.
+         *
+         * @return true, if the user wants to continue;
+         *      false otherwise.
+         */
+        bool end_page();
+
+    public:
+        /**
+         * @param os         A stream where to show the notes.
+         * @param is         A stream where to read answers of the user.
+         * @param page_lines Lines on a page (0 for no pagination).
+         * @param limits     Limits of printed notes.
+         */
+        Note_Presenter(std::ostream & os, std::istream & is, const size_t page_lines,
+                       const Print_Limits & limits = Print_Limits());
+
+        /**
+         * Show a whole note (with it's path).
+         *
+         * Throws std::runtime_error if got problem in input.
+         *
+         * @param  path A path of the note.
+         * @param  note A note.
+         * @return true, if shown;
+         *      false, if the user has stopped.
+         */
+        bool show(const std::string & path, const Note & note);
+
+        /**
+         * Show a summary of a note (with it's path).
+         *
+         * Throws std::runtime_error if got problem in input.
+         *
+         * @param  path A path of the note.
+         * @param  note A note.
+         * @return true, if shown;
+         *      false, if the user has stopped.
+         */
+        bool show_summary(const std::string & path, const Note & note);
+
+        /**
+         * Write out the rest of the buffered text.
+         */
+        void finish();
+};
+
+#endif  // NOTE_PRESENTER_HPP
@@ -8,95 +8,982 @@
 #include <utility>
 #include <fstream>
 #include <chrono>
-#include <iomanip>
 #include <sstream>
+#include <mutex>
+#include <cstdint>
+#include <vector>
+#include <iterator>
+#include <atomic>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <thread>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <charconv>
 #include "note_storage.hpp"
 #include "notes/note.hpp"
-#include "notes/text.hpp"
-#include "notes/shopping_list.hpp"
-#include "notes/todo_list.hpp"
+#include "notes/note_registry.hpp"
 #include "exports/export.hpp"
+#include "exports/site_export.hpp"
+#include "lz_codec.hpp"
+#include "batch_loader.hpp"
+#include "content_hash.hpp"
+#include "trace.hpp"
+#include "timestamp.hpp"
 
-const std::string Note_Storage::get_file_timestamp() const {
-    // Get current time
-    auto now = std::chrono::system_clock::now();
-    std::time_t time = std::chrono::system_clock::to_time_t(now);
+Note_Storage::Write_Lock::Write_Lock(Note_Storage & notes_store)
+    : m_Notes_Store(notes_store) {
+    m_Notes_Store.begin_write();
+}
+
+Note_Storage::Write_Lock::~Write_Lock() {
+    m_Notes_Store.end_write();
+}
+
+Note_Storage::Note_Storage(const std::string & notes_path)
+    : m_NOTES_PATH(notes_path.size() && notes_path.back() != '/' ? notes_path + '/' : notes_path) {
+    try {
+        if (std::filesystem::exists(m_NOTES_PATH + m_JOURNAL)) {
+            // The batch may be being written by another process right now
+            Write_Lock lock(*this);
+            recover_journal();
+        }
+    }
+    catch (const std::runtime_error & e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+    }
+
+    std::ifstream layout(m_NOTES_PATH + m_LAYOUT_SETTINGS);
+    std::string layout_name;
+    if (layout >> layout_name && layout_name == "date") {
+        m_Layout = Layout::DATE;
+    }
+
+    std::ifstream retention(m_NOTES_PATH + m_RETENTION_SETTINGS);
+    m_Retention.load(retention);
+
+    std::ifstream settings(m_NOTES_PATH + m_COMPRESSION_SETTINGS);
+    if (!settings.is_open()) {
+        return;
+    }
+    // Settings are "<compress (0/1)> <dictionary ID>"
+    bool compress;
+    uint32_t id;
+    if (settings >> compress >> std::hex >> id) {
+        try {
+            m_Codec = get_codec(id);
+            m_Compress = compress;
+        }
+        catch (const std::runtime_error & e) {
+            std::cerr << "ERROR: " << e.what() << std::endl;
+        }
+    }
+}
+
+Note_Storage::~Note_Storage() {
+    if (m_Lock_FD >= 0) {
+        close(m_Lock_FD);
+    }
+}
+
+uint64_t Note_Storage::get_version() const {
+    std::ifstream file(m_NOTES_PATH + m_VERSION);
+    uint64_t version = 0;
+    file >> version;
+    return version;
+}
+
+void Note_Storage::begin_write() {
+    m_Write_Mutex.lock();
+    if (m_Write_Depth++) {
+        return;
+    }
+
+    try {
+        // A new storage doesn't have it's directory yet
+        std::error_code error;
+        std::filesystem::create_directories(m_NOTES_PATH, error);
+        m_Lock_FD = open((m_NOTES_PATH + m_LOCK).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (m_Lock_FD < 0 || flock(m_Lock_FD, LOCK_EX)) {
+            throw std::runtime_error("Note_Storage::begin_write(): Couldn't lock the storage.");
+        }
+        // Odd even if a previous writer crashed and left it odd
+        write_file(m_NOTES_PATH + m_VERSION, std::to_string(get_version() / 2 * 2 + 1) + '\n');
+    }
+    catch (const std::runtime_error &) {
+        if (m_Lock_FD >= 0) {
+            close(m_Lock_FD);
+            m_Lock_FD = -1;
+        }
+        m_Write_Depth--;
+        m_Write_Mutex.unlock();
+        throw;
+    }
+    m_Writer = std::this_thread::get_id();
+}
 
-    // Convert time to local time
-    std::tm localTime = *std::localtime(&time);
+void Note_Storage::end_write() {
+    if (!--m_Write_Depth) {
+        try {
+            write_file(m_NOTES_PATH + m_VERSION, std::to_string(get_version() + 1) + '\n');
+        }
+        catch (const std::runtime_error & e) {
+            // Readers will wait for the lock instead
+            std::cerr << "ERROR: " << e.what() << std::endl;
+        }
+        m_Writer = std::thread::id();
+        // Closing the file releases the lock
+        close(m_Lock_FD);
+        m_Lock_FD = -1;
+    }
+    m_Write_Mutex.unlock();
+}
+
+bool Note_Storage::holds_write_lock() const {
+    return m_Writer == std::this_thread::get_id();
+}
 
-    // Format time into a string
-    std::stringstream ss;
-    ss << std::put_time(&localTime, "%Y_%m_%d__%H_%M_%S");
-    return ss.str();
+int Note_Storage::lock_shared(const bool wait) const {
+    int fd = open((m_NOTES_PATH + m_LOCK).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0 && flock(fd, wait ? LOCK_SH : LOCK_SH | LOCK_NB)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
 }
 
-void Note_Storage::update(const Note & to_insert, std::string & dir) {
+void Note_Storage::write_file(const std::string & path, const std::string & content) const {
     namespace fs = std::filesystem;
-    if (!fs::exists(m_NOTES_PATH + dir)
-        && !fs::create_directories(m_NOTES_PATH + dir)) {
-        throw std::runtime_error("Note_Storage::update(): Couldn't create a directory.");
+
+    const fs::path target(path);
+    const fs::path temporary = target.parent_path() / ('.' + target.filename().string() + ".tmp");
+    std::ofstream file(temporary, std::ios::trunc | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Note_Storage::write_file(): Couldn't create a file.");
+    }
+    file << content;
+    file.close();
+    Trace::add_bytes_written(content.size());
+    std::error_code error;
+    if (!file.good()) {
+        fs::remove(temporary, error);
+        throw std::runtime_error("Note_Storage::write_file(): Write error.");
+    }
+    fs::rename(temporary, target, error);
+    if (error) {
+        fs::remove(temporary, error);
+        throw std::runtime_error("Note_Storage::write_file(): Couldn't replace the file.");
+    }
+}
+
+std::shared_ptr<const LZ_Codec> Note_Storage::get_codec(const uint32_t id) const {
+    std::lock_guard<std::mutex> lock(m_Codecs_Mutex);
+    auto it = m_Codecs.find(id);
+    if (it != m_Codecs.end()) {
+        return it->second;
+    }
+
+    std::string dictionary;
+    if (id) {
+        std::stringstream name;
+        name << std::hex << id;
+        std::ifstream file(m_NOTES_PATH + m_DICTIONARIES_DIR + name.str(), std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Note_Storage::get_codec(): Couldn't open a compression dictionary.");
+        }
+        dictionary.assign(std::istreambuf_iterator<char>(file),
+                          std::istreambuf_iterator<char>());
+    }
+    auto codec = std::make_shared<const LZ_Codec>(dictionary);
+    if (codec->get_dictionary_id() != id) {
+        throw std::runtime_error("Note_Storage::get_codec(): Compression dictionary is damaged.");
+    }
+    m_Codecs.emplace(id, codec);
+    return codec;
+}
+
+std::string Note_Storage::read_file(const std::string & path, const bool resolve) const {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Note_Storage::read(): Couldn't open file.");
+    }
+    std::string content(std::istreambuf_iterator<char>(file),
+                        (std::istreambuf_iterator<char>()));
+    if (file.bad()) {
+        throw std::runtime_error("Note_Storage::read(): File is damaged.");
+    }
+    Trace::add_bytes_read(content.size());
+    return decode_file(std::move(content), resolve);
+}
+
+std::string Note_Storage::decode_file(std::string && content, const bool resolve) const {
+    // Shared notes are "ref <hash>\n<timestamp>\n"
+    if (resolve && !content.compare(0, m_REFERENCE_MAGIC.size() + 1, m_REFERENCE_MAGIC + ' ')) {
+        return resolve_reference(content);
+    }
+    // Compressed notes start with a line "lz <dictionary ID> <raw size>"
+    if (content.compare(0, m_COMPRESSED_MAGIC.size() + 1, m_COMPRESSED_MAGIC + ' ')) {
+        return content;
+    }
+    const std::string corrupted = "Note_Storage::read(): Compressed file is corrupted.";
+    size_t header_end = content.find('\n');
+    if (header_end == std::string::npos) {
+        throw std::runtime_error(corrupted);
+    }
+    std::istringstream header(content.substr(m_COMPRESSED_MAGIC.size(),
+                                              header_end - m_COMPRESSED_MAGIC.size()));
+    uint32_t id;
+    size_t raw_size;
+    if (!(header >> std::hex >> id >> std::dec >> raw_size)) {
+        throw std::runtime_error(corrupted);
+    }
+
+    auto codec = get_codec(id);
+    auto begin = std::chrono::steady_clock::now();
+    std::string decompressed = codec->decompress(content.substr(header_end + 1), raw_size);
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - begin;
+
+    std::lock_guard<std::mutex> lock(m_Codecs_Mutex);
+    m_Stats.m_Notes++;
+    m_Stats.m_Raw_Bytes += raw_size;
+    m_Stats.m_Compressed_Bytes += content.size();
+    m_Stats.m_Decode_Seconds += took.count();
+    if (resolve && !decompressed.compare(0, m_REFERENCE_MAGIC.size() + 1, m_REFERENCE_MAGIC + ' ')) {
+        return resolve_reference(decompressed);
+    }
+    return decompressed;
+}
+
+std::string Note_Storage::encode_file(const std::string & text) const {
+    if (!m_Compress) {
+        return text;
+    }
+    std::ostringstream os;
+    os << m_COMPRESSED_MAGIC << ' ' << std::hex << m_Codec->get_dictionary_id()
+       << ' ' << std::dec << text.size() << '\n'
+       << m_Codec->compress(text);
+    return os.str();
+}
+
+bool Note_Storage::split_note_text(const std::string & text, std::string & body,
+                                   std::string & timestamp) {
+    // Note starts with "<type>\n\n<timestamp>\n\n"
+    size_t type_end = text.find('\n');
+    if (type_end == std::string::npos || text.compare(type_end, 2, "\n\n")) {
+        return false;
+    }
+    size_t timestamp_end = text.find('\n', type_end + 2);
+    if (timestamp_end == std::string::npos || text.compare(timestamp_end, 2, "\n\n")) {
+        return false;
+    }
+    timestamp = text.substr(type_end + 2, timestamp_end - type_end - 2);
+    body = text.substr(0, type_end + 1) + text.substr(timestamp_end + 2);
+    return true;
+}
+
+std::string Note_Storage::resolve_reference(const std::string & content) const {
+    const std::string corrupted = "Note_Storage::read(): Reference to a shared note is corrupted.";
+    std::istringstream is(content.substr(m_REFERENCE_MAGIC.size()));
+    std::string hash, timestamp;
+    if (!(is >> hash) || !std::getline(is.ignore(1), timestamp) || timestamp.empty()) {
+        throw std::runtime_error(corrupted);
+    }
+    std::string body = read_file(m_NOTES_PATH + m_OBJECTS_DIR + hash);
+    size_t type_end = body.find('\n');
+    if (type_end == std::string::npos || hash_to_hex(content_hash(body)) != hash) {
+        throw std::runtime_error(corrupted);
+    }
+    return body.substr(0, type_end + 1) + '\n' + timestamp + "\n\n" + body.substr(type_end + 1);
+}
+
+bool Note_Storage::is_shared(const std::string & hash, const std::string & body) const {
+    namespace fs = std::filesystem;
+    const std::string object_path = m_NOTES_PATH + m_OBJECTS_DIR + hash;
+    if (!fs::exists(object_path)) {
+        return false;
+    }
+    // Equal hashes don't guarantee equal bodies
+    try {
+        return read_file(object_path) == body;
+    }
+    catch (const std::runtime_error &) {
+        return false;
+    }
+}
+
+size_t Note_Storage::collect_objects() const {
+    namespace fs = std::filesystem;
+    const std::string objects_dir = m_NOTES_PATH + m_OBJECTS_DIR;
+    if (!fs::is_directory(objects_dir)) {
+        return 0;
+    }
+
+    std::set<std::string> referenced;
+    std::vector<size_t> sizes;
+    for (const auto & path: list_note_files("", sizes)) {
+        const std::string content = read_file(m_NOTES_PATH + path, false);
+        if (!content.compare(0, m_REFERENCE_MAGIC.size() + 1, m_REFERENCE_MAGIC + ' ')) {
+            std::istringstream is(content.substr(m_REFERENCE_MAGIC.size()));
+            std::string hash;
+            if (is >> hash) {
+                referenced.insert(hash);
+            }
+        }
+    }
+
+    size_t removed = 0;
+    for (const auto & entry: fs::directory_iterator(objects_dir)) {
+        if (entry.is_regular_file() && !referenced.count(entry.path().filename().string())) {
+            fs::remove(entry.path());
+            removed++;
+        }
+    }
+    return removed;
+}
+
+void Note_Storage::save_compression_settings() const {
+    std::ostringstream settings;
+    settings << m_Compress << ' ' << std::hex << m_Codec->get_dictionary_id() << std::endl;
+    try {
+        write_file(m_NOTES_PATH + m_COMPRESSION_SETTINGS, settings.str());
     }
+    catch (const std::runtime_error &) {
+        throw std::runtime_error("Note_Storage::save_compression_settings(): Couldn't save compression settings.");
+    }
+}
 
-    // Trying to create 2 notes with the same name in less than a second
-    // will result in overwriting of the existing file
-    std::ofstream note_file;
-    if (dir.size() && dir.back() != '/') {
+const std::string & Note_Storage::get_notes_path() const {
+    return m_NOTES_PATH;
+}
+
+const std::string Note_Storage::get_file_timestamp() const {
+    static std::atomic<unsigned long> sequence(0);
+    // Not cached, a forked child has to get it's own
+    const long pid = static_cast<long>(getpid());
+
+    // Enough for the timestamp and for any unsigned long
+    char buffer[Timestamp::m_FILE_NAME_SIZE];
+    char digits[21];
+    Timestamp::now().format_file_name(buffer);
+    std::string name;
+    name.reserve(sizeof(buffer) + 2 * sizeof(digits));
+    name.append(buffer, sizeof(buffer)).push_back('_');
+    name.append(digits, std::to_chars(digits, std::end(digits), pid).ptr).push_back('_');
+    // Zero-padded, so names from the same microsecond sort by the sequence
+    char * end = std::to_chars(digits, std::end(digits), sequence++ % m_SEQUENCE_LIMIT).ptr;
+    name.append(m_SEQUENCE_DIGITS - (end - digits), '0').append(digits, end);
+    return name;
+}
+
+void Note_Storage::update(Note & to_insert, std::string & dir, const bool retain) {
+    namespace fs = std::filesystem;
+    Trace_Scope trace("Note_Storage::update");
+    Write_Lock lock(*this);
+    // A directory of a sharded note (e.g. by fsck) is a logical one
+    dir = to_logical(dir);
+    if (dir.size()) {
         dir.push_back('/');
     }
-    note_file.open(m_NOTES_PATH + dir + to_insert.get_file_name(), std::ios::trunc);
-    if (!note_file.is_open()) {
-        std::cout << m_NOTES_PATH + dir + to_insert.get_file_name() << std::endl;
-        throw std::runtime_error("Note_Storage::update(): Couldn't create a note file.");
+    const std::string logical = dir + to_insert.get_file_name(),
+                      physical = to_physical(logical, m_Layout);
+    const fs::path physical_dir = fs::path(m_NOTES_PATH + physical).parent_path();
+    if (!fs::exists(physical_dir)
+        && !fs::create_directories(physical_dir)) {
+        throw std::runtime_error("Note_Storage::update(): Couldn't create a directory.");
     }
-    to_insert.save(note_file);
-    note_file.close();
-    if (!note_file.good()) {
+
+    if (retain) {
+        apply_retention(to_insert, logical);
+    }
+    if (to_insert.get_history().has_unsaved()) {
+        save_history(to_insert, logical);
+    }
+
+    // Saving a note with the same name overwrites the existing file,
+    // get_file_timestamp() makes sure new notes get unique names
+    std::ostringstream raw;
+    to_insert.save(raw);
+    try {
+        // Readers see either the old or the new note, never a half-written one
+        write_file(m_NOTES_PATH + physical, prepare_file(raw.str()));
+    }
+    catch (const std::runtime_error &) {
         throw std::runtime_error("Note_Storage::update(): Write error.");
     }
+
+    // A note saved in the other layout before is replaced by this one
+    const std::string other = to_physical(logical, m_Layout == Layout::FLAT ? Layout::DATE : Layout::FLAT);
+    if (other != physical && fs::is_regular_file(m_NOTES_PATH + other)) {
+        fs::remove(m_NOTES_PATH + other);
+        remove_empty_shards(other);
+    }
 }
 
-std::vector<std::pair<std::string, std::unique_ptr<Note>>>
-Note_Storage::read_recursively(const std::string & dir) const {
+size_t Note_Storage::apply_retention(Note & note, const std::string & logical) {
+    namespace fs = std::filesystem;
+
+    if (!m_Retention.enabled()) {
+        return 0;
+    }
+    const std::vector<std::pair<Timestamp, std::string>> trimmed = note.compact(m_Retention);
+    if (trimmed.empty() || !m_Retention.archive()) {
+        return trimmed.size();
+    }
+
+    // Same format as the changelog in note files
+    const std::string history_path = m_NOTES_PATH + m_HISTORY_DIR + logical;
+    fs::create_directories(fs::path(history_path).parent_path());
+    std::ofstream history(history_path, std::ios::app);
+    for (const auto & x: trimmed) {
+        history << x.first << '\n' << '\t' << x.second << '\n';
+    }
+    history.close();
+    if (!history.good()) {
+        throw std::runtime_error("Note_Storage::apply_retention(): Couldn't archive the history.");
+    }
+    return trimmed.size();
+}
+
+void Note_Storage::load_history(const std::string & path, Note & note) const {
+    Note_History saved;
+    std::ifstream file(m_NOTES_PATH + m_VERSIONS_DIR + to_logical(path));
+    saved.read(file);
+
+    const Note_History & recorded = note.get_history();
+    if (recorded.size()) {
+        // A note can be changed without a history (e.g. imported)
+        if (saved.empty() || !(saved.get_current() == recorded.get_first())) {
+            saved.add_base(recorded.get_first_date(), recorded.get_first());
+        }
+        try {
+            saved.append(recorded);
+        }
+        catch (const std::invalid_argument &) {
+            throw std::runtime_error("Note_Storage::load_history(): Changes don't fit the history.");
+        }
+    }
+    else if (saved.empty() || !(saved.get_current() == note.capture())) {
+        saved.add_base(note.get_last_change_date(), note.capture());
+    }
+    note.set_history(std::move(saved));
+}
+
+void Note_Storage::save_history(Note & note, const std::string & logical) const {
+    namespace fs = std::filesystem;
+
+    // A history, which wasn't loaded, starts with a base, so it fits
+    // any saved one (read() skips the base, if it's the same state)
+    const std::string versions_path = m_NOTES_PATH + m_VERSIONS_DIR + logical;
+    fs::create_directories(fs::path(versions_path).parent_path());
+    std::ofstream versions(versions_path, std::ios::app);
+    note.get_history().write_unsaved(versions);
+    versions.close();
+    if (!versions.good()) {
+        throw std::runtime_error("Note_Storage::save_history(): Couldn't save the history.");
+    }
+
+    std::error_code error;
+    if (fs::file_size(versions_path, error) <= m_MAX_VERSIONS_SIZE || error) {
+        return;
+    }
+    // Halving it keeps the cost of trimming constant per saved version
+    Note_History saved;
+    try {
+        std::ifstream file(versions_path);
+        saved.read(file);
+        saved.trim(saved.size() / 2);
+        std::ostringstream trimmed;
+        saved.write_unsaved(trimmed);
+        write_file(versions_path, trimmed.str());
+    }
+    catch (const std::runtime_error &) {
+        throw std::runtime_error("Note_Storage::save_history(): Couldn't trim the history.");
+    }
+}
+
+bool Note_Storage::is_shard(const std::string & name) {
+    auto digits = [&](size_t cnt) {
+        return std::all_of(name.begin(), name.begin() + static_cast<long>(cnt), ::isdigit);
+    };
+    return (name.size() == 6 && digits(4) && !name.compare(4, 2, ".y"))
+           || (name.size() == 4 && digits(2) && (!name.compare(2, 2, ".m") || !name.compare(2, 2, ".d")));
+}
+
+std::string Note_Storage::get_shard(const std::string & file_name) {
+    // File names start with "YYYY_MM_DD"
+    const size_t DATE_SIZE = 10;
+    if (file_name.size() < DATE_SIZE || file_name.at(4) != '_' || file_name.at(7) != '_') {
+        return "";
+    }
+    for (const size_t x: { 0, 1, 2, 3, 5, 6, 8, 9 }) {
+        if (!::isdigit(file_name.at(x))) {
+            return "";
+        }
+    }
+    return file_name.substr(0, 4) + ".y/" + file_name.substr(5, 2) + ".m/"
+           + file_name.substr(8, 2) + ".d/";
+}
+
+std::string Note_Storage::to_logical(const std::string & path) {
+    std::string logical;
+    size_t begin = 0;
+    while (begin < path.size()) {
+        size_t end = path.find('/', begin);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        const std::string part = path.substr(begin, end - begin);
+        if (part.size() && !is_shard(part)) {
+            if (logical.size()) {
+                logical.push_back('/');
+            }
+            logical.append(part);
+        }
+        begin = end + 1;
+    }
+    return logical;
+}
+
+std::string Note_Storage::to_physical(const std::string & path, const Layout layout) const {
+    std::string logical = to_logical(path);
+    if (layout == Layout::FLAT) {
+        return logical;
+    }
+    const size_t name_begin = logical.find_last_of('/') + 1;
+    return logical.insert(name_begin, get_shard(logical.substr(name_begin)));
+}
+
+std::string Note_Storage::find_physical(const std::string & path) const {
+    namespace fs = std::filesystem;
+
+    const std::string physical = to_physical(path, m_Layout);
+    if (fs::exists(m_NOTES_PATH + physical)) {
+        return physical;
+    }
+    const std::string other = to_physical(path, m_Layout == Layout::FLAT ? Layout::DATE : Layout::FLAT);
+    return fs::exists(m_NOTES_PATH + other) ? other : physical;
+}
+
+void Note_Storage::remove_empty_shards(const std::string & path) const {
+    namespace fs = std::filesystem;
+
+    fs::path dir = fs::path(path).parent_path();
+    while (!dir.empty() && is_shard(dir.filename().string())) {
+        std::error_code error;
+        // Fails if the directory isn't empty
+        if (!fs::remove(m_NOTES_PATH / dir, error)) {
+            break;
+        }
+        dir = dir.parent_path();
+    }
+}
+
+Note_Storage::Layout Note_Storage::get_layout() const {
+    return m_Layout;
+}
+
+void Note_Storage::set_layout(const Layout layout) {
+    namespace fs = std::filesystem;
+
+    fs::create_directories(m_NOTES_PATH);
+    write_file(m_NOTES_PATH + m_LAYOUT_SETTINGS, layout == Layout::DATE ? "date\n" : "flat\n");
+    m_Layout = layout;
+}
+
+const Retention_Policy & Note_Storage::get_retention() const {
+    return m_Retention;
+}
+
+void Note_Storage::set_retention(const Retention_Policy & policy) {
+    namespace fs = std::filesystem;
+
+    fs::create_directories(m_NOTES_PATH);
+    std::ostringstream settings;
+    policy.save(settings);
+    try {
+        write_file(m_NOTES_PATH + m_RETENTION_SETTINGS, settings.str());
+    }
+    catch (const std::runtime_error &) {
+        throw std::runtime_error("Note_Storage::set_retention(): Couldn't save the retention policy.");
+    }
+    m_Retention = policy;
+}
+
+Compaction_Stats Note_Storage::compact_notes() {
+    namespace fs = std::filesystem;
+    Write_Lock lock(*this);
+
+    Compaction_Stats stats;
+    if (!m_Retention.enabled()) {
+        return stats;
+    }
+    std::vector<size_t> sizes;
+    const std::vector<std::string> paths = list_note_files("", sizes);
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::unique_ptr<Note> note;
+        try {
+            note = read(paths.at(i), false);
+        }
+        catch (const std::runtime_error & e) {
+            std::cerr << paths.at(i) << std::endl
+                      << "\tERROR: " << e.what() << std::endl << std::endl;
+            continue;
+        }
+        // Getting the directory of a file's path
+        const std::string logical = to_logical(paths.at(i));
+        std::string dir = logical;
+        size_t last_slash = dir.find_last_of('/');
+        dir.erase(last_slash == std::string::npos ? 0 : last_slash);
+        // A note would be saved under it's creation timestamp,
+        // next to a misnamed file (fsck reports those)
+        if (logical.compare(last_slash + 1, std::string::npos, note->get_file_name())) {
+            continue;
+        }
+        const size_t trimmed = apply_retention(*note, logical);
+        if (!trimmed) {
+            continue;
+        }
+        update(*note, dir);
+        stats.m_Notes++;
+        stats.m_Entries += trimmed;
+        const uintmax_t new_size = fs::file_size(m_NOTES_PATH + find_physical(logical));
+        stats.m_Bytes_Saved += sizes.at(i) - std::min<uintmax_t>(sizes.at(i), new_size);
+    }
+    return stats;
+}
+
+size_t Note_Storage::migrate_layout() {
+    namespace fs = std::filesystem;
+    Write_Lock lock(*this);
+
+    size_t cnt = 0;
+    std::vector<size_t> sizes;
+    for (const auto & x: list_note_files("", sizes)) {
+        const std::string physical = to_physical(x, m_Layout);
+        if (physical == x) {
+            continue;
+        }
+        if (fs::exists(m_NOTES_PATH + physical)) {
+            std::cerr << x << std::endl
+                      << "\tERROR: Note_Storage::migrate_layout(): Note already exists in the new layout." << std::endl << std::endl;
+            continue;
+        }
+        fs::create_directories(fs::path(m_NOTES_PATH + physical).parent_path());
+        fs::rename(m_NOTES_PATH + x, m_NOTES_PATH + physical);
+        remove_empty_shards(x);
+        cnt++;
+    }
+    return cnt;
+}
+
+bool Note_Storage::note_exists(const std::string & path) const {
+    namespace fs = std::filesystem;
+
+    return fs::is_regular_file(m_NOTES_PATH + find_physical(path));
+}
+
+std::string Note_Storage::prepare_file(std::string text) const {
+    std::string body, timestamp;
+    // A note identical to an already shared one is saved as a reference
+    if (split_note_text(text, body, timestamp)) {
+        const std::string hash = hash_to_hex(content_hash(body));
+        if (is_shared(hash, body)) {
+            text = m_REFERENCE_MAGIC + ' ' + hash + '\n' + timestamp + '\n';
+        }
+    }
+    return encode_file(text);
+}
+
+void Note_Storage::write_batch(const std::vector<std::pair<std::string, std::string>> & files) {
+    namespace fs = std::filesystem;
+    Trace_Scope trace("Note_Storage::write_batch");
+    Write_Lock lock(*this);
+
+    if (fs::exists(m_NOTES_PATH + m_JOURNAL)) {
+        throw std::runtime_error("Note_Storage::write_batch(): Another batch is being written.");
+    }
+
+    // Journal lists "<temporary path>\t<path>", and "m_JOURNAL_COMMIT"
+    // once all temporary files are written
+    std::ofstream journal(m_NOTES_PATH + m_JOURNAL, std::ios::trunc | std::ios::binary);
+    std::vector<std::string> temporary;
+    temporary.reserve(files.size());
+    std::vector<std::string> destinations;
+    destinations.reserve(files.size());
+    for (const auto & x: files) {
+        destinations.push_back(to_physical(x.first, m_Layout));
+        const fs::path path(destinations.back());
+        std::string dir = path.parent_path().string();
+        if (dir.size()) {
+            dir.push_back('/');
+        }
+        temporary.push_back(dir + '.' + path.filename().string() + ".tmp");
+        journal << temporary.back() << '\t' << destinations.back() << '\n';
+    }
+    journal.flush();
+    if (!journal.good()) {
+        throw std::runtime_error("Note_Storage::write_batch(): Couldn't write the journal.");
+    }
+
+    try {
+        for (size_t i = 0; i < files.size(); i++) {
+            const fs::path dir = fs::path(m_NOTES_PATH + destinations.at(i)).parent_path();
+            if (!fs::exists(dir) && !fs::create_directories(dir)) {
+                throw std::runtime_error("Note_Storage::write_batch(): Couldn't create a directory.");
+            }
+            std::ofstream note_file(m_NOTES_PATH + temporary.at(i), std::ios::trunc | std::ios::binary);
+            const std::string content = prepare_file(files.at(i).second);
+            note_file << content;
+            note_file.close();
+            Trace::add_bytes_written(content.size());
+            if (!note_file.good()) {
+                throw std::runtime_error("Note_Storage::write_batch(): Write error.");
+            }
+        }
+    }
+    catch (const std::runtime_error &) {
+        journal.close();
+        recover_journal();
+        throw;
+    }
+
+    // One sync for the whole batch, so the commit never gets to the disk
+    // before the notes
+    int root = open(m_NOTES_PATH.c_str(), O_RDONLY | O_DIRECTORY);
+    if (root >= 0) {
+        syncfs(root);
+        close(root);
+    }
+    journal << m_JOURNAL_COMMIT << '\n';
+    journal.close();
+    if (!journal.good()) {
+        recover_journal();
+        throw std::runtime_error("Note_Storage::write_batch(): Couldn't commit the journal.");
+    }
+    recover_journal();
+}
+
+void Note_Storage::recover_journal() {
+    namespace fs = std::filesystem;
+
+    std::ifstream journal(m_NOTES_PATH + m_JOURNAL, std::ios::binary);
+    if (!journal.is_open()) {
+        return;
+    }
+    std::vector<std::pair<std::string, std::string>> renames;
+    std::string line;
+    bool committed = false;
+    while (std::getline(journal, line)) {
+        if (line == m_JOURNAL_COMMIT) {
+            committed = true;
+            break;
+        }
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) {
+            break;
+        }
+        renames.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+    }
+    journal.close();
+
+    for (const auto & x: renames) {
+        std::error_code error;
+        if (committed) {
+            // Files renamed before the crash don't exist anymore
+            if (fs::exists(m_NOTES_PATH + x.first)) {
+                fs::rename(m_NOTES_PATH + x.first, m_NOTES_PATH + x.second, error);
+            }
+        }
+        else {
+            fs::remove(m_NOTES_PATH + x.first, error);
+        }
+        if (error) {
+            throw std::runtime_error("Note_Storage::recover_journal(): Couldn't finish a batch of writes.");
+        }
+    }
+    fs::remove(m_NOTES_PATH + m_JOURNAL);
+}
+
+std::vector<std::string> Note_Storage::list_note_files(const std::string & dir,
+                                                       std::vector<size_t> & sizes) const {
     // Perhaps move this to the global section?
     namespace fs = std::filesystem;
 
+    std::vector<std::string> paths;
+    for (auto it = fs::recursive_directory_iterator(m_NOTES_PATH + dir);
+         it != fs::recursive_directory_iterator(); it++) {
+        const auto & entry = *it;
+        // Skipping storage's metadata
+        if (entry.path().filename().string().front() == '.') {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (entry.is_regular_file()) {
+            std::string relative_path = entry.path();
+            relative_path.erase(0, m_NOTES_PATH.size());
+            paths.push_back(relative_path);
+            sizes.push_back(entry.file_size());
+        }
+    }
+    return paths;
+}
+
+std::string Note_Storage::read_text(const std::string & path) const {
+    return read_file(m_NOTES_PATH + find_physical(path));
+}
+
+std::vector<std::pair<std::string, std::unique_ptr<Note>>>
+Note_Storage::read_recursively(const std::string & dir) const {
+    Trace_Scope trace("Note_Storage::read_recursively");
     std::vector<std::pair<std::string, std::unique_ptr<Note>>> to_return;
-    for (const auto & entry: fs::recursive_directory_iterator(m_NOTES_PATH + dir)) {
-        if (fs::is_regular_file(entry.path())) {
-            // Erasing "m_NOTES_PATH" from the path for output
-            std::string file_relative_path = entry.path();
-            file_relative_path.erase(0, m_NOTES_PATH.size());
-            std::unique_ptr<Note> file;
+    std::vector<std::pair<std::string, std::string>> errors;
+    auto collect = [&](std::string && path, std::unique_ptr<Note> && note) {
+        // Thanks to Stack Overflow for tip about std::move()
+        to_return.emplace_back(std::move(path), std::move(note));
+    };
+
+    bool consistent = holds_write_lock();
+    if (consistent) {
+        scan_notes(dir, collect, errors);
+    }
+    for (unsigned attempt = 0; !consistent && attempt < m_SNAPSHOT_RETRIES; attempt++) {
+        const uint64_t version = get_version();
+        if (version % 2) {
+            // Odd without a writer holding the lock, if a writer crashed
+            const int lock = lock_shared(false);
+            if (lock >= 0) {
+                to_return.clear();
+                errors.clear();
+                try {
+                    scan_notes(dir, collect, errors);
+                }
+                catch (...) {
+                    close(lock);
+                    throw;
+                }
+                close(lock);
+                consistent = true;
+                break;
+            }
+            // A writer is changing the notes right now
+            std::this_thread::sleep_for(std::chrono::milliseconds(1 << attempt));
+            continue;
+        }
+        to_return.clear();
+        errors.clear();
+        scan_notes(dir, collect, errors);
+        consistent = get_version() == version;
+        if (!consistent) {
+            Trace::count("Note_Storage::snapshot_retries", 1);
+        }
+    }
+    if (!consistent) {
+        // Too many writers (or a writer crashed while holding the lock):
+        // waiting for them
+        const int lock = lock_shared();
+        to_return.clear();
+        errors.clear();
+        scan_notes(dir, collect, errors);
+        if (lock >= 0) {
+            close(lock);
+        }
+    }
+
+    for (const auto & x: errors) {
+        std::cerr << x.first << std::endl
+                  << "\tERROR: " << x.second << std::endl << std::endl;
+    }
+    return to_return;
+}
+
+void Note_Storage::for_each_note(const std::string & dir,
+                                 const std::function<void(std::string &&, std::unique_ptr<Note> &&)> & callback) const {
+    Trace_Scope trace("Note_Storage::for_each_note");
+    std::vector<std::pair<std::string, std::string>> errors;
+    const int lock = holds_write_lock() ? -1 : lock_shared();
+    try {
+        scan_notes(dir, callback, errors);
+    }
+    catch (...) {
+        if (lock >= 0) {
+            close(lock);
+        }
+        throw;
+    }
+    if (lock >= 0) {
+        close(lock);
+    }
+    for (const auto & x: errors) {
+        std::cerr << x.first << std::endl
+                  << "\tERROR: " << x.second << std::endl << std::endl;
+    }
+}
+
+void Note_Storage::scan_notes(const std::string & dir,
+                              const std::function<void(std::string &&, std::unique_ptr<Note> &&)> & callback,
+                              std::vector<std::pair<std::string, std::string>> & errors) const {
+    std::vector<size_t> all_sizes;
+    const std::vector<std::string> all_paths = list_note_files(dir, all_sizes);
+
+    Batch_Loader loader;
+    std::vector<std::string> paths;
+    std::vector<size_t> sizes;
+    std::vector<std::unique_ptr<Note>> notes;
+    std::vector<std::string> messages;
+    for (size_t begin = 0; begin < all_paths.size(); begin += m_CHUNK_SIZE) {
+        const size_t end = std::min(begin + m_CHUNK_SIZE, all_paths.size());
+        paths.clear();
+        for (size_t i = begin; i < end; i++) {
+            paths.push_back(m_NOTES_PATH + all_paths.at(i));
+        }
+        sizes.assign(all_sizes.begin() + begin, all_sizes.begin() + end);
+        notes.clear();
+        notes.resize(paths.size());
+        messages.assign(paths.size(), "");
+
+        loader.load(paths, sizes, [&](size_t index, std::string && content, bool ok) {
             try {
-                file = read(file_relative_path, false);
+                if (!ok) {
+                    throw std::runtime_error("Note_Storage::read(): Couldn't open file.");
+                }
+                Trace::add_bytes_read(content.size());
+                std::istringstream is(decode_file(std::move(content)));
+                notes.at(index) = parse(is);
             }
             catch (const std::runtime_error & e) {
-                std::cerr << file_relative_path << std::endl
-                          << "\tERROR: " << e.what() << std::endl << std::endl;
-                continue;
+                messages.at(index) = e.what();
             }
+        });
 
-            // Thanks to Stack Overflow for tip about std::move()
-            to_return.emplace_back(file_relative_path, std::move(file));
+        // Keeping the order of the directory iteration
+        for (size_t i = 0; i < paths.size(); i++) {
+            std::string file_relative_path = to_logical(all_paths.at(begin + i));
+            if (!notes.at(i)) {
+                errors.emplace_back(std::move(file_relative_path), messages.at(i));
+                continue;
+            }
+            callback(std::move(file_relative_path), std::move(notes.at(i)));
         }
     }
-    return to_return;
 }
 
 std::unique_ptr<Note> Note_Storage::read(std::string path,
                                          const bool to_import) const {
-    const std::string corrupted = "Note_Storage::read(): File is corrupted.",
-                      damaged = "Note_Storage::read(): File is damaged.";
-
+    Trace_Scope trace("Note_Storage::read");
     if (!to_import) {
         // A path is relative to "m_NOTES_PATH"
-        path.insert(0, m_NOTES_PATH);
-    }
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Note_Storage::read(): Couldn't open file.");
+        path = m_NOTES_PATH + find_physical(path);
     }
+    std::istringstream file(read_file(path));
+    return parse(file);
+}
+
+std::unique_ptr<Note> Note_Storage::parse(std::istream & file) const {
+    const std::string corrupted = "Note_Storage::read(): File is corrupted.",
+                      damaged = "Note_Storage::read(): File is damaged.";
 
     std::string type, skip, creation_timestamp;
     std::getline(file, type);
@@ -122,22 +1009,11 @@ std::unique_ptr<Note> Note_Storage::read(std::string path,
         throw std::runtime_error(damaged);
     }
 
-    std::unique_ptr<Note> note_read;
-    if (!type.compare("text")) {
-        note_read = std::make_unique<Text>(creation_timestamp);
-    }
-    else if (!type.compare("shopping list")) {
-        note_read = std::make_unique<Shopping_List>(creation_timestamp);
-    }
-    else if (!type.compare("to-do list")) {
-        note_read = std::make_unique<TODO_List>(creation_timestamp);
-    }
-    else {
+    const Note_Type * note_type = Note_Registry::find(type);
+    if (!note_type) {
         throw std::runtime_error(corrupted);
     }
-
-    note_read->read(file);
-    return note_read;
+    return note_type->m_Parse(creation_timestamp, file);
 }
 
 bool Note_Storage::dir_exists(const std::string & path) const {
@@ -148,9 +1024,23 @@ bool Note_Storage::dir_exists(const std::string & path) const {
 
 void Note_Storage::delete_note(const std::string & path) {
     namespace fs = std::filesystem;
+    Write_Lock lock(*this);
 
-    if (!fs::remove_all(m_NOTES_PATH + path)) {
-        throw std::runtime_error("Note_Storage::delete_note(): Couldn't delete a note or directory.");
+    if (fs::is_directory(m_NOTES_PATH + path)) {
+        if (!fs::remove_all(m_NOTES_PATH + path)) {
+            throw std::runtime_error("Note_Storage::delete_note(): Couldn't delete a note or directory.");
+        }
+        fs::remove_all(m_NOTES_PATH + m_HISTORY_DIR + to_logical(path));
+        fs::remove_all(m_NOTES_PATH + m_VERSIONS_DIR + to_logical(path));
+    }
+    else {
+        const std::string physical = find_physical(path);
+        if (!fs::remove(m_NOTES_PATH + physical)) {
+            throw std::runtime_error("Note_Storage::delete_note(): Couldn't delete a note or directory.");
+        }
+        remove_empty_shards(physical);
+        fs::remove(m_NOTES_PATH + m_HISTORY_DIR + to_logical(path));
+        fs::remove(m_NOTES_PATH + m_VERSIONS_DIR + to_logical(path));
     }
     // Removing note from filtered history.
     for (size_t i = 0; i < m_Filtered.size(); i++) {
@@ -191,9 +1081,266 @@ void Note_Storage::export_note_standard_format(const std::unique_ptr<Export> & e
     if (!file.is_open()) {
         throw std::runtime_error("Note_Storage::export_note(): Couldn't create a file to export the note.");
     }
+    export_method->begin(file);
     (*export_method)(to_export, file);
     file.close();
     if (!file.good()) {
         throw std::runtime_error("Note_Storage::export_note(): File writing error.");
     }
 }
+
+size_t Note_Storage::export_notes_standard_format(const std::unique_ptr<Export> & export_method,
+                                                 const std::string & dir) const {
+    namespace fs = std::filesystem;
+
+    if (fs::exists(export_method->m_PATH)) {
+        throw std::runtime_error("Note_Storage::export_notes_standard_format(): Something already exists at provided path.");
+    }
+    if (!dir_exists(dir)) {
+        throw std::runtime_error("Note_Storage::export_notes_standard_format(): Directory doesn't exist.");
+    }
+    std::vector<char> buffer(m_EXPORT_BUFFER_SIZE);
+    std::ofstream file;
+    // Buffer has to be set before opening the file
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(export_method->m_PATH, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Note_Storage::export_notes_standard_format(): Couldn't create a file to export notes.");
+    }
+
+    size_t cnt = 0;
+    export_method->begin(file);
+    for_each_note(dir, [&](std::string &&, std::unique_ptr<Note> && note) {
+        (*export_method)(note, file);
+        cnt++;
+    });
+    file.close();
+    if (!file.good()) {
+        throw std::runtime_error("Note_Storage::export_notes_standard_format(): File writing error.");
+    }
+    return cnt;
+}
+
+void Note_Storage::export_filtered_standard_format(const std::unique_ptr<Export> & export_method) const {
+    namespace fs = std::filesystem;
+
+    if (fs::exists(export_method->m_PATH)) {
+        throw std::runtime_error("Note_Storage::export_filtered_standard_format(): Something already exists at provided path.");
+    }
+    std::vector<char> buffer(m_EXPORT_BUFFER_SIZE);
+    std::ofstream file;
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(export_method->m_PATH, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Note_Storage::export_filtered_standard_format(): Couldn't create a file to export notes.");
+    }
+
+    export_method->begin(file);
+    for (const auto & x: m_Filtered) {
+        (*export_method)(x.second, file);
+    }
+    file.close();
+    if (!file.good()) {
+        throw std::runtime_error("Note_Storage::export_filtered_standard_format(): File writing error.");
+    }
+}
+
+void Note_Storage::check_site_destination(const Site_Export & site) const {
+    namespace fs = std::filesystem;
+
+    std::string root = fs::weakly_canonical(m_NOTES_PATH).string(),
+                destination = fs::weakly_canonical(site.get_destination()).string();
+    for (std::string * x: { &root, &destination }) {
+        if (x->size() > 1 && x->back() == '/') {
+            x->pop_back();
+        }
+    }
+    if (!destination.compare(0, root.size(), root)
+        && (destination.size() == root.size() || destination.at(root.size()) == '/')) {
+        throw std::runtime_error("Note_Storage::check_site_destination(): Site can't be exported inside the storage.");
+    }
+}
+
+Site_Stats Note_Storage::export_site(Site_Export & site, const std::string & dir) const {
+    if (!dir_exists(dir)) {
+        throw std::runtime_error("Note_Storage::export_site(): Directory doesn't exist.");
+    }
+    check_site_destination(site);
+
+    std::vector<std::pair<std::string, std::unique_ptr<Note>>> batch;
+    for_each_note(dir, [&](std::string && path, std::unique_ptr<Note> && note) {
+        batch.emplace_back(std::move(path), std::move(note));
+        if (batch.size() == Site_Export::m_BATCH_SIZE) {
+            site.add(batch);
+            batch.clear();
+        }
+    });
+    site.add(batch);
+    return site.finish();
+}
+
+Site_Stats Note_Storage::export_filtered_site(Site_Export & site) const {
+    check_site_destination(site);
+    site.add(m_Filtered);
+    return site.finish();
+}
+
+void Note_Storage::set_compression(const bool compress) {
+    m_Compress = compress;
+    save_compression_settings();
+}
+
+bool Note_Storage::get_compression() const {
+    return m_Compress;
+}
+
+size_t Note_Storage::train_dictionary() {
+    namespace fs = std::filesystem;
+
+    std::vector<std::string> samples;
+    std::vector<size_t> sizes;
+    for (const auto & x: list_note_files("", sizes)) {
+        try {
+            samples.push_back(read_text(x));
+        }
+        catch (const std::runtime_error & e) {
+            std::cerr << x << std::endl
+                      << "\tERROR: " << e.what() << std::endl << std::endl;
+        }
+    }
+
+    auto codec = std::make_shared<const LZ_Codec>(LZ_Codec::train(samples));
+    const uint32_t id = codec->get_dictionary_id();
+    if (id) {
+        std::stringstream name;
+        name << std::hex << id;
+        fs::create_directories(m_NOTES_PATH + m_DICTIONARIES_DIR);
+        std::ofstream file(m_NOTES_PATH + m_DICTIONARIES_DIR + name.str(),
+                           std::ios::trunc | std::ios::binary);
+        file << codec->get_dictionary();
+        file.close();
+        if (!file.good()) {
+            throw std::runtime_error("Note_Storage::train_dictionary(): Couldn't save the dictionary.");
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Codecs_Mutex);
+        m_Codecs.emplace(id, codec);
+    }
+    m_Codec = codec;
+    save_compression_settings();
+    return codec->get_dictionary().size();
+}
+
+size_t Note_Storage::rewrite_all() {
+    Write_Lock lock(*this);
+    size_t cnt = 0;
+    for (auto & x: read_recursively("")) {
+        // Getting the directory of a file's path
+        std::string dir = x.first;
+        size_t last_slash = dir.find_last_of('/');
+        dir.erase(last_slash == std::string::npos ? 0 : last_slash);
+        update(*x.second, dir);
+        cnt++;
+    }
+    return cnt;
+}
+
+Compression_Stats Note_Storage::get_compression_stats() const {
+    std::lock_guard<std::mutex> lock(m_Codecs_Mutex);
+    return m_Stats;
+}
+
+void Note_Storage::reset_compression_stats() {
+    std::lock_guard<std::mutex> lock(m_Codecs_Mutex);
+    m_Stats = Compression_Stats();
+}
+
+std::vector<std::vector<std::string>> Note_Storage::find_duplicates() const {
+    std::vector<size_t> sizes;
+    // Hash -> body and paths of notes with it (bodies are compared as well,
+    // so a hash collision can't merge different notes)
+    std::map<uint64_t, std::vector<std::pair<std::string, std::vector<std::string>>>> by_hash;
+    for (const auto & path: list_note_files("", sizes)) {
+        std::string text, body, timestamp;
+        try {
+            text = read_text(path);
+        }
+        catch (const std::runtime_error & e) {
+            std::cerr << path << std::endl
+                      << "\tERROR: " << e.what() << std::endl << std::endl;
+            continue;
+        }
+        if (!split_note_text(text, body, timestamp)) {
+            continue;
+        }
+        auto & candidates = by_hash[content_hash(body)];
+        auto it = std::find_if(candidates.begin(), candidates.end(),
+                               [&](const auto & x) { return x.first == body; });
+        if (it == candidates.end()) {
+            candidates.emplace_back(std::move(body), std::vector<std::string>());
+            it = candidates.end() - 1;
+        }
+        it->second.push_back(path);
+    }
+
+    std::vector<std::vector<std::string>> duplicates;
+    for (auto & x: by_hash) {
+        for (auto & y: x.second) {
+            if (y.second.size() > 1) {
+                duplicates.push_back(std::move(y.second));
+            }
+        }
+    }
+    return duplicates;
+}
+
+Dedup_Stats Note_Storage::deduplicate() {
+    namespace fs = std::filesystem;
+
+    Write_Lock lock(*this);
+    Dedup_Stats stats;
+    fs::create_directories(m_NOTES_PATH + m_OBJECTS_DIR);
+    for (const auto & group: find_duplicates()) {
+        std::string body, timestamp;
+        if (!split_note_text(read_text(group.front()), body, timestamp)) {
+            continue;
+        }
+        const std::string hash = hash_to_hex(content_hash(body));
+        const std::string object_path = m_NOTES_PATH + m_OBJECTS_DIR + hash;
+        if (fs::exists(object_path)) {
+            // The hash is taken by a different body, keep the notes as they are
+            if (!is_shared(hash, body)) {
+                continue;
+            }
+        }
+        else {
+            try {
+                write_file(object_path, encode_file(body));
+            }
+            catch (const std::runtime_error &) {
+                throw std::runtime_error("Note_Storage::deduplicate(): Couldn't save a shared note.");
+            }
+        }
+
+        stats.m_Groups++;
+        for (const auto & path: group) {
+            std::string note_body;
+            if (!split_note_text(read_text(path), note_body, timestamp)) {
+                continue;
+            }
+            const uintmax_t old_size = fs::file_size(m_NOTES_PATH + path);
+            try {
+                write_file(m_NOTES_PATH + path, encode_file(m_REFERENCE_MAGIC + ' ' + hash + '\n' + timestamp + '\n'));
+            }
+            catch (const std::runtime_error &) {
+                throw std::runtime_error("Note_Storage::deduplicate(): Couldn't save a reference.");
+            }
+            stats.m_Replaced++;
+            stats.m_Bytes_Saved += old_size - std::min(old_size, fs::file_size(m_NOTES_PATH + path));
+        }
+    }
+    stats.m_Objects_Removed = collect_objects();
+    return stats;
+}
@@ -5,27 +5,481 @@
 #include <vector>
 #include <utility>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <functional>
+#include <atomic>
+#include <thread>
 #include "notes/note.hpp"
 #include "exports/export.hpp"
+#include "exports/site_export.hpp"
+#include "lz_codec.hpp"
+#include "retention_policy.hpp"
+
+/**
+ * Statistics about compressed notes read by Note_Storage.
+ */
+struct Compression_Stats {
+    size_t m_Notes = 0;
+    uint64_t m_Raw_Bytes = 0, m_Compressed_Bytes = 0;
+    double m_Decode_Seconds = 0;
+};
+
+/**
+ * Statistics of Note_Storage::deduplicate().
+ */
+struct Dedup_Stats {
+    size_t m_Groups = 0, m_Replaced = 0, m_Objects_Removed = 0;
+    uint64_t m_Bytes_Saved = 0;
+};
+
+/**
+ * Statistics of Note_Storage::compact_notes().
+ */
+struct Compaction_Stats {
+    size_t m_Notes = 0, m_Entries = 0;
+    uint64_t m_Bytes_Saved = 0;
+};
 
 /**
  * A class to store the notes and work with their files.
  */
 class Note_Storage {
+    public:
+        /**
+         * A physical layout of note files.
+         *
+         * Notes are always addressed by logical paths ("<dir>/<file name>").
+         * With DATE layout, notes are stored in date shards, e.g.
+         * "<dir>/2023.y/05.m/26.d/2023_05_26__20_05_16", so no directory
+         * gets too big. Shard names contain '.', which is forbidden
+         * in user's directories, so they can't be confused with them.
+         */
+        enum class Layout {
+            FLAT,
+            DATE
+        };
+
     private:
-        // A relative directory where to insert notes in a folder
-        // where is the projects' binary file located.
-        const std::string m_NOTES_PATH = "examples/";
+        // A directory where to insert notes (with trailing '/'),
+        // "examples/" in a folder where is the projects' binary file located
+        // by default.
+        const std::string m_NOTES_PATH;
+        // Files and directories starting with '.' inside "m_NOTES_PATH"
+        // aren't notes, they keep the storage's metadata.
+        const std::string m_DICTIONARIES_DIR = ".dictionaries/",
+                          m_COMPRESSION_SETTINGS = ".compression",
+                          m_COMPRESSED_MAGIC = "lz",
+                          m_OBJECTS_DIR = ".objects/",
+                          m_REFERENCE_MAGIC = "ref",
+                          m_JOURNAL = ".journal",
+                          m_JOURNAL_COMMIT = "commit",
+                          // Writers hold an exclusive flock() of this file
+                          m_LOCK = ".lock",
+                          // A generation counter of the notes, odd while
+                          // a writer is changing them
+                          m_VERSION = ".version",
+                          // Layout of note files ("flat" or "date")
+                          m_LAYOUT_SETTINGS = ".layout",
+                          m_RETENTION_SETTINGS = ".retention",
+                          // Changelog entries trimmed by the retention
+                          // policy, by logical paths of the notes
+                          m_HISTORY_DIR = ".history/",
+                          // Versions of notes (see Note_History), by logical
+                          // paths of the notes
+                          m_VERSIONS_DIR = ".versions/";
+        // How many times read_recursively() retries a scan disturbed
+        // by a writer, before it waits for the writer.
+        static constexpr unsigned m_SNAPSHOT_RETRIES = 8;
+        // How many files for_each_note() loads at once.
+        static constexpr size_t m_CHUNK_SIZE = 4096;
+        // A size of an output buffer for exports of many notes.
+        static constexpr size_t m_EXPORT_BUFFER_SIZE = 1 << 20;
+        // Digits of a sequence number in file timestamps, the sequence wraps
+        // around at m_SEQUENCE_LIMIT (more notes are never created
+        // in one microsecond).
+        static constexpr size_t m_SEQUENCE_DIGITS = 6;
+        static constexpr unsigned long m_SEQUENCE_LIMIT = 1000000;
+        // A size of a note's versions in "m_VERSIONS_DIR", after which
+        // the older half of them is dropped.
+        static constexpr uintmax_t m_MAX_VERSIONS_SIZE = 1 << 20;
+
+        // Whether or not to compress notes on save.
+        bool m_Compress = false;
+        // A codec used for saving the notes.
+        std::shared_ptr<const LZ_Codec> m_Codec = std::make_shared<LZ_Codec>();
+        // Codecs (by dictionary ID) already used for reading the notes.
+        mutable std::map<uint32_t, std::shared_ptr<const LZ_Codec>> m_Codecs;
+        mutable Compression_Stats m_Stats;
+        mutable std::mutex m_Codecs_Mutex;
+
+        // The writer lock is re-entrant within the thread holding it.
+        std::recursive_mutex m_Write_Mutex;
+        size_t m_Write_Depth = 0;
+        int m_Lock_FD = -1;
+        std::atomic<std::thread::id> m_Writer{std::thread::id()};
+
+        // A layout of newly saved notes.
+        Layout m_Layout = Layout::FLAT;
+
+        // Applied to changelogs of saved notes.
+        Retention_Policy m_Retention;
+
+        /**
+         * Get a codec with a dictionary with the provided ID, loading
+         * the dictionary from "m_DICTIONARIES_DIR" if needed.
+         *
+         * Throws std::runtime_error if there is no such dictionary.
+         *
+         * @param  id Dictionary ID (0 for none).
+         * @return A codec.
+         */
+        std::shared_ptr<const LZ_Codec> get_codec(const uint32_t id) const;
+
+        /**
+         * Read a whole file with a note, decompressing it if needed.
+         *
+         * Throws std::runtime_error if couldn't read the file or if the file
+         * is compressed and is corrupted.
+         *
+         * @param  path    A full path to the file.
+         * @param  resolve Whether or not to load a shared body, if the note
+         *                 is a reference.
+         * @return A note in a text format.
+         */
+        std::string read_file(const std::string & path, const bool resolve = true) const;
+
+        /**
+         * Decompress content of a note file, if it's compressed.
+         *
+         * Throws std::runtime_error if the file is corrupted.
+         *
+         * @param  content Content of the note file.
+         * @param  resolve Whether or not to load a shared body, if the note
+         *                 is a reference.
+         * @return A note in a text format.
+         */
+        std::string decode_file(std::string && content, const bool resolve = true) const;
+
+        /**
+         * Prepare a note file for writing (compress it, if compression
+         * is turned on).
+         *
+         * @param  text A note in a text format.
+         * @return Content of the file.
+         */
+        std::string encode_file(const std::string & text) const;
+
+        /**
+         * Prepare a note in a text format for writing: replace it with
+         * a reference, if it's body is shared, and compress it, if needed.
+         *
+         * @param  text A note in a text format.
+         * @return Content of the file.
+         */
+        std::string prepare_file(std::string text) const;
+
+        /**
+         * Load a shared body of a note, referenced from a note file.
+         *
+         * Throws std::runtime_error if the reference or the shared body
+         * is corrupted.
+         *
+         * @param  content Content of the note file ("ref <hash>\n<timestamp>\n").
+         * @return A note in a text format.
+         */
+        std::string resolve_reference(const std::string & content) const;
+
+        /**
+         * Check whether a body is already shared in "m_OBJECTS_DIR".
+         *
+         * @param  hash A hash of the body.
+         * @param  body A body of a note.
+         * @return true, if the shared body under the hash is identical;
+         *         false otherwise (or if it can't be read)
+         */
+        bool is_shared(const std::string & hash, const std::string & body) const;
+
+        /**
+         * Delete shared bodies in "m_OBJECTS_DIR", which no note references.
+         *
+         * Throws std::runtime_error if couldn't read a note.
+         *
+         * @return A number of deleted bodies.
+         */
+        size_t collect_objects() const;
+
+        /**
+         * Trim a changelog of a note according to "m_Retention" and append
+         * the trimmed entries to it's history in "m_HISTORY_DIR", if they
+         * are archived.
+         *
+         * Throws std::runtime_error if couldn't write the history.
+         *
+         * @param  note    A note.
+         * @param  logical A logical path of the note.
+         * @return A number of trimmed entries.
+         */
+        size_t apply_retention(Note & note, const std::string & logical);
+
+        /**
+         * Append versions of a note, which weren't saved yet, to it's history,
+         * without loading it. The history is trimmed to it's newer half,
+         * when it grows over "m_MAX_VERSIONS_SIZE".
+         *
+         * Throws std::runtime_error if couldn't save them.
+         *
+         * @param note    A note.
+         * @param logical A logical path of the note.
+         */
+        void save_history(Note & note, const std::string & logical) const;
+
+        /**
+         * Save compression settings to "m_COMPRESSION_SETTINGS".
+         *
+         * Throws std::runtime_error if got error.
+         */
+        void save_compression_settings() const;
+
+        /**
+         * Finish or roll back a batch of writes interrupted by a crash
+         * (see write_batch()).
+         *
+         * Throws std::runtime_error if got error.
+         */
+        void recover_journal();
+
+        /**
+         * Write a file atomically: into a temporary file (starting with '.')
+         * which then replaces the original one, so readers see either
+         * the old or the new content.
+         *
+         * Throws std::runtime_error if got error.
+         *
+         * @param path    A full path to the file.
+         * @param content Content of the file.
+         */
+        void write_file(const std::string & path, const std::string & content) const;
+
+        /**
+         * Take the writer lock and make the version odd.
+         *
+         * Throws std::runtime_error if couldn't lock the storage.
+         */
+        void begin_write();
+
+        /**
+         * Make the version even and release the writer lock.
+         */
+        void end_write();
+
+        /**
+         * Check whether or not the calling thread holds the writer lock.
+         */
+        bool holds_write_lock() const;
+
+        /**
+         * Check whether or not a path component is a date shard
+         * ("YYYY.y", "MM.m" or "DD.d").
+         */
+        static bool is_shard(const std::string & name);
+
+        /**
+         * Get date shards of a note.
+         *
+         * @param  file_name A file name of the note (it's creation timestamp).
+         * @return "YYYY.y/MM.m/DD.d/", empty if the name isn't a timestamp.
+         */
+        static std::string get_shard(const std::string & file_name);
+
+        /**
+         * Get a path in the provided layout.
+         *
+         * @param  path   A logical or physical path, relative to "m_NOTES_PATH".
+         * @param  layout A layout.
+         * @return A physical path of a note in the layout.
+         */
+        std::string to_physical(const std::string & path, const Layout layout) const;
+
+        /**
+         * Find where a note is stored. Notes are looked up in the current
+         * layout first and in the other one then (not migrated notes).
+         *
+         * @param  path A logical or physical path, relative to "m_NOTES_PATH".
+         * @return A physical path; in the current layout, if the note
+         *         doesn't exist.
+         */
+        std::string find_physical(const std::string & path) const;
+
+        /**
+         * Remove date shards left empty after a note was (re)moved.
+         *
+         * @param path A physical path of the note, relative to "m_NOTES_PATH".
+         */
+        void remove_empty_shards(const std::string & path) const;
+
+        /**
+         * Check that a site isn't exported inside the storage (its pages
+         * would be read as notes).
+         *
+         * Throws std::runtime_error if it is.
+         *
+         * @param site An export of the site.
+         */
+        void check_site_destination(const Site_Export & site) const;
+
+        /**
+         * Take a shared flock() of "m_LOCK".
+         *
+         * @param  wait Whether or not to wait for a writer to finish.
+         * @return A file descriptor to close() to release the lock,
+         *         -1 if the lock couldn't be taken.
+         */
+        int lock_shared(const bool wait = true) const;
+
+        /**
+         * Read all notes in a directory without any synchronization
+         * (see for_each_note()).
+         *
+         * @param dir      A root folder where to start reading notes.
+         * @param callback A function called for every note read.
+         * @param errors   Where to store paths of notes which couldn't be read
+         *                 and the errors.
+         */
+        void scan_notes(const std::string & dir,
+                        const std::function<void(std::string &&, std::unique_ptr<Note> &&)> & callback,
+                        std::vector<std::pair<std::string, std::string>> & errors) const;
 
     public:
+        /**
+         * An exclusive lock of the storage for writing, shared by threads
+         * and processes.
+         *
+         * All methods which change the notes take it. Other components
+         * which change note files directly should hold it as well.
+         */
+        class Write_Lock {
+            private:
+                Note_Storage & m_Notes_Store;
+
+            public:
+                explicit Write_Lock(Note_Storage & notes_store);
+                ~Write_Lock();
+
+                Write_Lock(const Write_Lock &) = delete;
+                Write_Lock & operator = (const Write_Lock &) = delete;
+        };
+
+        /**
+         * Create a storage and load it's settings (e.g. whether or not
+         * to compress the notes).
+         *
+         * Finishes a batch of writes, if the previous run crashed during it.
+         *
+         * @param notes_path A root directory of the storage.
+         */
+        explicit Note_Storage(const std::string & notes_path = "examples/");
+
+        ~Note_Storage();
+
+        /**
+         * Get a version of the notes: a counter increased by every writer
+         * when it starts (to an odd number) and finishes (to an even one).
+         *
+         * Readers compare versions before and after reading to find out
+         * whether or not they've seen a consistent snapshot.
+         *
+         * @return The version, 0 for a new storage.
+         */
+        uint64_t get_version() const;
+
+        /**
+         * Get a logical path of a note (without date shards).
+         *
+         * @param  path A physical path, relative to "m_NOTES_PATH".
+         * @return The logical path.
+         */
+        static std::string to_logical(const std::string & path);
+
+        Layout get_layout() const;
+
+        /**
+         * Set a layout of newly saved notes. Existing notes stay where
+         * they are (and can still be read) until migrate_layout().
+         *
+         * Throws std::runtime_error if couldn't save the setting.
+         *
+         * @param layout A layout.
+         */
+        void set_layout(const Layout layout);
+
+        /**
+         * Move all notes to the current layout (renames only,
+         * files aren't rewritten).
+         *
+         * Throws std::runtime_error if got error.
+         *
+         * @return A number of moved notes.
+         */
+        size_t migrate_layout();
+
+        const Retention_Policy & get_retention() const;
+
+        /**
+         * Set a retention policy of changelogs. It's applied to notes when
+         * they are saved, existing notes are trimmed by compact_notes().
+         *
+         * Throws std::runtime_error if couldn't save the setting.
+         *
+         * @param policy A policy.
+         */
+        void set_retention(const Retention_Policy & policy);
+
+        /**
+         * Trim changelogs of all notes according to the retention policy.
+         * Only notes, which have anything to trim, are rewritten.
+         *
+         * Throws std::runtime_error if couldn't save a note.
+         *
+         * @return Statistics.
+         */
+        Compaction_Stats compact_notes();
+
+        /**
+         * Check whether or not a note exists (in any layout).
+         *
+         * @param  path A logical path, relative to "m_NOTES_PATH".
+         * @return true, if it exists.
+         */
+        bool note_exists(const std::string & path) const;
+
         // This should not be private, as it will be accessed by Menu
         // and possibly by other objects.
         std::vector<std::pair<std::string, std::unique_ptr<Note>>> m_Filtered;
 
         /**
-         * Get a timestamp suitable for file saving (YYYY_MM_DD__HH_MM_SS).
+         * Get a root directory of the storage (with trailing '/').
+         *
+         * @return "m_NOTES_PATH".
+         */
+        const std::string & get_notes_path() const;
+
+        /**
+         * Get a unique timestamp suitable for file saving
+         * (YYYY_MM_DD__HH_MM_SS_UUUUUU_PID_SEQ).
          * Thanks for ChatGPT.
          *
+         * Seconds are followed by microseconds, an ID of the process
+         * and a per-process sequence number of "m_SEQUENCE_DIGITS" digits,
+         * so notes created in the same second (even by different processes)
+         * don't overwrite each other. Names still start with
+         * YYYY_MM_DD__HH_MM_SS, as older notes named by seconds only.
+         * Names of notes created by one process sort by creation time.
+         * Is thread-safe.
+         *
          * @return Timestamp for file saving.
          */
         const std::string get_file_timestamp() const;
@@ -35,17 +489,45 @@ class Note_Storage {
          *
          * Try to create a file containing a "to_insert" note in
          * a directory "dir", relative to "m_NOTES_PATH".
+         * The note's changelog is trimmed by the retention policy first,
+         * unless the note is stored verbatim (e.g. a synchronized one).
          * If failed, throws an exception std::runtime_error.
          *
          * @param to_insert A note to insert;
-         *        dir       A relative to "m_NOTES_PATH" directory to insert a note.
+         *        dir       A relative to "m_NOTES_PATH" directory to insert a note;
+         *        retain    Whether or not to apply the retention policy.
          */
-        void update(const Note & to_insert, std::string & dir);
+        void update(Note & to_insert, std::string & dir, const bool retain = true);
+
+        /**
+         * Save many notes at once, all or none of them.
+         *
+         * Every note is written to a temporary file (starting with '.',
+         * so it isn't read as a note) next to it's destination. Then
+         * the batch is committed to "m_JOURNAL" and the files are renamed.
+         * If the process crashes, the next Note_Storage either finishes
+         * the renames (batch was committed) or removes the temporary files.
+         * Existing files at the destinations are overwritten.
+         *
+         * Throws std::runtime_error if got error.
+         *
+         * @param files Pairs of logical paths relative to "m_NOTES_PATH"
+         *              and notes in a text format.
+         */
+        void write_batch(const std::vector<std::pair<std::string, std::string>> & files);
 
         /**
          * A method, that reads all notes in a directory,
          * including sub-directories.
          *
+         * Files are loaded in batches by Batch_Loader (with io_uring,
+         * if it's available) and parsed as they arrive.
+         *
+         * Returns a consistent snapshot without taking any lock: if a writer
+         * changed the notes during the scan (see get_version()), the scan
+         * is repeated. Only after "m_SNAPSHOT_RETRIES" attempts it waits
+         * for writers.
+         *
          * @param  dir A root folder where to start reading notes.
          * @return A std::vector of pairs of successfully read notes:
          *         first element is a note's path, relative to "m_NOTES_PATH";
@@ -53,6 +535,49 @@ class Note_Storage {
          */
         std::vector<std::pair<std::string, std::unique_ptr<Note>>> read_recursively(const std::string & dir) const;
 
+        /**
+         * Read all notes in a directory, including sub-directories,
+         * and pass them one by one to a callback.
+         *
+         * Notes are loaded in chunks of "m_CHUNK_SIZE" files (in order
+         * of directory iteration), so the whole archive is never held
+         * in memory at once. Notes which can't be read are reported
+         * to std::cerr and skipped.
+         *
+         * Notes can't be read again once passed to the callback, so instead
+         * of retrying, writers are kept out by a shared lock during the scan
+         * (other readers aren't blocked).
+         *
+         * @param dir      A root folder where to start reading notes.
+         * @param callback A function called with a note's path, relative
+         *                 to "m_NOTES_PATH", and the note itself.
+         */
+        void for_each_note(const std::string & dir,
+                           const std::function<void(std::string &&, std::unique_ptr<Note> &&)> & callback) const;
+
+        /**
+         * List all note files in a directory, including sub-directories.
+         *
+         * Skips storage's metadata (files and directories starting with '.').
+         *
+         * @param  dir   A root folder where to start.
+         * @param  sizes Where to store sizes of the files.
+         * @return Physical paths of the files (including date shards),
+         *         relative to "m_NOTES_PATH".
+         */
+        std::vector<std::string> list_note_files(const std::string & dir,
+                                                 std::vector<size_t> & sizes) const;
+
+        /**
+         * Read a note file as a text (decompressed, if it was compressed).
+         *
+         * Throws std::runtime_error if couldn't read the file.
+         *
+         * @param  path A path to the note, relative to "m_NOTES_PATH".
+         * @return Content of the note file.
+         */
+        std::string read_text(const std::string & path) const;
+
         /**
          * Read a note from storage.
          *
@@ -69,6 +594,30 @@ class Note_Storage {
         std::unique_ptr<Note> read(std::string path,
                                    const bool to_import) const;
 
+        /**
+         * Load the saved history of a note (needed for undo, redo and
+         * older versions).
+         *
+         * Changes recorded in the note before are kept after the saved ones.
+         * If the note was changed outside of the history (e.g. imported
+         * or synchronized), it's state is added as a new base.
+         * Throws std::runtime_error if the history is corrupted.
+         *
+         * @param path A logical path of the note, relative to "m_NOTES_PATH".
+         * @param note The note.
+         */
+        void load_history(const std::string & path, Note & note) const;
+
+        /**
+         * Parse a note in a text format (e.g. received from a client).
+         *
+         * Throws std::runtime_error if the note is damaged or corrupted.
+         *
+         * @param  is A stream with a note.
+         * @return A note.
+         */
+        std::unique_ptr<Note> parse(std::istream & is) const;
+
         /**
          * Check if a folder exists in a path, relative to "m_NOTES_PATH".
          *
@@ -108,6 +657,135 @@ class Note_Storage {
          * @param to_export     A note to export.
          */
         void export_note_standard_format(const std::unique_ptr<Export> & export_method, const std::unique_ptr<Note> & to_export);
+
+        /**
+         * Export all notes in a directory, including sub-directories,
+         * into one file in some standard format (e.g. JSON Lines).
+         *
+         * Notes are streamed: read in chunks and written through
+         * a big output buffer as they come.
+         *
+         * Throws std::runtime_error if got error.
+         *
+         * @param  export_method A file format to export notes to.
+         * @param  dir           A root folder where to start.
+         * @return A number of exported notes.
+         */
+        size_t export_notes_standard_format(const std::unique_ptr<Export> & export_method,
+                                            const std::string & dir) const;
+
+        /**
+         * Export all filtered notes ("m_Filtered") into one file
+         * in some standard format.
+         *
+         * Throws std::runtime_error if got error.
+         *
+         * @param export_method A file format to export notes to.
+         */
+        void export_filtered_standard_format(const std::unique_ptr<Export> & export_method) const;
+
+        /**
+         * Export all notes in a directory, including sub-directories,
+         * as a static HTML site (see Site_Export).
+         *
+         * Notes are streamed: read in chunks and rendered in batches
+         * of "Site_Export::m_BATCH_SIZE".
+         *
+         * Throws std::runtime_error if got error.
+         *
+         * @param  site An export of the site.
+         * @param  dir  A root folder where to start.
+         * @return Statistics of the export.
+         */
+        Site_Stats export_site(Site_Export & site, const std::string & dir) const;
+
+        /**
+         * Export all filtered notes ("m_Filtered") as a static HTML site.
+         *
+         * Throws std::runtime_error if got error.
+         *
+         * @param  site An export of the site.
+         * @return Statistics of the export.
+         */
+        Site_Stats export_filtered_site(Site_Export & site) const;
+
+        /**
+         * Split a note in a text format to it's body (everything but
+         * the creation timestamp, which is also it's file name)
+         * and the timestamp.
+         *
+         * @param  text      A note in a text format.
+         * @param  body      Where to store the body.
+         * @param  timestamp Where to store the timestamp.
+         * @return true, if succeeded;
+         *      false, if the note doesn't have a valid header.
+         */
+        static bool split_note_text(const std::string & text, std::string & body,
+                                    std::string & timestamp);
+
+        /**
+         * Find notes with identical content.
+         *
+         * Notes are compared by a hash of their body and metadata
+         * (everything except the creation timestamp / file name).
+         *
+         * @return Groups of paths (relative to "m_NOTES_PATH")
+         *         of identical notes.
+         */
+        std::vector<std::vector<std::string>> find_duplicates() const;
+
+        /**
+         * Keep bodies of identical notes only once.
+         *
+         * A body is stored in "m_OBJECTS_DIR" under it's hash and all
+         * duplicates are replaced with references to it. Notes saved
+         * later with the same body are saved as references as well.
+         * Shared bodies no longer referenced by any note are deleted.
+         * Throws std::runtime_error if got error.
+         *
+         * @return Statistics.
+         */
+        Dedup_Stats deduplicate();
+
+        /**
+         * Turn compression of saved notes on or off.
+         *
+         * Already saved notes are left as they are, until they are saved
+         * again (see rewrite_all()). Compressed notes are always readable.
+         * Throws std::runtime_error if couldn't save the setting.
+         *
+         * @param compress Whether or not to compress the notes.
+         */
+        void set_compression(const bool compress);
+
+        bool get_compression() const;
+
+        /**
+         * Train a shared compression dictionary on all notes in the storage
+         * and use it for compressing the notes from now on.
+         *
+         * Throws std::runtime_error if couldn't save the dictionary.
+         *
+         * @return A size of the new dictionary.
+         */
+        size_t train_dictionary();
+
+        /**
+         * Save all notes again with current compression settings.
+         *
+         * @return Amount of rewritten notes.
+         */
+        size_t rewrite_all();
+
+        /**
+         * Get statistics about compressed notes read since the last
+         * reset_compression_stats().
+         *
+         * @return Statistics.
+         */
+        Compression_Stats get_compression_stats() const;
+
+        void reset_compression_stats();
 };
 
 #endif  // NOTE_STORAGE_HPP
@@ -0,0 +1,367 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <sstream>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <filesystem>
+#include <algorithm>
+#include "note_sync.hpp"
+#include "note_storage.hpp"
+#include "notes/note.hpp"
+#include "content_hash.hpp"
+#include "server/note_client.hpp"
+
+Sync_Manifest::Sync_Manifest()
+    : m_Buckets(m_BUCKETS) { }
+
+size_t Sync_Manifest::get_bucket(const std::string & path) {
+    return static_cast<size_t>(content_hash(path) % m_BUCKETS);
+}
+
+void Sync_Manifest::add(const std::string & path, const Note & note) {
+    std::ostringstream text;
+    note.save(text);
+    Sync_Entry & entry = m_Buckets.at(get_bucket(path))[path];
+    entry.m_Hash = content_hash(text.str());
+    entry.m_Version = note.get_last_change_date().to_string();
+}
+
+void Sync_Manifest::erase(const std::string & path) {
+    m_Buckets.at(get_bucket(path)).erase(path);
+}
+
+const std::map<std::string, Sync_Entry> & Sync_Manifest::get_entries(const size_t bucket) const {
+    return m_Buckets.at(bucket);
+}
+
+std::vector<uint64_t> Sync_Manifest::get_summary() const {
+    std::vector<uint64_t> summary;
+    for (size_t i = 0; i < m_BUCKETS; i++) {
+        summary.push_back(content_hash(write_buckets({ i })));
+    }
+    return summary;
+}
+
+std::string Sync_Manifest::write_buckets(const std::vector<size_t> & buckets) const {
+    std::string text;
+    for (const size_t bucket: buckets) {
+        for (const auto & x: m_Buckets.at(bucket)) {
+            text.append(x.first + '\t' + hash_to_hex(x.second.m_Hash) + '\t' + x.second.m_Version + '\n');
+        }
+    }
+    return text;
+}
+
+void Sync_Manifest::read_buckets(const std::string & text) {
+    std::istringstream is(text);
+    std::string path, hash, version;
+    while (std::getline(is, path, '\t')) {
+        if (!std::getline(is, hash, '\t') || !std::getline(is, version)
+            || hash.size() != 16 || hash.find_first_not_of("0123456789abcdef") != std::string::npos) {
+            throw std::runtime_error("Sync_Manifest::read_buckets(): Manifest is corrupted.");
+        }
+        Sync_Entry & entry = m_Buckets.at(get_bucket(path))[path];
+        entry.m_Hash = std::stoull(hash, nullptr, 16);
+        entry.m_Version = version;
+    }
+}
+
+uint64_t Sync_Peer::get_transferred() const {
+    return m_Transferred;
+}
+
+Local_Peer::Local_Peer(Note_Storage & notes_store)
+    : m_Notes_Store(notes_store), m_Lock(notes_store) {
+    m_Notes_Store.for_each_note("", [this](std::string && path, std::unique_ptr<Note> && note) {
+        const std::string logical = Note_Storage::to_logical(path);
+        if (!logical.compare(logical.find_last_of('/') + 1, std::string::npos, note->get_file_name())) {
+            m_Manifest.add(logical, *note);
+        }
+    });
+}
+
+const Sync_Manifest & Local_Peer::get_manifest() const {
+    return m_Manifest;
+}
+
+std::vector<uint64_t> Local_Peer::get_summary() {
+    // Counted as if hashes were sent as text
+    m_Transferred += Sync_Manifest::m_BUCKETS * 17;
+    return m_Manifest.get_summary();
+}
+
+void Local_Peer::get_buckets(const std::vector<size_t> & buckets, Sync_Manifest & manifest) {
+    const std::string text = m_Manifest.write_buckets(buckets);
+    m_Transferred += text.size();
+    manifest.read_buckets(text);
+}
+
+std::string Local_Peer::fetch(const std::string & path) {
+    std::ostringstream text;
+    m_Notes_Store.read(path, false)->save(text);
+    m_Transferred += text.str().size();
+    return text.str();
+}
+
+void Local_Peer::store(const std::string & path, const std::string & text) {
+    m_Transferred += text.size();
+    std::istringstream is(text);
+    std::unique_ptr<Note> note = m_Notes_Store.parse(is);
+    const size_t last_slash = path.find_last_of('/');
+    if (path.compare(last_slash + 1, std::string::npos, note->get_file_name())) {
+        throw std::runtime_error("Local_Peer::store(): Note doesn't match it's path " + path + '.');
+    }
+    std::string dir = path.substr(0, last_slash == std::string::npos ? 0 : last_slash);
+    // Trimming the note would make it differ from the peer's one again
+    m_Notes_Store.update(*note, dir, false);
+    m_Manifest.add(path, *note);
+}
+
+void Local_Peer::remove(const std::string & path) {
+    m_Notes_Store.delete_note(path);
+    m_Manifest.erase(path);
+}
+
+Remote_Peer::Remote_Peer(const std::string & socket_path)
+    : m_Client(socket_path) { }
+
+std::string Remote_Peer::request(const std::vector<std::string> & command, const std::string & body) {
+    std::string response = m_Client.request(command, body);
+    // Lengths of frames, status and separators are counted as well
+    const size_t OVERHEAD = 2 * 4 + 3 + 1;
+    m_Transferred += OVERHEAD + body.size() + response.size();
+    for (const auto & x: command) {
+        m_Transferred += x.size() + 1;
+    }
+    return response;
+}
+
+std::vector<uint64_t> Remote_Peer::get_summary() {
+    std::istringstream is(request({ "manifest" }));
+    std::vector<uint64_t> summary;
+    std::string hash;
+    while (is >> hash) {
+        summary.push_back(std::stoull(hash, nullptr, 16));
+    }
+    if (summary.size() != Sync_Manifest::m_BUCKETS) {
+        throw std::runtime_error("Remote_Peer::get_summary(): Manifest is corrupted.");
+    }
+    return summary;
+}
+
+void Remote_Peer::get_buckets(const std::vector<size_t> & buckets, Sync_Manifest & manifest) {
+    std::vector<std::string> command = { "manifest" };
+    for (const size_t x: buckets) {
+        command.push_back(std::to_string(x));
+    }
+    manifest.read_buckets(request(command));
+}
+
+std::string Remote_Peer::fetch(const std::string & path) {
+    return request({ "get", path });
+}
+
+void Remote_Peer::store(const std::string & path, const std::string & text) {
+    request({ "put", path }, text);
+}
+
+void Remote_Peer::remove(const std::string & path) {
+    request({ "remove", path });
+}
+
+Note_Sync::Note_Sync(Note_Storage & notes_store)
+    : m_Notes_Store(notes_store) { }
+
+std::string Note_Sync::get_base_path(const std::string & peer_name) const {
+    std::string name = peer_name;
+    std::replace(name.begin(), name.end(), '/', '_');
+    return m_Notes_Store.get_notes_path() + m_BASE_DIR + name;
+}
+
+std::map<std::string, uint64_t> Note_Sync::load_base(const std::string & peer_name) const {
+    std::map<std::string, uint64_t> base;
+    std::ifstream file(get_base_path(peer_name));
+    std::string path, hash;
+    while (std::getline(file, path, '\t') && std::getline(file, hash)) {
+        base[path] = std::stoull(hash, nullptr, 16);
+    }
+    return base;
+}
+
+void Note_Sync::save_base(const std::string & peer_name, const std::map<std::string, uint64_t> & base) const {
+    namespace fs = std::filesystem;
+
+    const std::string path = get_base_path(peer_name),
+                      temporary = path + ".tmp";
+    fs::create_directories(fs::path(path).parent_path());
+    std::ofstream file(temporary, std::ios::trunc);
+    for (const auto & x: base) {
+        file << x.first << '\t' << hash_to_hex(x.second) << '\n';
+    }
+    file.close();
+    if (!file.good()) {
+        throw std::runtime_error("Note_Sync::save_base(): Couldn't save the state of the synchronization.");
+    }
+    fs::rename(temporary, path);
+}
+
+Sync_Result Note_Sync::merge(const std::string & path, Local_Peer & local, Sync_Peer & peer) const {
+    std::istringstream local_text(local.fetch(path)), peer_text(peer.fetch(path));
+    std::unique_ptr<Note> local_note = m_Notes_Store.parse(local_text),
+                          peer_note = m_Notes_Store.parse(peer_text);
+
+    // The version changed last is kept, with changes of both versions
+    const bool local_newer = local_note->get_last_change_date().compare(peer_note->get_last_change_date()) >= 0;
+    Note & kept = local_newer ? *local_note : *peer_note,
+         & lost = local_newer ? *peer_note : *local_note;
+    kept.merge_changelog(lost);
+    lost.merge_changelog(kept);
+    std::ostringstream kept_text, lost_text;
+    kept.save(kept_text);
+    lost.save(lost_text);
+
+    local.store(path, kept_text.str());
+    peer.store(path, kept_text.str());
+    if (kept_text.str() == lost_text.str()) {
+        return { path, "merged", "" };
+    }
+    return { path, "conflict", std::string("Changed on both sides, kept the ")
+                               + (local_newer ? "local" : "peer's") + " version." };
+}
+
+Sync_Result Note_Sync::sync_note(const std::string & path, const Sync_Entry * local_entry,
+                                 const Sync_Entry * peer_entry, const uint64_t * base_hash,
+                                 Local_Peer & local, Sync_Peer & peer) const {
+    if (local_entry && peer_entry) {
+        if (local_entry->m_Hash == peer_entry->m_Hash) {
+            return { path, "", "" };
+        }
+        else if (base_hash && *base_hash == local_entry->m_Hash) {
+            local.store(path, peer.fetch(path));
+            return { path, "pulled", "" };
+        }
+        else if (base_hash && *base_hash == peer_entry->m_Hash) {
+            peer.store(path, local.fetch(path));
+            return { path, "pushed", "" };
+        }
+        return merge(path, local, peer);
+    }
+    else if (local_entry) {
+        if (base_hash && *base_hash == local_entry->m_Hash) {
+            local.remove(path);
+            return { path, "deleted locally", "" };
+        }
+        peer.store(path, local.fetch(path));
+        if (base_hash) {
+            return { path, "conflict", "Deleted by the peer and changed locally, kept the note." };
+        }
+        return { path, "pushed", "" };
+    }
+
+    if (base_hash && *base_hash == peer_entry->m_Hash) {
+        peer.remove(path);
+        return { path, "deleted on peer", "" };
+    }
+    local.store(path, peer.fetch(path));
+    if (base_hash) {
+        return { path, "conflict", "Deleted locally and changed by the peer, kept the note." };
+    }
+    return { path, "pulled", "" };
+}
+
+std::vector<Sync_Result> Note_Sync::sync(Sync_Peer & peer, const std::string & peer_name) {
+    Local_Peer local(m_Notes_Store);
+    const std::vector<uint64_t> local_summary = local.get_summary(),
+                                peer_summary = peer.get_summary();
+    std::vector<size_t> buckets;
+    for (size_t i = 0; i < Sync_Manifest::m_BUCKETS; i++) {
+        if (local_summary.at(i) != peer_summary.at(i)) {
+            buckets.push_back(i);
+        }
+    }
+    Sync_Manifest peer_manifest;
+    if (buckets.size()) {
+        peer.get_buckets(buckets, peer_manifest);
+    }
+    const std::map<std::string, uint64_t> base = load_base(peer_name);
+    // A copy, local entries change while synchronizing
+    const Sync_Manifest local_manifest = local.get_manifest();
+    // Notes, which may differ
+    std::set<std::string> unsettled;
+    for (const size_t bucket: buckets) {
+        for (const auto & x: local_manifest.get_entries(bucket)) {
+            unsettled.insert(x.first);
+        }
+        for (const auto & x: peer_manifest.get_entries(bucket)) {
+            unsettled.insert(x.first);
+        }
+    }
+
+    std::vector<Sync_Result> results;
+    for (auto it = unsettled.begin(); it != unsettled.end();) {
+        const std::string & path = *it;
+        const size_t bucket = Sync_Manifest::get_bucket(path);
+        auto local_it = local_manifest.get_entries(bucket).find(path);
+        auto peer_it = peer_manifest.get_entries(bucket).find(path);
+        auto base_it = base.find(path);
+        try {
+            Sync_Result result = sync_note(path,
+                                           local_it != local_manifest.get_entries(bucket).end() ? &local_it->second : nullptr,
+                                           peer_it != peer_manifest.get_entries(bucket).end() ? &peer_it->second : nullptr,
+                                           base_it != base.end() ? &base_it->second : nullptr,
+                                           local, peer);
+            if (result.m_Action.size()) {
+                results.push_back(std::move(result));
+            }
+        }
+        catch (const std::runtime_error & e) {
+            // E.g. the connection is lost, the rest is synchronized next time
+            results.push_back({ path, "failed", e.what() });
+            break;
+        }
+        it = unsettled.erase(it);
+    }
+
+    // Settled notes are the same on both sides now, the others
+    // are compared to the previous state next time again
+    std::map<std::string, uint64_t> new_base;
+    for (size_t i = 0; i < Sync_Manifest::m_BUCKETS; i++) {
+        for (const auto & x: local.get_manifest().get_entries(i)) {
+            if (!unsettled.count(x.first)) {
+                new_base.emplace(x.first, x.second.m_Hash);
+            }
+        }
+    }
+    for (const auto & path: unsettled) {
+        auto base_it = base.find(path);
+        if (base_it != base.end()) {
+            new_base.insert(*base_it);
+        }
+    }
+    save_base(peer_name, new_base);
+    return results;
+}
+
+void Note_Sync::write_summary(std::ostream & os, const std::vector<Sync_Result> & results,
+                              const uint64_t transferred) {
+    std::map<std::string, size_t> actions;
+    for (const auto & x: results) {
+        actions[x.m_Action]++;
+        if (x.m_Message.size()) {
+            os << x.m_Path << std::endl
+               << '\t' << (x.m_Action == "failed" ? "ERROR: " : "WARNING: ") << x.m_Message
+               << std::endl << std::endl;
+        }
+    }
+    os << "INFO: Synchronized " << results.size() << " notes:";
+    for (const auto & x: actions) {
+        os << ' ' << x.second << ' ' << x.first << ';';
+    }
+    os << ' ' << transferred << " B transferred." << std::endl;
+}
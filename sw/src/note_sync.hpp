@@ -0,0 +1,296 @@
+#ifndef NOTE_SYNC_HPP
+#define NOTE_SYNC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include "note_storage.hpp"
+#include "notes/note.hpp"
+#include "server/note_client.hpp"
+
+/**
+ * A hash and a version (the date of the last change) of a note.
+ */
+struct Sync_Entry {
+    uint64_t m_Hash = 0;
+    std::string m_Version;
+};
+
+/**
+ * Hashes and versions of all notes of a storage, by logical paths.
+ *
+ * Notes are split to "m_BUCKETS" buckets by hashes of their paths,
+ * so stores can compare hashes of the buckets first and then exchange
+ * only the buckets, which differ.
+ */
+class Sync_Manifest {
+    private:
+        std::vector<std::map<std::string, Sync_Entry>> m_Buckets;
+
+    public:
+        static constexpr size_t m_BUCKETS = 1024;
+
+        Sync_Manifest();
+
+        /**
+         * Get a bucket of a path.
+         *
+         * @param  path A logical path of a note.
+         * @return An index of the bucket.
+         */
+        static size_t get_bucket(const std::string & path);
+
+        /**
+         * Add a note (or replace it).
+         *
+         * @param path A logical path of the note.
+         * @param note A note.
+         */
+        void add(const std::string & path, const Note & note);
+
+        void erase(const std::string & path);
+
+        const std::map<std::string, Sync_Entry> & get_entries(const size_t bucket) const;
+
+        /**
+         * Get hashes of all buckets.
+         *
+         * @return A hash of every bucket.
+         */
+        std::vector<uint64_t> get_summary() const;
+
+        /**
+         * Write entries of buckets as "<path>\t<hash>\t<version>" lines.
+         *
+         * @param  buckets Indices of the buckets.
+         * @return Entries in a text format.
+         */
+        std::string write_buckets(const std::vector<size_t> & buckets) const;
+
+        /**
+         * Add entries written by write_buckets().
+         *
+         * Throws std::runtime_error if the entries are corrupted.
+         *
+         * @param text Entries in a text format.
+         */
+        void read_buckets(const std::string & text);
+};
+
+/**
+ * A store to synchronize notes with.
+ *
+ * Counts bytes of everything, which it sends or receives.
+ */
+class Sync_Peer {
+    protected:
+        uint64_t m_Transferred = 0;
+
+    public:
+        virtual ~Sync_Peer() = default;
+
+        /**
+         * Get hashes of all buckets of the peer's manifest.
+         *
+         * @return A hash of every bucket.
+         */
+        virtual std::vector<uint64_t> get_summary() = 0;
+
+        /**
+         * Get entries of some buckets of the peer's manifest.
+         *
+         * @param buckets  Indices of the buckets.
+         * @param manifest Where to add the entries.
+         */
+        virtual void get_buckets(const std::vector<size_t> & buckets, Sync_Manifest & manifest) = 0;
+
+        /**
+         * Get a note in a text format.
+         *
+         * @param  path A logical path of the note.
+         * @return The note.
+         */
+        virtual std::string fetch(const std::string & path) = 0;
+
+        /**
+         * Save a note (or replace it).
+         *
+         * @param path A logical path of the note.
+         * @param text The note in a text format.
+         */
+        virtual void store(const std::string & path, const std::string & text) = 0;
+
+        virtual void remove(const std::string & path) = 0;
+
+        uint64_t get_transferred() const;
+};
+
+/**
+ * A storage in a local directory.
+ *
+ * Holds the storage's writer lock, so the storage can't change
+ * during the synchronization.
+ */
+class Local_Peer : public Sync_Peer {
+    private:
+        Note_Storage & m_Notes_Store;
+        Note_Storage::Write_Lock m_Lock;
+        Sync_Manifest m_Manifest;
+
+    public:
+        /**
+         * Load hashes of all notes of a storage.
+         *
+         * Notes in files named differently from their creation timestamps
+         * are left out (see "notepad fsck").
+         *
+         * @param notes_store A storage.
+         */
+        explicit Local_Peer(Note_Storage & notes_store);
+
+        const Sync_Manifest & get_manifest() const;
+
+        virtual std::vector<uint64_t> get_summary() override;
+        virtual void get_buckets(const std::vector<size_t> & buckets, Sync_Manifest & manifest) override;
+        virtual std::string fetch(const std::string & path) override;
+        virtual void store(const std::string & path, const std::string & text) override;
+        virtual void remove(const std::string & path) override;
+};
+
+/**
+ * A storage served by Note_Server.
+ */
+class Remote_Peer : public Sync_Peer {
+    private:
+        Note_Client m_Client;
+
+        /**
+         * Send a request to the server and count the transferred bytes.
+         */
+        std::string request(const std::vector<std::string> & command, const std::string & body = "");
+
+    public:
+        /**
+         * Connect to a server.
+         *
+         * Throws std::runtime_error if couldn't connect.
+         *
+         * @param socket_path A path to the server's socket.
+         */
+        explicit Remote_Peer(const std::string & socket_path);
+
+        virtual std::vector<uint64_t> get_summary() override;
+        virtual void get_buckets(const std::vector<size_t> & buckets, Sync_Manifest & manifest) override;
+        virtual std::string fetch(const std::string & path) override;
+        virtual void store(const std::string & path, const std::string & text) override;
+        virtual void remove(const std::string & path) override;
+};
+
+/**
+ * A result of synchronizing one note.
+ */
+struct Sync_Result {
+    std::string m_Path;
+    // "pushed", "pulled", "merged", "deleted locally", "deleted on peer",
+    // "conflict" or "failed"
+    std::string m_Action;
+    std::string m_Message;
+};
+
+/**
+ * Synchronizes a storage with another one.
+ *
+ * Only notes in buckets with different hashes are compared. A note changed
+ * on one side since the last synchronization with the peer is copied
+ * to the other one, a deleted note is deleted on the other side as well.
+ * Notes changed on both sides get merged changelogs and content
+ * of the version changed last. If the content differed, it's reported
+ * as a conflict.
+ */
+class Note_Sync {
+    private:
+        // Hashes of notes after the last synchronization, by peers
+        // (inside storage's root).
+        const std::string m_BASE_DIR = ".sync/";
+
+        Note_Storage & m_Notes_Store;
+
+        std::string get_base_path(const std::string & peer_name) const;
+
+        /**
+         * Load hashes of notes after the last synchronization with a peer.
+         *
+         * @param  peer_name A name of the peer.
+         * @return Hashes by logical paths (empty for a new peer).
+         */
+        std::map<std::string, uint64_t> load_base(const std::string & peer_name) const;
+
+        /**
+         * Save hashes of notes after a synchronization with a peer.
+         *
+         * Throws std::runtime_error if couldn't save them.
+         *
+         * @param peer_name A name of the peer.
+         * @param base      Hashes by logical paths.
+         */
+        void save_base(const std::string & peer_name, const std::map<std::string, uint64_t> & base) const;
+
+        /**
+         * Merge two versions of a note and save the result on both sides.
+         *
+         * @param  path   A logical path of the note.
+         * @param  local  The local storage.
+         * @param  peer   The other storage.
+         * @return A result of the merge.
+         */
+        Sync_Result merge(const std::string & path, Local_Peer & local, Sync_Peer & peer) const;
+
+        /**
+         * Synchronize one note.
+         *
+         * Throws std::runtime_error if got error.
+         *
+         * @param  path        A logical path of the note.
+         * @param  local_entry The note in the local storage (nullptr if there isn't one).
+         * @param  peer_entry  The note in the peer (nullptr if there isn't one).
+         * @param  base_hash   A hash after the last synchronization (nullptr if there wasn't one).
+         * @param  local       The local storage.
+         * @param  peer        The other storage.
+         * @return A result (with an empty action, if the note is the same on both sides).
+         */
+        Sync_Result sync_note(const std::string & path, const Sync_Entry * local_entry,
+                              const Sync_Entry * peer_entry, const uint64_t * base_hash,
+                              Local_Peer & local, Sync_Peer & peer) const;
+
+    public:
+        explicit Note_Sync(Note_Storage & notes_store);
+
+        /**
+         * Synchronize the storage with a peer.
+         *
+         * Stops at the first note, which couldn't be synchronized
+         * (it's reported as "failed"), the rest is synchronized next time.
+         * Throws std::runtime_error if couldn't compare the manifests.
+         *
+         * @param  peer      Another storage.
+         * @param  peer_name A name of the peer (e.g. it's path), which
+         *                   identifies the last synchronization with it.
+         * @return Results of the synchronized notes.
+         */
+        std::vector<Sync_Result> sync(Sync_Peer & peer, const std::string & peer_name);
+
+        /**
+         * Write a summary of a synchronization.
+         *
+         * @param os          A stream where to write the summary.
+         * @param results     Results of sync().
+         * @param transferred Bytes sent to or received from the peer.
+         */
+        static void write_summary(std::ostream & os, const std::vector<Sync_Result> & results,
+                                  const uint64_t transferred);
+};
+
+#endif  // NOTE_SYNC_HPP
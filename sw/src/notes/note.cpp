@@ -6,6 +6,9 @@
 #include <algorithm>
 #include <fstream>
 #include <vector>
+#include <utility>
+#include <ctime>
+#include <memory>
 #include "note.hpp"
 #include "../menu.hpp"
 
@@ -13,7 +16,7 @@ Note::Note(const std::string & current_date)
     : m_CREATION_TIMESTAMP(current_date) { }
 
 void Note::set_name(const std::string & new_name) {
-    m_Changelog.emplace_back(get_timestamp(), "Changed name: " + new_name);
+    add_change({ Note_Op::Kind::NAME, 0, new_name, "" }, "Changed name: " + new_name);
     m_Name = new_name;
 }
 
@@ -41,8 +44,8 @@ void Note::edit_tag() {
     else if (std::find(m_Tags.begin(), m_Tags.end(), new_tag) != m_Tags.end()) {
         throw std::invalid_argument("Note::edit_tag(): Tag already exists.");
     }
-    m_Changelog.emplace_back(get_timestamp(), "Changed tag: " + m_Tags.at(tag_id)
-                                              + " to: " + new_tag);
+    add_change({ Note_Op::Kind::SET_TAG, tag_id, new_tag, "" },
+               "Changed tag: " + m_Tags.at(tag_id) + " to: " + new_tag);
     m_Tags.at(tag_id) = new_tag;
 }
 
@@ -58,7 +61,7 @@ void Note::delete_tag() {
         throw std::invalid_argument("Note::delete_tag(): Invalid note ID.");
     }
 
-    m_Changelog.emplace_back(get_timestamp(), "Removed tag: " + m_Tags.at(tag_id));
+    add_change({ Note_Op::Kind::ERASE_TAG, tag_id, "", "" }, "Removed tag: " + m_Tags.at(tag_id));
     // Cast "tag_id" to long int to bypass "-Wsign-conversion"
     m_Tags.erase(m_Tags.begin() + tag_id);
 }
@@ -73,8 +76,8 @@ bool Note::add_tag() {
         return false;
     }
 
+    add_change({ Note_Op::Kind::ADD_TAG, 0, new_tag, "" }, "Added tag: " + new_tag);
     m_Tags.push_back(new_tag);
-    m_Changelog.emplace_back(get_timestamp(), "Added tag: " + new_tag);
     return true;
 }
 
@@ -147,15 +150,117 @@ void Note::edit() {
 }
 
 void Note::create() {
-    m_Changelog.emplace_back(get_timestamp(), "Created note.");
+    const Timestamp now = Timestamp::now();
+    m_Changelog.emplace_back(now, "Created note.");
+    m_History.add_base(now, capture());
     edit();
 }
 
+void Note::add_change(const Note_Op & op, const std::string & change) {
+    const Timestamp now = Timestamp::now();
+    if (m_History.empty()) {
+        m_History.add_base(m_Changelog.size() ? m_Changelog.back().first : now, capture());
+    }
+    m_History.add(now, op);
+    m_Changelog.emplace_back(now, change);
+}
+
+Note_State Note::capture() const {
+    Note_State state;
+    state.m_Name = std::make_shared<const std::string>(m_Name);
+    state.m_Tags = Persistent_Vector<std::string>(m_Tags);
+    return state;
+}
+
+void Note::restore(const Note_State & state) {
+    m_Name = *state.m_Name;
+    m_Tags = state.m_Tags.to_vector();
+}
+
+Note_History & Note::get_history() {
+    return m_History;
+}
+
+const Note_History & Note::get_history() const {
+    return m_History;
+}
+
+void Note::set_history(Note_History && history) {
+    m_History = std::move(history);
+}
+
+void Note::undo() {
+    if (!m_History.can_undo()) {
+        throw std::invalid_argument("Note::undo(): Nothing to undo.");
+    }
+    const Timestamp now = Timestamp::now();
+    const std::string to = m_History.get_undo_date().to_string();
+    m_History.add(now, { Note_Op::Kind::UNDO, 0, "", "" });
+    restore(m_History.get_current());
+    m_Changelog.emplace_back(now, "Undid changes after: " + to);
+}
+
+void Note::redo() {
+    if (!m_History.can_redo()) {
+        throw std::invalid_argument("Note::redo(): Nothing to redo.");
+    }
+    const Timestamp now = Timestamp::now();
+    const std::string to = m_History.get_redo_date().to_string();
+    m_History.add(now, { Note_Op::Kind::REDO, 0, "", "" });
+    restore(m_History.get_current());
+    m_Changelog.emplace_back(now, "Redid changes up to: " + to);
+}
+
+bool Note::rewind(const Timestamp & date) {
+    const Note_State * state = m_History.as_of(date);
+    if (!state) {
+        return false;
+    }
+    restore(*state);
+    // The first entry (creation) is always kept
+    auto later = std::find_if(m_Changelog.begin() + 1, m_Changelog.end(),
+                              [&](const auto & x) { return x.first.compare(date) > 0; });
+    m_Changelog.erase(later, m_Changelog.end());
+    return true;
+}
+
+std::vector<std::pair<Timestamp, std::string>> Note::compact(const Retention_Policy & policy) {
+    return policy.apply(m_Changelog, std::time(nullptr));
+}
+
+void Note::merge_changelog(const Note & other) {
+    std::vector<std::pair<Timestamp, std::string>> merged;
+    merged.reserve(m_Changelog.size() + other.m_Changelog.size());
+    auto a = m_Changelog.begin();
+    auto b = other.m_Changelog.begin();
+    while (a != m_Changelog.end() || b != other.m_Changelog.end()) {
+        if (b == other.m_Changelog.end()) {
+            merged.push_back(std::move(*a++));
+            continue;
+        }
+        else if (a == m_Changelog.end()) {
+            merged.push_back(*b++);
+            continue;
+        }
+
+        const int cmp = a->first.compare(b->first);
+        if (!cmp && a->second == b->second) {
+            b++;
+        }
+        else if (cmp > 0) {
+            merged.push_back(*b++);
+            continue;
+        }
+        merged.push_back(std::move(*a++));
+    }
+    m_Changelog = std::move(merged);
+}
+
 const std::string & Note::get_file_name() const {
     return m_CREATION_TIMESTAMP;
 }
 
-void Note::save(std::ofstream & os) const {
+void Note::save(std::ostream & os) const {
     os << m_CREATION_TIMESTAMP << std::endl << std::endl
        << m_Name << std::endl << std::endl;
     for (const auto & x: m_Tags) {
@@ -170,24 +275,33 @@ void Note::save(std::ofstream & os) const {
     os << std::endl << std::endl;
 }
 
-void Note::print(std::ostream & os) const {
-    os << std::endl
-       << "Tags:" << std::endl;
+void Note::write_record(Record_Writer & writer) const {
+    writer.string_field("name", m_Name);
+    writer.list_field("tags", m_Tags);
+    char date[Timestamp::m_TEXT_SIZE];
+    writer.string_field("creation_date", get_creation_date().view(date));
+    writer.changelog_field("changelog", m_Changelog);
+}
+
+void Note::print(std::ostream & os, const Print_Limits & limits) const {
+    os << "\nTags:\n";
     for (const auto & x: m_Tags) {
-        os << '\t' << x
-           << std::endl;
+        os << '\t' << x << '\n';
     }
 
-    os << std::endl
-       << "Changelog:";
-    for (const auto & x: m_Changelog) {
-        os << std::endl
-           << '\t' << x.first << " - " << x.second;
+    os << "\nChangelog:";
+    size_t begin = 0;
+    if (limits.m_Changes && limits.m_Changes < m_Changelog.size()) {
+        begin = m_Changelog.size() - limits.m_Changes;
+        os << "\n\t... " << begin << " earlier changes";
     }
-    os << std::endl;
+    for (size_t i = begin; i < m_Changelog.size(); i++) {
+        os << "\n\t" << m_Changelog[i].first << " - " << m_Changelog[i].second;
+    }
+    os << '\n';
 }
 
-void Note::read(std::ifstream & os) {
+void Note::read(std::istream & os) {
     const std::string corrupted = "Note::read(): File is corrupted.",
                       damaged = "Note::read(): File is damaged.";
 
@@ -237,7 +351,7 @@ void Note::read(std::ifstream & os) {
             throw std::runtime_error(corrupted);
         }
         change.erase(change.begin());
-        m_Changelog.emplace_back(skip, change);
+        m_Changelog.emplace_back(Timestamp(skip), change);
         cnt++;
     }
     if (!cnt) {
@@ -260,10 +374,14 @@ const std::string & Note::get_name() const {
     return m_Name;
 }
 
-const std::string & Note::get_creation_date() const {
+const Timestamp & Note::get_creation_date() const {
     return m_Changelog.front().first;
 }
 
+const Timestamp & Note::get_last_change_date() const {
+    return m_Changelog.back().first;
+}
+
 const std::vector<std::string> & Note::get_tags() const {
     return m_Tags;
 }
@@ -2,10 +2,26 @@
 #define NOTE_HPP
 
 #include <string>
+#include <cstddef>
 #include <vector>
 #include <utility>
 #include <fstream>
 #include <ostream>
+#include <istream>
+#include "../exports/record_writer.hpp"
+#include "../timestamp.hpp"
+#include "../retention_policy.hpp"
+#include "note_history.hpp"
+
+/**
+ * Limits of printed notes, 0 for no limit.
+ */
+struct Print_Limits {
+    // How many items of lists to print (the first ones).
+    size_t m_Items = 0;
+    // How many changes to print (the last ones).
+    size_t m_Changes = 0;
+};
 
 /**
  * A base abstract polymorphic class for all other note types.
@@ -15,6 +31,9 @@ class Note {
     private:
         const std::string m_CREATION_TIMESTAMP;
         std::vector<std::string> m_Tags;
+        // Versions of the note (only loaded when needed, otherwise
+        // started by the first change)
+        Note_History m_History;
 
         /**
          * Set a name of the note and add change to the changelog.
@@ -54,7 +73,19 @@ class Note {
     protected:
         std::string m_Name;
         // 1st element is timestamp, 2nd element is a change.
-        std::vector<std::pair<std::string, std::string>> m_Changelog;
+        std::vector<std::pair<Timestamp, std::string>> m_Changelog;
+
+        /**
+         * Record a change in the history and in the changelog.
+         *
+         * Must be called before the note is changed, the first change
+         * starts the history with the note's current state.
+         * Throws std::invalid_argument if the change can't be applied.
+         *
+         * @param op     The change.
+         * @param change A description of the change for the changelog.
+         */
+        void add_change(const Note_Op & op, const std::string & change);
 
     public:
         explicit Note(const std::string & current_date);
@@ -76,6 +107,71 @@ class Note {
          */
         void create();
 
+        /**
+         * Trim the changelog according to a retention policy.
+         *
+         * @param  policy A retention policy.
+         * @return Trimmed entries (oldest first).
+         */
+        std::vector<std::pair<Timestamp, std::string>> compact(const Retention_Policy & policy);
+
+        /**
+         * Merge a changelog of another version of the note into this one.
+         *
+         * Entries are merged by timestamps, entries present in both
+         * changelogs are kept once.
+         *
+         * @param other Another version of the note.
+         */
+        void merge_changelog(const Note & other);
+
+        /**
+         * Get the current state of the note (copies all of it).
+         *
+         * In base class gets name and tags, overrides add their items.
+         *
+         * @return The state.
+         */
+        virtual Note_State capture() const;
+
+        /**
+         * Set the note to a state (e.g. an older version).
+         *
+         * @param state A state of the note.
+         */
+        virtual void restore(const Note_State & state);
+
+        Note_History & get_history();
+
+        const Note_History & get_history() const;
+
+        void set_history(Note_History && history);
+
+        /**
+         * Return to the version before the last change (which wasn't undone).
+         *
+         * The history must be loaded (see Note_Storage::load_history()).
+         * Throws std::invalid_argument if there is nothing to undo.
+         */
+        void undo();
+
+        /**
+         * Return to the version before the last undo.
+         *
+         * Throws std::invalid_argument if there is nothing to redo.
+         */
+        void redo();
+
+        /**
+         * Set the note to it's version as of a date and drop later changes
+         * from the changelog (to show it, it shouldn't be saved).
+         *
+         * @param  date A date.
+         * @return true, if the history has a version that old;
+         *      false otherwise.
+         */
+        bool rewind(const Timestamp & date);
+
         /**
          * Get a note's file name (creation timestamp).
          *
@@ -86,22 +182,34 @@ class Note {
         /**
          * Save a note.
          *
-         * Save a note to a file (provided std::ofstream &).
+         * Save a note to a stream (provided std::ostream &).
          * In base class saves creation timestamp, name, tags and changelog.
          *
-         * @param os An std::ofstream & to save the note to.
+         * @param os An std::ostream & to save the note to.
          */
-        virtual void save(std::ofstream & os) const;
+        virtual void save(std::ostream & os) const;
+
+        /**
+         * Write the note's fields to a record-based export.
+         *
+         * In base class writes name, tags, creation date and changelog.
+         * Overrides write "type" before and their content after that.
+         *
+         * @param writer A writer of the record.
+         */
+        virtual void write_record(Record_Writer & writer) const;
 
         /**
          * Print a note to the provided std::ostream.
          *
          * Prints a full note and it's changelog to the provided std::ostream.
-         * In a base class, prints changelog.
+         * In a base class, prints changelog. Lines aren't flushed.
          *
-         * @param os An output stream to print the note.
+         * @param os     An output stream to print the note.
+         * @param limits Limits of lists and of the changelog, parts
+         *               over them are replaced by a line with a count.
         */
-        virtual void print(std::ostream & os) const;
+        virtual void print(std::ostream & os, const Print_Limits & limits = Print_Limits()) const;
 
         /**
          * Finish initializing the note (finish reading the file).
@@ -110,7 +218,7 @@ class Note {
          *
          * @param os An input stream where to read the note from
          */
-        virtual void read(std::ifstream & os);
+        virtual void read(std::istream & os);
 
         /**
          * Get a brief summary of the note.
@@ -135,7 +243,15 @@ class Note {
          * @return Const reference to first element in first pair in
          *         "m_Changelog".
          */
-        const std::string & get_creation_date() const;
+        const Timestamp & get_creation_date() const;
+
+        /**
+         * Get a date of the last change. Is useful for sorting.
+         *
+         * @return Const reference to first element in last pair in
+         *         "m_Changelog".
+         */
+        const Timestamp & get_last_change_date() const;
 
         /**
          * Get tags. Is useful in filters.
@@ -144,6 +260,14 @@ class Note {
          */
         const std::vector<std::string> & get_tags() const;
 
+        /**
+         * Get amount of items of the note (records of lists, 0 for text).
+         * Is useful for sorting.
+         *
+         * @return Amount of items.
+         */
+        virtual size_t get_item_count() const = 0;
+
         /**
          * Checks whether or not the note contains the provided text.
          *
@@ -0,0 +1,353 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+#include "note_history.hpp"
+#include "../timestamp.hpp"
+#include "../persistent_vector.hpp"
+
+namespace {
+    // Names of Note_Op::Kind in saved histories, in order of the enum
+    const char * const KIND_NAMES[] = {
+        "base", "name", "add_tag", "set_tag", "erase_tag",
+        "add_item", "set_item", "erase_item", "undo", "redo"
+    };
+}
+
+Note_State::Note_State()
+    : m_Name(std::make_shared<const std::string>()) { }
+
+bool Note_State::operator == (const Note_State & other) const {
+    return *m_Name == *other.m_Name && m_Tags == other.m_Tags && m_Items == other.m_Items;
+}
+
+Note_State Note_Op::apply(const Note_State & state) const {
+    Note_State result = state;
+    const size_t tags = state.m_Tags.size(),
+                 items = state.m_Items.size();
+    switch (m_Kind) {
+        case Kind::NAME:
+            result.m_Name = std::make_shared<const std::string>(m_First);
+            return result;
+        case Kind::ADD_TAG:
+            result.m_Tags = state.m_Tags.push_back(m_First);
+            return result;
+        case Kind::SET_TAG:
+            if (m_Index < tags) {
+                result.m_Tags = state.m_Tags.set(m_Index, m_First);
+                return result;
+            }
+            break;
+        case Kind::ERASE_TAG:
+            if (m_Index < tags) {
+                result.m_Tags = state.m_Tags.erase(m_Index);
+                return result;
+            }
+            break;
+        case Kind::ADD_ITEM:
+            result.m_Items = state.m_Items.push_back({ m_First, m_Second });
+            return result;
+        case Kind::SET_ITEM:
+            if (m_Index < items) {
+                result.m_Items = state.m_Items.set(m_Index, { m_First, m_Second });
+                return result;
+            }
+            break;
+        case Kind::ERASE_ITEM:
+            if (m_Index < items) {
+                result.m_Items = state.m_Items.erase(m_Index);
+                return result;
+            }
+            break;
+        case Kind::BASE:
+        case Kind::UNDO:
+        case Kind::REDO:
+            throw std::invalid_argument("Note_Op::apply(): Not an edit.");
+    }
+    throw std::invalid_argument("Note_Op::apply(): Invalid index.");
+}
+
+bool Note_History::empty() const {
+    return m_Versions.empty();
+}
+
+size_t Note_History::size() const {
+    return m_Versions.size();
+}
+
+bool Note_History::is_loaded() const {
+    return m_Loaded;
+}
+
+bool Note_History::has_unsaved() const {
+    return m_Saved < m_Versions.size();
+}
+
+void Note_History::add_base(Timestamp date, const Note_State & state) {
+    if (m_Versions.size()) {
+        if (date.compare(m_Versions.back().m_Date) < 0) {
+            date = m_Versions.back().m_Date;
+        }
+        m_Undo.push_back(m_Versions.size() - 1);
+        m_Redo.clear();
+    }
+    m_Versions.push_back({ date, { Note_Op::Kind::BASE, 0, "", "" }, state });
+}
+
+void Note_History::add(const Timestamp & date, const Note_Op & op) {
+    if (m_Versions.empty()) {
+        throw std::invalid_argument("Note_History::add(): History has no base.");
+    }
+    const size_t current = m_Versions.size() - 1;
+    if (op.m_Kind == Note_Op::Kind::BASE) {
+        throw std::invalid_argument("Note_History::add(): Use add_base() for a base.");
+    }
+    else if (op.m_Kind == Note_Op::Kind::UNDO || op.m_Kind == Note_Op::Kind::REDO) {
+        std::vector<size_t> & from = op.m_Kind == Note_Op::Kind::UNDO ? m_Undo : m_Redo,
+                            & to = op.m_Kind == Note_Op::Kind::UNDO ? m_Redo : m_Undo;
+        if (from.empty()) {
+            throw std::invalid_argument(op.m_Kind == Note_Op::Kind::UNDO ? "Note_History::add(): Nothing to undo."
+                                                                         : "Note_History::add(): Nothing to redo.");
+        }
+        const size_t target = from.back();
+        from.pop_back();
+        to.push_back(current);
+        // The state is shared with the older version, nothing is copied
+        m_Versions.push_back({ date, op, m_Versions.at(target).m_State });
+        return;
+    }
+
+    m_Versions.push_back({ date, op, op.apply(m_Versions.at(current).m_State) });
+    m_Undo.push_back(current);
+    m_Redo.clear();
+}
+
+void Note_History::append(const Note_History & other) {
+    for (size_t i = 1; i < other.m_Versions.size(); i++) {
+        const Version & version = other.m_Versions.at(i);
+        if (version.m_Op.m_Kind == Note_Op::Kind::BASE) {
+            add_base(version.m_Date, version.m_State);
+        }
+        else {
+            add(version.m_Date, version.m_Op);
+        }
+    }
+}
+
+const Note_State & Note_History::get_current() const {
+    return m_Versions.back().m_State;
+}
+
+const Note_State & Note_History::get_first() const {
+    return m_Versions.front().m_State;
+}
+
+const Timestamp & Note_History::get_first_date() const {
+    return m_Versions.front().m_Date;
+}
+
+bool Note_History::can_undo() const {
+    return !m_Undo.empty();
+}
+
+bool Note_History::can_redo() const {
+    return !m_Redo.empty();
+}
+
+const Timestamp & Note_History::get_undo_date() const {
+    return m_Versions.at(m_Undo.back()).m_Date;
+}
+
+const Timestamp & Note_History::get_redo_date() const {
+    return m_Versions.at(m_Redo.back()).m_Date;
+}
+
+const Note_State * Note_History::as_of(const Timestamp & date) const {
+    // Versions are in order of their dates
+    auto it = std::upper_bound(m_Versions.begin(), m_Versions.end(), date,
+                               [](const Timestamp & x, const Version & version) { return x.compare(version.m_Date) < 0; });
+    if (it == m_Versions.begin()) {
+        return nullptr;
+    }
+    return &std::prev(it)->m_State;
+}
+
+void Note_History::trim(const size_t keep) {
+    if (keep >= m_Versions.size()) {
+        m_Saved = 0;
+        return;
+    }
+    Note_History trimmed;
+    for (size_t i = m_Versions.size() - keep; i < m_Versions.size(); i++) {
+        const Version & version = m_Versions.at(i);
+        const Note_Op::Kind kind = version.m_Op.m_Kind;
+        if (trimmed.empty() || kind == Note_Op::Kind::BASE
+            || kind == Note_Op::Kind::UNDO || kind == Note_Op::Kind::REDO) {
+            trimmed.add_base(version.m_Date, version.m_State);
+        }
+        else {
+            trimmed.add(version.m_Date, version.m_Op);
+        }
+    }
+    trimmed.m_Loaded = m_Loaded;
+    *this = std::move(trimmed);
+}
+
+void Note_History::write_field(std::ostream & os, const std::string & text) {
+    os.put('\t');
+    for (const char c: text) {
+        switch (c) {
+            case '\\': os.write("\\\\", 2); break;
+            case '\t': os.write("\\t", 2); break;
+            case '\n': os.write("\\n", 2); break;
+            default: os.put(c);
+        }
+    }
+}
+
+std::vector<std::string> Note_History::split_line(const std::string & line) {
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < line.size(); i++) {
+        if (line[i] == '\t') {
+            fields.emplace_back();
+        }
+        else if (line[i] == '\\' && i + 1 < line.size()) {
+            const char c = line[++i];
+            fields.back().push_back(c == 't' ? '\t' : c == 'n' ? '\n' : c);
+        }
+        else {
+            fields.back().push_back(line[i]);
+        }
+    }
+    return fields;
+}
+
+void Note_History::write_version(std::ostream & os, const Version & version) const {
+    os << version.m_Date;
+    write_field(os, KIND_NAMES[static_cast<size_t>(version.m_Op.m_Kind)]);
+    if (version.m_Op.m_Kind == Note_Op::Kind::BASE) {
+        // "<date>\tbase\t<name>\t<tag count>\t<tags>...\t<item>\t<second>..."
+        write_field(os, *version.m_State.m_Name);
+        write_field(os, std::to_string(version.m_State.m_Tags.size()));
+        for (const auto & x: version.m_State.m_Tags.to_vector()) {
+            write_field(os, x);
+        }
+        for (const auto & x: version.m_State.m_Items.to_vector()) {
+            write_field(os, x.first);
+            write_field(os, x.second);
+        }
+    }
+    else {
+        // "<date>\t<kind>\t<index>\t<first>\t<second>"
+        write_field(os, std::to_string(version.m_Op.m_Index));
+        write_field(os, version.m_Op.m_First);
+        write_field(os, version.m_Op.m_Second);
+    }
+    os << '\n';
+}
+
+void Note_History::read(std::istream & is) {
+    const std::string corrupted = "Note_History::read(): History is corrupted.";
+
+    std::string line;
+    while (std::getline(is, line)) {
+        const std::vector<std::string> fields = split_line(line);
+        if (fields.size() < 2) {
+            throw std::runtime_error(corrupted);
+        }
+        const auto kind = std::find(std::begin(KIND_NAMES), std::end(KIND_NAMES), fields.at(1));
+        if (kind == std::end(KIND_NAMES)) {
+            throw std::runtime_error(corrupted);
+        }
+        Note_Op op = { static_cast<Note_Op::Kind>(kind - std::begin(KIND_NAMES)), 0, "", "" };
+
+        try {
+            if (op.m_Kind == Note_Op::Kind::BASE) {
+                const size_t tags = fields.size() >= 4 ? std::stoul(fields.at(3)) : 0;
+                if (fields.size() < 4 || fields.size() < 4 + tags || (fields.size() - 4 - tags) % 2) {
+                    throw std::runtime_error(corrupted);
+                }
+                Note_State state;
+                state.m_Name = std::make_shared<const std::string>(fields.at(2));
+                state.m_Tags = Persistent_Vector<std::string>(
+                    std::vector<std::string>(fields.begin() + 4, fields.begin() + 4 + static_cast<std::ptrdiff_t>(tags)));
+                std::vector<std::pair<std::string, std::string>> items;
+                for (size_t i = 4 + tags; i < fields.size(); i += 2) {
+                    items.emplace_back(fields.at(i), fields.at(i + 1));
+                }
+                state.m_Items = Persistent_Vector<std::pair<std::string, std::string>>(items);
+                if (m_Versions.empty() || !(get_current() == state)) {
+                    add_base(Timestamp(fields.at(0)), state);
+                }
+                continue;
+            }
+            if (fields.size() != 5) {
+                throw std::runtime_error(corrupted);
+            }
+            op.m_Index = std::stoul(fields.at(2));
+            op.m_First = fields.at(3);
+            op.m_Second = fields.at(4);
+            add(Timestamp(fields.at(0)), op);
+        }
+        catch (const std::logic_error &) {
+            // Invalid numbers or changes, which don't fit the history
+            throw std::runtime_error(corrupted);
+        }
+    }
+    if (is.bad()) {
+        throw std::runtime_error("Note_History::read(): History is damaged.");
+    }
+    m_Saved = m_Versions.size();
+    m_Loaded = true;
+}
+
+void Note_History::write_unsaved(std::ostream & os) {
+    for (; m_Saved < m_Versions.size(); m_Saved++) {
+        write_version(os, m_Versions.at(m_Saved));
+    }
+}
+
+void Note_History::print(std::ostream & os) const {
+    for (size_t i = 0; i < m_Versions.size(); i++) {
+        const Version & version = m_Versions.at(i);
+        os << i + 1 << ". " << version.m_Date << " - " << KIND_NAMES[static_cast<size_t>(version.m_Op.m_Kind)];
+        switch (version.m_Op.m_Kind) {
+            case Note_Op::Kind::BASE:
+                os << " (" << version.m_State.m_Tags.size() << " tags, "
+                   << version.m_State.m_Items.size() << " items)";
+                break;
+            case Note_Op::Kind::NAME:
+            case Note_Op::Kind::ADD_TAG:
+                os << ": " << version.m_Op.m_First;
+                break;
+            case Note_Op::Kind::SET_TAG:
+                os << ' ' << version.m_Op.m_Index + 1 << ": " << version.m_Op.m_First;
+                break;
+            case Note_Op::Kind::ERASE_TAG:
+            case Note_Op::Kind::ERASE_ITEM:
+                os << ' ' << version.m_Op.m_Index + 1;
+                break;
+            case Note_Op::Kind::ADD_ITEM:
+                os << ": " << version.m_Op.m_First;
+                if (version.m_Op.m_Second.size()) {
+                    os << " - " << version.m_Op.m_Second;
+                }
+                break;
+            case Note_Op::Kind::SET_ITEM:
+                os << ' ' << version.m_Op.m_Index + 1 << ": " << version.m_Op.m_First;
+                if (version.m_Op.m_Second.size()) {
+                    os << " - " << version.m_Op.m_Second;
+                }
+                break;
+            case Note_Op::Kind::UNDO:
+            case Note_Op::Kind::REDO:
+                break;
+        }
+        os << '\n';
+    }
+}
@@ -0,0 +1,207 @@
+#ifndef NOTE_HISTORY_HPP
+#define NOTE_HISTORY_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <istream>
+#include <ostream>
+#include "../timestamp.hpp"
+#include "../persistent_vector.hpp"
+
+/**
+ * Editable content of a note at some moment.
+ *
+ * Items are pairs in all note types: (item, "") in shopping lists,
+ * (task, deadline) in to-do lists and (text, "") in text notes.
+ * States share everything, which didn't change between them.
+ */
+struct Note_State {
+    std::shared_ptr<const std::string> m_Name;
+    Persistent_Vector<std::string> m_Tags;
+    Persistent_Vector<std::pair<std::string, std::string>> m_Items;
+
+    Note_State();
+
+    bool operator == (const Note_State & other) const;
+};
+
+/**
+ * One structured change of a note.
+ */
+struct Note_Op {
+    enum class Kind {
+        // The whole state (the first version, or a note changed
+        // outside of the history)
+        BASE,
+        NAME,
+        ADD_TAG,
+        SET_TAG,
+        ERASE_TAG,
+        ADD_ITEM,
+        SET_ITEM,
+        ERASE_ITEM,
+        UNDO,
+        REDO
+    };
+
+    Kind m_Kind;
+    size_t m_Index = 0;
+    std::string m_First, m_Second;
+
+    /**
+     * Apply an edit (not BASE, UNDO or REDO) to a state.
+     *
+     * Throws std::invalid_argument if the index is invalid.
+     *
+     * @param  state A state before the edit.
+     * @return A state after the edit.
+     */
+    Note_State apply(const Note_State & state) const;
+};
+
+/**
+ * Versions of a note, one after every change.
+ *
+ * A version keeps it's change and a whole state, but states share
+ * unchanged parts, so a version takes only a little more memory than
+ * the change. Undo and redo are versions too (with a state of an older
+ * version), so the history is only appended to. Saved as a log
+ * of the changes.
+ */
+class Note_History {
+    private:
+        struct Version {
+            Timestamp m_Date;
+            Note_Op m_Op;
+            Note_State m_State;
+        };
+
+        std::vector<Version> m_Versions;
+        // Versions to return to by undo() and redo()
+        std::vector<size_t> m_Undo, m_Redo;
+        // How many versions are saved
+        size_t m_Saved = 0;
+        // Whether or not the history was read from a file (otherwise it
+        // starts with a base recorded when the note was changed).
+        bool m_Loaded = false;
+
+        /**
+         * Write a field escaped, so it doesn't contain tabs or new lines.
+         */
+        static void write_field(std::ostream & os, const std::string & text);
+
+        /**
+         * Split a line to unescaped fields.
+         */
+        static std::vector<std::string> split_line(const std::string & line);
+
+        void write_version(std::ostream & os, const Version & version) const;
+
+    public:
+        bool empty() const;
+
+        size_t size() const;
+
+        bool is_loaded() const;
+
+        bool has_unsaved() const;
+
+        /**
+         * Add a version with a whole state.
+         *
+         * Versions are kept in order of their dates, a base older than
+         * the last version gets the last version's date.
+         *
+         * @param date  A date of the version.
+         * @param state A state of the note.
+         */
+        void add_base(Timestamp date, const Note_State & state);
+
+        /**
+         * Add a version after a change (or an undo or a redo).
+         *
+         * Throws std::invalid_argument if the change can't be applied
+         * (there is nothing to undo or redo, or an index is invalid).
+         *
+         * @param date A date of the change.
+         * @param op   The change.
+         */
+        void add(const Timestamp & date, const Note_Op & op);
+
+        /**
+         * Add versions of another history, which follow it's first one
+         * (changes recorded before this history was read).
+         *
+         * Throws std::invalid_argument if the changes can't be applied.
+         *
+         * @param other Another history.
+         */
+        void append(const Note_History & other);
+
+        const Note_State & get_current() const;
+
+        const Note_State & get_first() const;
+
+        const Timestamp & get_first_date() const;
+
+        bool can_undo() const;
+
+        bool can_redo() const;
+
+        /**
+         * Get a date of a version, which undo() or redo() would return to.
+         */
+        const Timestamp & get_undo_date() const;
+
+        const Timestamp & get_redo_date() const;
+
+        /**
+         * Get a state as of a date.
+         *
+         * @param  date A date.
+         * @return The state of the last version before (or at) the date,
+         *         nullptr if the history starts after it.
+         */
+        const Note_State * as_of(const Timestamp & date) const;
+
+        /**
+         * Keep only the newest versions.
+         *
+         * The oldest kept version, undos and redos become bases (versions
+         * they return to might be dropped), so states of the kept versions
+         * don't change. All versions are unsaved afterwards.
+         *
+         * @param keep How many versions to keep.
+         */
+        void trim(const size_t keep);
+
+        /**
+         * Read a history written by write_unsaved().
+         *
+         * A base with the same state as the version before it (appended
+         * by a writer, which didn't load the history) is skipped.
+         * Throws std::runtime_error if it's corrupted.
+         *
+         * @param is A stream to read the history from.
+         */
+        void read(std::istream & is);
+
+        /**
+         * Write versions, which weren't saved yet, and mark them saved.
+         *
+         * @param os A stream to append the versions to.
+         */
+        void write_unsaved(std::ostream & os);
+
+        /**
+         * Print the versions, one per line.
+         *
+         * @param os A stream to print to.
+         */
+        void print(std::ostream & os) const;
+};
+
+#endif  // NOTE_HISTORY_HPP
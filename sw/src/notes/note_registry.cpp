@@ -0,0 +1,81 @@
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <array>
+#include <memory>
+#include <istream>
+#include <algorithm>
+#include <cctype>
+#include "note_registry.hpp"
+#include "note.hpp"
+#include "text.hpp"
+#include "shopping_list.hpp"
+#include "todo_list.hpp"
+#include "../perfect_hash.hpp"
+
+namespace {
+    template <typename T>
+    std::unique_ptr<Note> create(const std::string & creation_timestamp) {
+        return std::make_unique<T>(creation_timestamp);
+    }
+
+    template <typename T>
+    std::unique_ptr<Note> parse(const std::string & creation_timestamp, std::istream & is) {
+        std::unique_ptr<T> note = std::make_unique<T>(creation_timestamp);
+        // Not a virtual call, the exact class is known
+        note->T::read(is);
+        return note;
+    }
+
+    constexpr std::array<Note_Type, Note_Registry::m_COUNT> TYPES = {{
+        { Text::m_TYPE, "Text", "T", "a text note",
+          create<Text>, parse<Text> },
+        { Shopping_List::m_TYPE, "Shopping List", "ST", "a shopping list",
+          create<Shopping_List>, parse<Shopping_List> },
+        { TODO_List::m_TYPE, "To-do list", "TDL", "a to-do list",
+          create<TODO_List>, parse<TODO_List> }
+    }};
+
+    constexpr std::array<std::string_view, Note_Registry::m_COUNT> get_names() {
+        std::array<std::string_view, Note_Registry::m_COUNT> names {};
+        for (size_t i = 0; i < names.size(); i++) {
+            names[i] = TYPES[i].m_Name;
+        }
+        return names;
+    }
+
+    constexpr size_t SLOTS = 4 * Note_Registry::m_COUNT;
+    constexpr Perfect_Hash<Note_Registry::m_COUNT, SLOTS> BY_NAME(get_names());
+
+    constexpr bool finds_all_names() {
+        for (size_t i = 0; i < TYPES.size(); i++) {
+            if (BY_NAME.find(TYPES[i].m_Name) != i) {
+                return false;
+            }
+        }
+        return BY_NAME.find("") == Note_Registry::m_COUNT;
+    }
+    static_assert(finds_all_names(), "Note_Registry: Names of the types aren't found.");
+}
+
+const std::array<Note_Type, Note_Registry::m_COUNT> & Note_Registry::get_types() {
+    return TYPES;
+}
+
+const Note_Type * Note_Registry::find(const std::string_view name) {
+    const size_t index = BY_NAME.find(name);
+    return index < m_COUNT ? &TYPES[index] : nullptr;
+}
+
+const Note_Type * Note_Registry::find_by_user_name(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    for (const auto & x: TYPES) {
+        std::string title(x.m_Title), short_name(x.m_Short_Name);
+        std::transform(title.begin(), title.end(), title.begin(), ::tolower);
+        std::transform(short_name.begin(), short_name.end(), short_name.begin(), ::tolower);
+        if (name == x.m_Name || name == title || name == short_name) {
+            return &x;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,74 @@
+#ifndef NOTE_REGISTRY_HPP
+#define NOTE_REGISTRY_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <array>
+#include <memory>
+#include <istream>
+#include "note.hpp"
+
+/**
+ * A description of a note type.
+ */
+struct Note_Type {
+    // A name in note files and exports (e.g. "shopping list")
+    std::string_view m_Name;
+    // A name and a short name the user can choose the type by in the menu
+    std::string_view m_Title, m_Short_Name;
+    // What the type is for (e.g. "a shopping list")
+    std::string_view m_Description;
+
+    /**
+     * Create an empty note.
+     *
+     * @param creation_timestamp A file name of the note.
+     */
+    std::unique_ptr<Note> (*m_Create)(const std::string & creation_timestamp);
+
+    /**
+     * Create a note and read it's content (everything after the header).
+     *
+     * Throws std::runtime_error if got problems in input.
+     *
+     * @param creation_timestamp A file name of the note.
+     * @param is                 A stream to read the note from.
+     */
+    std::unique_ptr<Note> (*m_Parse)(const std::string & creation_timestamp, std::istream & is);
+};
+
+/**
+ * All note types.
+ *
+ * The types are described by one table in note_registry.cpp, adding
+ * a row there is all it takes to make a new type known to the storage
+ * and to the menu. Names in note files are looked up by a perfect hash
+ * built at compile time and notes are read by reading functions of the
+ * exact (final) classes, so reading a note doesn't compare it's type
+ * with every name and doesn't go through virtual calls.
+ */
+class Note_Registry {
+    public:
+        static constexpr size_t m_COUNT = 3;
+
+        static const std::array<Note_Type, m_COUNT> & get_types();
+
+        /**
+         * Find a type by it's name in note files.
+         *
+         * @param  name A name of the type.
+         * @return The type, nullptr if there is no such type.
+         */
+        static const Note_Type * find(std::string_view name);
+
+        /**
+         * Find a type chosen by the user (case insensitive).
+         *
+         * @param  name A name, a title or a short name of the type.
+         * @return The type, nullptr if there is no such type.
+         */
+        static const Note_Type * find_by_user_name(std::string name);
+};
+
+#endif  // NOTE_REGISTRY_HPP
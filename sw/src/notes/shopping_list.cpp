@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <fstream>
 #include <ostream>
+#include <vector>
+#include <utility>
 #include "note.hpp"
 #include "shopping_list.hpp"
 #include "../menu.hpp"
@@ -36,8 +38,8 @@ void Shopping_List::edit_record() {
     }
     // Difference from Note::edit_tag() is that here
     // we can have duplicit items
-    m_Changelog.emplace_back(get_timestamp(), "Changed item: " + m_List.at(record_num)
-                                             + " to: " + new_item);
+    add_change({ Note_Op::Kind::SET_ITEM, record_num, new_item, "" },
+               "Changed item: " + m_List.at(record_num) + " to: " + new_item);
     m_List.at(record_num) = new_item;
 }
 
@@ -53,7 +55,7 @@ void Shopping_List::delete_record() {
         throw std::invalid_argument("Shopping_List::edit_record(): Invalid record number.");
     }
 
-    m_Changelog.emplace_back(get_timestamp(), "Removed item: " + m_List.at(record_num));
+    add_change({ Note_Op::Kind::ERASE_ITEM, record_num, "", "" }, "Removed item: " + m_List.at(record_num));
     // Cast "tag_id" to long int to bypass "-Wsign-conversion"
     m_List.erase(m_List.begin() + record_num);
 }
@@ -69,7 +71,7 @@ bool Shopping_List::add_record() {
         return false;
     }
 
-    m_Changelog.emplace_back(get_timestamp(), "Added item: " + new_item);
+    add_change({ Note_Op::Kind::ADD_ITEM, 0, new_item, "" }, "Added item: " + new_item);
     m_List.emplace_back(new_item);
     return true;
 }
@@ -133,29 +135,57 @@ void Shopping_List::edit() {
     } while (add_record());
 }
 
-void Shopping_List::save(std::ofstream & os) const {
-    os << "shopping list" << std::endl << std::endl;
+Note_State Shopping_List::capture() const {
+    Note_State state = Note::capture();
+    std::vector<std::pair<std::string, std::string>> items;
+    items.reserve(m_List.size());
+    for (const auto & x: m_List) {
+        items.emplace_back(x, "");
+    }
+    state.m_Items = Persistent_Vector<std::pair<std::string, std::string>>(items);
+    return state;
+}
+
+void Shopping_List::restore(const Note_State & state) {
+    Note::restore(state);
+    m_List.clear();
+    for (const auto & x: state.m_Items.to_vector()) {
+        m_List.push_back(x.first);
+    }
+}
+
+void Shopping_List::save(std::ostream & os) const {
+    os << m_TYPE << std::endl << std::endl;
     Note::save(os);
     for (const auto & x: m_List) {
         os << x << std::endl;
     }
 }
 
-void Shopping_List::print(std::ostream & os) const {
+void Shopping_List::write_record(Record_Writer & writer) const {
+    writer.string_field("type", m_TYPE);
+    Note::write_record(writer);
+    writer.list_field("items", m_List);
+}
+
+void Shopping_List::print(std::ostream & os, const Print_Limits & limits) const {
     os << "Shopping list ";
     if (m_Name.size()) {
         os << '"' << m_Name << "\" ";
     }
-    os << "created at: " << m_Changelog.front().first << std::endl;
-    size_t cnt = 1;
-    for (const auto & x: m_List) {
-        os << '\t' << cnt++ << ". " << x << std::endl;
+    os << "created at: " << m_Changelog.front().first << '\n';
+    const size_t cnt = limits.m_Items ? std::min(limits.m_Items, m_List.size()) : m_List.size();
+    for (size_t i = 0; i < cnt; i++) {
+        os << '\t' << i + 1 << ". " << m_List[i] << '\n';
+    }
+    if (cnt < m_List.size()) {
+        os << "\t... " << m_List.size() - cnt << " more items\n";
     }
 
-    Note::print(os);
+    Note::print(os, limits);
 }
 
-void Shopping_List::read(std::ifstream & os) {
+void Shopping_List::read(std::istream & os) {
     Note::read(os);
 
     for (;;) {
@@ -180,6 +210,10 @@ std::string Shopping_List::get_summary() const {
     return summary;
 }
 
+size_t Shopping_List::get_item_count() const {
+    return m_List.size();
+}
+
 bool Shopping_List::contains(const std::string & text) const {
     for (const auto & x: m_List) {
         if (x.find(text) != std::string::npos) {
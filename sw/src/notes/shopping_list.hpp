@@ -3,14 +3,16 @@
 
 #include <vector>
 #include <string>
+#include <cstddef>
 #include <fstream>
 #include <ostream>
+#include <istream>
 #include "note.hpp"
 
 /**
  * A note of type "shopping list"
  */
-class Shopping_List: public Note {
+class Shopping_List final: public Note {
     private:
         std::vector<std::string> m_List;
 
@@ -43,6 +45,9 @@ class Shopping_List: public Note {
         bool add_record();
 
     public:
+        // A name of the type in note files and exports
+        static constexpr const char * m_TYPE = "shopping list";
+
         explicit Shopping_List(const std::string & current_date);
 
         /**
@@ -53,14 +58,22 @@ class Shopping_List: public Note {
          */
         virtual void edit() override;
 
-        virtual void save(std::ofstream & os) const override;
+        virtual Note_State capture() const override;
+
+        virtual void restore(const Note_State & state) override;
+
+        virtual void save(std::ostream & os) const override;
 
-        virtual void print(std::ostream & os) const override;
+        virtual void write_record(Record_Writer & writer) const override;
 
-        virtual void read(std::ifstream & os) override;
+        virtual void print(std::ostream & os, const Print_Limits & limits = Print_Limits()) const override;
+
+        virtual void read(std::istream & os) override;
 
         virtual std::string get_summary() const override;
 
+        virtual size_t get_item_count() const override;
+
         virtual bool contains(const std::string & text) const override;
 
         virtual std::string get_content() const override;
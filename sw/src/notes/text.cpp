@@ -13,7 +13,6 @@ Text::Text(const std::string & current_date)
 void Text::edit() {
     Note::edit();
 
-    bool changed_text = false;
     for (;;) {
         std::cout << "Please enter a new text for the note:";
         if (m_Text.size()) {
@@ -34,35 +33,56 @@ void Text::edit() {
             }
         }
         else {
+            if (m_Text.size()) {
+                add_change({ Note_Op::Kind::SET_ITEM, 0, new_text, "" }, "Changed text: " + new_text);
+            }
+            else {
+                add_change({ Note_Op::Kind::ADD_ITEM, 0, new_text, "" }, "Changed text: " + new_text);
+            }
             m_Text = new_text;
-            changed_text = true;
             break;
         }
     }
-    if (changed_text) {
-        m_Changelog.emplace_back(get_timestamp(), "Changed text: " + m_Text);
-    }
     std::cout << std::endl;
 }
 
-void Text::save(std::ofstream & os) const {
-    os << "text" << std::endl << std::endl;
+Note_State Text::capture() const {
+    Note_State state = Note::capture();
+    if (m_Text.size()) {
+        state.m_Items = state.m_Items.push_back({ m_Text, "" });
+    }
+    return state;
+}
+
+void Text::restore(const Note_State & state) {
+    Note::restore(state);
+    m_Text = state.m_Items.empty() ? "" : state.m_Items.at(0).first;
+}
+
+void Text::save(std::ostream & os) const {
+    os << m_TYPE << std::endl << std::endl;
     Note::save(os);
     os << m_Text << std::endl;
 }
 
-void Text::print(std::ostream & os) const {
+void Text::write_record(Record_Writer & writer) const {
+    writer.string_field("type", m_TYPE);
+    Note::write_record(writer);
+    writer.string_field("text", m_Text);
+}
+
+void Text::print(std::ostream & os, const Print_Limits & limits) const {
     os << "Text note ";
     if (m_Name.size()) {
         os << '"' << m_Name << "\" ";
     }
-    os << "created at: " << m_Changelog.front().first << std::endl;
-    os << m_Text << std::endl;
+    os << "created at: " << m_Changelog.front().first << '\n';
+    os << m_Text << '\n';
 
-    Note::print(os);
+    Note::print(os, limits);
 }
 
-void Text::read(std::ifstream & os) {
+void Text::read(std::istream & os) {
     Note::read(os);
 
     std::getline(os, m_Text);
@@ -82,6 +102,10 @@ std::string Text::get_summary() const {
     return summary;
 }
 
+size_t Text::get_item_count() const {
+    return 0;
+}
+
 bool Text::contains(const std::string & text) const {
     return m_Text.find(text) != std::string::npos;
 }
@@ -57,10 +57,11 @@ void TODO_List::edit_record() {
     else if (!new_record.size()) {
         throw std::invalid_argument("TODO_List::edit_record(): Deadline can't be empty.");
     }
-    m_Changelog.emplace_back(get_timestamp(), "Changed task: " + m_List.at(record_num).first
-                                              + " with deadline: " + m_List.at(record_num).second
-                                              + " to: " + new_record
-                                              + " with deadline: " + new_deadline);
+    add_change({ Note_Op::Kind::SET_ITEM, record_num, new_record, new_deadline },
+               "Changed task: " + m_List.at(record_num).first
+               + " with deadline: " + m_List.at(record_num).second
+               + " to: " + new_record
+               + " with deadline: " + new_deadline);
     m_List.at(record_num) = std::make_pair(new_record, new_deadline);
 }
 
@@ -72,12 +73,13 @@ void TODO_List::delete_record() {
     }
     // Flushing stdin
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    if (!(--record_num << m_List.size())) {
+    if (!(--record_num < m_List.size())) {
         throw std::invalid_argument("TODO_List::delete_record(): Invalid record number.");
     }
 
-    m_Changelog.emplace_back(get_timestamp(), "Removed task: " + m_List.at(record_num).first
-                                              + " with deadline: " + m_List.at(record_num).second);
+    add_change({ Note_Op::Kind::ERASE_ITEM, record_num, "", "" },
+               "Removed task: " + m_List.at(record_num).first
+               + " with deadline: " + m_List.at(record_num).second);
     // Cast "tag_id" to long int to bypass "-Wsign-conversion"
     m_List.erase(m_List.begin() + record_num);
 }
@@ -111,11 +113,9 @@ bool TODO_List::add_record() {
             continue;
         }
 
+        add_change({ Note_Op::Kind::ADD_ITEM, 0, record_name, record_deadline },
+                   "Added new record: " + record_name + " with deadline: " + record_deadline);
         m_List.emplace_back(record_name, record_deadline);
-        m_Changelog.emplace_back(get_timestamp(), "Added new record: "
-                                                  + record_name
-                                                  + " with deadline: "
-                                                  + record_deadline);
         return true;
     }
 }
@@ -186,8 +186,19 @@ void TODO_List::edit() {
     std::cout << std::endl;
 }
 
-void TODO_List::save(std::ofstream & os) const {
-    os << "to-do list" << std::endl << std::endl;
+Note_State TODO_List::capture() const {
+    Note_State state = Note::capture();
+    state.m_Items = Persistent_Vector<std::pair<std::string, std::string>>(m_List);
+    return state;
+}
+
+void TODO_List::restore(const Note_State & state) {
+    Note::restore(state);
+    m_List = state.m_Items.to_vector();
+}
+
+void TODO_List::save(std::ostream & os) const {
+    os << m_TYPE << std::endl << std::endl;
     Note::save(os);
     for (const auto & x: m_List) {
         os << x.first << std::endl
@@ -195,22 +206,31 @@ void TODO_List::save(std::ofstream & os) const {
     }
 }
 
-void TODO_List::print(std::ostream & os) const {
+void TODO_List::write_record(Record_Writer & writer) const {
+    writer.string_field("type", m_TYPE);
+    Note::write_record(writer);
+    writer.pair_fields("items", "deadlines", m_List);
+}
+
+void TODO_List::print(std::ostream & os, const Print_Limits & limits) const {
     os << "To-do list ";
     if (m_Name.size()) {
         os << '"' << m_Name << "\" ";
     }
-    os << "created at: " << m_Changelog.front().first << std::endl;
-    size_t cnt = 1;
-    for (const auto & x: m_List) {
-        os << '\t' << cnt++ << ". " << x.first << std::endl
-           << "\t\t" << x.second << std::endl;
+    os << "created at: " << m_Changelog.front().first << '\n';
+    const size_t cnt = limits.m_Items ? std::min(limits.m_Items, m_List.size()) : m_List.size();
+    for (size_t i = 0; i < cnt; i++) {
+        os << '\t' << i + 1 << ". " << m_List[i].first << '\n'
+           << "\t\t" << m_List[i].second << '\n';
+    }
+    if (cnt < m_List.size()) {
+        os << "\t... " << m_List.size() - cnt << " more tasks\n";
     }
 
-    Note::print(os);
+    Note::print(os, limits);
 }
 
-void TODO_List::read(std::ifstream & os) {
+void TODO_List::read(std::istream & os) {
     Note::read(os);
 
     const std::string corrupted = "TODO_List::read(): File is corrupted.",
@@ -257,6 +277,10 @@ std::string TODO_List::get_summary() const {
     return summary;
 }
 
+size_t TODO_List::get_item_count() const {
+    return m_List.size();
+}
+
 bool TODO_List::contains(const std::string & text) const {
     for (const auto & x: m_List) {
         if (x.first.find(text) != std::string::npos) {
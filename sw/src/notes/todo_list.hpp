@@ -4,14 +4,16 @@
 #include <vector>
 #include <utility>
 #include <string>
+#include <cstddef>
 #include <fstream>
 #include <ostream>
+#include <istream>
 #include "note.hpp"
 
 /**
  * A note of type "to-do list"
  */
-class TODO_List: public Note {
+class TODO_List final: public Note {
     private:
         std::vector<std::pair<std::string, std::string>> m_List;
 
@@ -53,6 +55,9 @@ class TODO_List: public Note {
         bool add_record();
 
     public:
+        // A name of the type in note files and exports
+        static constexpr const char * m_TYPE = "to-do list";
+
         explicit TODO_List(const std::string & current_date);
 
         /**
@@ -63,14 +68,22 @@ class TODO_List: public Note {
          */
         virtual void edit() override;
 
-        virtual void save(std::ofstream & os) const override;
+        virtual Note_State capture() const override;
+
+        virtual void restore(const Note_State & state) override;
+
+        virtual void save(std::ostream & os) const override;
 
-        virtual void print(std::ostream & os) const override;
+        virtual void write_record(Record_Writer & writer) const override;
 
-        virtual void read(std::ifstream & os) override;
+        virtual void print(std::ostream & os, const Print_Limits & limits = Print_Limits()) const override;
+
+        virtual void read(std::istream & os) override;
 
         virtual std::string get_summary() const override;
 
+        virtual size_t get_item_count() const override;
+
         virtual bool contains(const std::string & text) const override;
 
         virtual std::string get_content() const override;
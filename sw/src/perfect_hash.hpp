@@ -0,0 +1,87 @@
+#ifndef PERFECT_HASH_HPP
+#define PERFECT_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <string_view>
+
+/**
+ * A hash table of constant keys, built at compile time.
+ *
+ * The constructor searches for a seed, with which no two keys share
+ * a slot, so a lookup hashes the key and compares it with at most one key.
+ *
+ * @tparam N     A number of the keys.
+ * @tparam SLOTS A number of slots (more slots, faster to find a seed).
+ */
+template <size_t N, size_t SLOTS>
+class Perfect_Hash {
+    private:
+        static_assert(N < SLOTS && N < UINT8_MAX, "Perfect_Hash: Too many keys.");
+
+        std::array<std::string_view, N> m_Keys;
+        // Indices of the keys plus one, 0 in empty slots
+        std::array<uint8_t, SLOTS> m_Slots {};
+        uint32_t m_Seed = 0;
+
+        /**
+         * FNV-1a of a key, mixed with a seed.
+         */
+        static constexpr uint32_t hash(const std::string_view key, const uint32_t seed) {
+            uint32_t h = 2166136261u ^ seed;
+            for (const char c: key) {
+                h ^= static_cast<unsigned char>(c);
+                h *= 16777619u;
+            }
+            return h ^ (h >> 15);
+        }
+
+        /**
+         * Place the keys into the slots with a seed.
+         *
+         * @return true, if no keys collided;
+         *      false otherwise.
+         */
+        constexpr bool place(const uint32_t seed) {
+            for (auto & x: m_Slots) {
+                x = 0;
+            }
+            for (size_t i = 0; i < N; i++) {
+                uint8_t & slot = m_Slots[hash(m_Keys[i], seed) % SLOTS];
+                if (slot) {
+                    return false;
+                }
+                slot = static_cast<uint8_t>(i + 1);
+            }
+            return true;
+        }
+
+    public:
+        /**
+         * Build the table (keys must be unique, otherwise it doesn't compile
+         * in a constant expression).
+         *
+         * @param keys The keys.
+         */
+        constexpr explicit Perfect_Hash(const std::array<std::string_view, N> & keys)
+            : m_Keys(keys) {
+            while (!place(m_Seed)) {
+                m_Seed++;
+            }
+        }
+
+        /**
+         * Find a key.
+         *
+         * @param  key A key.
+         * @return An index of the key (in the constructor's array),
+         *         N if it isn't a key.
+         */
+        constexpr size_t find(const std::string_view key) const {
+            const uint8_t slot = m_Slots[hash(key, m_Seed) % SLOTS];
+            return slot && m_Keys[slot - 1u] == key ? slot - 1u : N;
+        }
+};
+
+#endif  // PERFECT_HASH_HPP
@@ -0,0 +1,188 @@
+#ifndef PERSISTENT_VECTOR_HPP
+#define PERSISTENT_VECTOR_HPP
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * An immutable vector, which shares unchanged parts with it's other
+ * versions.
+ *
+ * Elements are kept in chunks of at most "m_CHUNK_SIZE" elements and the
+ * list of chunks (the spine) is shared as well. Copying the vector copies
+ * one pointer, a change copies only the spine and the changed chunk,
+ * so many versions of a list take little more memory than one of them.
+ */
+template <typename T>
+class Persistent_Vector {
+    private:
+        static constexpr size_t m_CHUNK_SIZE = 32;
+
+        using Chunk = std::vector<T>;
+
+        /**
+         * A chunk and a number of elements up to the end of it.
+         */
+        struct Spine_Entry {
+            size_t m_End;
+            std::shared_ptr<const Chunk> m_Chunk;
+        };
+
+        using Spine = std::vector<Spine_Entry>;
+
+        std::shared_ptr<const Spine> m_Spine;
+
+        /**
+         * Find a chunk with an element.
+         *
+         * Throws std::out_of_range if the element doesn't exist.
+         *
+         * @param  index An index of the element.
+         * @return An index of the chunk and of the element in it.
+         */
+        std::pair<size_t, size_t> locate(const size_t index) const {
+            if (index >= size()) {
+                throw std::out_of_range("Persistent_Vector::locate(): Index out of range.");
+            }
+            auto it = std::upper_bound(m_Spine->begin(), m_Spine->end(), index,
+                                       [](const size_t x, const Spine_Entry & entry) { return x < entry.m_End; });
+            const size_t chunk = static_cast<size_t>(it - m_Spine->begin());
+            return { chunk, index - (it->m_End - it->m_Chunk->size()) };
+        }
+
+        explicit Persistent_Vector(Spine && spine)
+            : m_Spine(spine.empty() ? nullptr : std::make_shared<const Spine>(std::move(spine))) { }
+
+        Spine copy_spine() const {
+            return m_Spine ? *m_Spine : Spine();
+        }
+
+    public:
+        Persistent_Vector() = default;
+
+        explicit Persistent_Vector(const std::vector<T> & values) {
+            Spine spine;
+            for (size_t begin = 0; begin < values.size(); begin += m_CHUNK_SIZE) {
+                const size_t end = std::min(begin + m_CHUNK_SIZE, values.size());
+                spine.push_back({ end, std::make_shared<const Chunk>(values.begin() + static_cast<std::ptrdiff_t>(begin),
+                                                                     values.begin() + static_cast<std::ptrdiff_t>(end)) });
+            }
+            if (!spine.empty()) {
+                m_Spine = std::make_shared<const Spine>(std::move(spine));
+            }
+        }
+
+        size_t size() const {
+            return m_Spine ? m_Spine->back().m_End : 0;
+        }
+
+        bool empty() const {
+            return !size();
+        }
+
+        /**
+         * Get an element.
+         *
+         * Throws std::out_of_range if it doesn't exist.
+         */
+        const T & at(const size_t index) const {
+            const std::pair<size_t, size_t> position = locate(index);
+            return (*m_Spine->at(position.first).m_Chunk)[position.second];
+        }
+
+        /**
+         * Get a version with a changed element.
+         *
+         * Throws std::out_of_range if it doesn't exist.
+         */
+        Persistent_Vector set(const size_t index, T value) const {
+            const std::pair<size_t, size_t> position = locate(index);
+            Spine spine = copy_spine();
+            Chunk chunk = *spine.at(position.first).m_Chunk;
+            chunk[position.second] = std::move(value);
+            spine.at(position.first).m_Chunk = std::make_shared<const Chunk>(std::move(chunk));
+            return Persistent_Vector(std::move(spine));
+        }
+
+        /**
+         * Get a version with an element added to the end.
+         */
+        Persistent_Vector push_back(T value) const {
+            Spine spine = copy_spine();
+            if (spine.empty() || spine.back().m_Chunk->size() >= m_CHUNK_SIZE) {
+                spine.push_back({ size() + 1, std::make_shared<const Chunk>(1, std::move(value)) });
+            }
+            else {
+                Chunk chunk = *spine.back().m_Chunk;
+                chunk.push_back(std::move(value));
+                spine.back() = { size() + 1, std::make_shared<const Chunk>(std::move(chunk)) };
+            }
+            return Persistent_Vector(std::move(spine));
+        }
+
+        /**
+         * Get a version without an element.
+         *
+         * Throws std::out_of_range if it doesn't exist.
+         */
+        Persistent_Vector erase(const size_t index) const {
+            const std::pair<size_t, size_t> position = locate(index);
+            Spine spine = copy_spine();
+            Chunk chunk = *spine.at(position.first).m_Chunk;
+            chunk.erase(chunk.begin() + static_cast<std::ptrdiff_t>(position.second));
+            const auto it = spine.begin() + static_cast<std::ptrdiff_t>(position.first);
+            // Following chunks are shared, only their offsets change
+            for (auto x = it; x != spine.end(); ++x) {
+                x->m_End--;
+            }
+            if (chunk.empty()) {
+                spine.erase(it);
+            }
+            else {
+                it->m_Chunk = std::make_shared<const Chunk>(std::move(chunk));
+            }
+            return Persistent_Vector(std::move(spine));
+        }
+
+        std::vector<T> to_vector() const {
+            std::vector<T> values;
+            values.reserve(size());
+            if (m_Spine) {
+                for (const auto & x: *m_Spine) {
+                    values.insert(values.end(), x.m_Chunk->begin(), x.m_Chunk->end());
+                }
+            }
+            return values;
+        }
+
+        /**
+         * Compare elements (shared chunks aren't compared at all).
+         */
+        bool operator == (const Persistent_Vector & other) const {
+            if (m_Spine == other.m_Spine) {
+                return true;
+            }
+            else if (size() != other.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < m_Spine->size(); i++) {
+                if (i < other.m_Spine->size() && m_Spine->at(i).m_Chunk == other.m_Spine->at(i).m_Chunk
+                    && m_Spine->at(i).m_End == other.m_Spine->at(i).m_End) {
+                    continue;
+                }
+                const size_t begin = m_Spine->at(i).m_End - m_Spine->at(i).m_Chunk->size();
+                for (size_t j = begin; j < m_Spine->at(i).m_End; j++) {
+                    if (!(at(j) == other.at(j))) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+};
+
+#endif  // PERSISTENT_VECTOR_HPP
@@ -0,0 +1,129 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include "result_order.hpp"
+#include "notes/note.hpp"
+
+Result_Order::Result_Order(const Sort_Key key, const bool descending, const size_t limit)
+    : m_Key(key), m_Descending(descending), m_Limit(limit) { }
+
+bool Result_Order::before(const std::pair<std::string, std::unique_ptr<Note>> & a,
+                          const std::pair<std::string, std::unique_ptr<Note>> & b) const {
+    int cmp = 0;
+    switch (m_Key) {
+        case Sort_Key::NONE:
+            break;
+        // Dates are compared by their fields, without formatting them
+        case Sort_Key::CREATION_DATE:
+            cmp = a.second->get_creation_date().compare(b.second->get_creation_date());
+            break;
+        case Sort_Key::LAST_CHANGE:
+            cmp = a.second->get_last_change_date().compare(b.second->get_last_change_date());
+            break;
+        case Sort_Key::NAME:
+            cmp = a.second->get_name().compare(b.second->get_name());
+            break;
+        case Sort_Key::ITEMS:
+            cmp = a.second->get_item_count() < b.second->get_item_count() ? -1
+                  : a.second->get_item_count() > b.second->get_item_count();
+            break;
+    }
+    if (!cmp) {
+        // Paths are unique, so the order is always the same
+        cmp = a.first.compare(b.first);
+        return cmp < 0;
+    }
+    return m_Descending ? cmp > 0 : cmp < 0;
+}
+
+void Result_Order::request_order() {
+    std::cout << "Enter by what to sort the results:" << std::endl
+              << "\t\"Creation Date\" (\"cd\");" << std::endl
+              << "\t\"Last Change\" (\"lc\");" << std::endl
+              << "\t\"Name\" ('n');" << std::endl
+              << "\t\"Items\" ('i') for amount of items;" << std::endl
+              << "Enter empty line to keep the results unsorted." << std::endl
+              << '\t';
+    std::string answer;
+    std::getline(std::cin, answer);
+    if (!std::cin.good()) {
+        throw std::runtime_error("Result_Order::request_order(): Couldn't read a sort key.");
+    }
+    std::transform(answer.begin(), answer.end(),
+                   answer.begin(), ::tolower);
+    if (!answer.size()) {
+        m_Key = Sort_Key::NONE;
+    }
+    else if (!answer.compare("creation date") || !answer.compare("cd")) {
+        m_Key = Sort_Key::CREATION_DATE;
+    }
+    else if (!answer.compare("last change") || !answer.compare("lc")) {
+        m_Key = Sort_Key::LAST_CHANGE;
+    }
+    else if (!answer.compare("name") || !answer.compare("n")) {
+        m_Key = Sort_Key::NAME;
+    }
+    else if (!answer.compare("items") || !answer.compare("i")) {
+        m_Key = Sort_Key::ITEMS;
+    }
+    else {
+        throw std::invalid_argument("Result_Order::request_order(): Invalid sort key.");
+    }
+
+    if (m_Key != Sort_Key::NONE) {
+        std::cout << std::endl
+                  << "Enter \"yes\" ('y'), if the results should be in descending order" << std::endl
+                  << "(newest, the most items or Z first)." << std::endl
+                  << '\t';
+        std::getline(std::cin, answer);
+        if (!std::cin.good()) {
+            throw std::runtime_error("Result_Order::request_order(): Couldn't read an answer.");
+        }
+        m_Descending = !answer.compare("yes") || !answer.compare("y");
+    }
+
+    std::cout << std::endl
+              << "Enter how many results to keep (empty line to keep all):" << std::endl
+              << '\t';
+    std::getline(std::cin, answer);
+    if (!std::cin.good()) {
+        throw std::runtime_error("Result_Order::request_order(): Couldn't read a limit.");
+    }
+    m_Limit = 0;
+    if (answer.size()) {
+        const std::string invalid = "Result_Order::request_order(): Limit must be a positive number.";
+        if (answer.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::invalid_argument(invalid);
+        }
+        try {
+            m_Limit = std::stoul(answer);
+        }
+        catch (const std::out_of_range &) {
+            throw std::invalid_argument(invalid);
+        }
+        if (!m_Limit) {
+            throw std::invalid_argument(invalid);
+        }
+    }
+}
+
+void Result_Order::apply(std::vector<std::pair<std::string, std::unique_ptr<Note>>> & results) const {
+    auto cmp = [this](const auto & a, const auto & b) { return before(a, b); };
+    const bool limited = m_Limit && m_Limit < results.size();
+    if (m_Key != Sort_Key::NONE) {
+        if (limited) {
+            std::partial_sort(results.begin(), results.begin() + m_Limit, results.end(), cmp);
+        }
+        else {
+            std::sort(results.begin(), results.end(), cmp);
+        }
+    }
+    if (limited) {
+        results.erase(results.begin() + m_Limit, results.end());
+    }
+}
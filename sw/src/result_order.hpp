@@ -0,0 +1,56 @@
+#ifndef RESULT_ORDER_HPP
+#define RESULT_ORDER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <memory>
+#include "notes/note.hpp"
+
+/**
+ * Sorting and limiting of search results (e.g. "newest 20 notes").
+ */
+class Result_Order {
+    public:
+        enum class Sort_Key { NONE, CREATION_DATE, LAST_CHANGE, NAME, ITEMS };
+
+    private:
+        Sort_Key m_Key = Sort_Key::NONE;
+        bool m_Descending = false;
+        // 0 means no limit.
+        size_t m_Limit = 0;
+
+        /**
+         * Compare two results by "m_Key" in "m_Descending" order.
+         *
+         * @return true, if "a" goes before "b";
+         *      false otherwise.
+         */
+        bool before(const std::pair<std::string, std::unique_ptr<Note>> & a,
+                    const std::pair<std::string, std::unique_ptr<Note>> & b) const;
+
+    public:
+        Result_Order() = default;
+        Result_Order(const Sort_Key key, const bool descending, const size_t limit);
+
+        /**
+         * Ask the user by what to sort the results and how many to keep.
+         *
+         * Throws std::runtime_error if got problem in stdin
+         * or std::invalid_argument if got invalid input.
+         */
+        void request_order();
+
+        /**
+         * Sort the results and keep only the first "m_Limit" of them.
+         *
+         * With a limit, only the kept results are sorted (heap-based
+         * partial sort), so it takes O(n log k) instead of O(n log n).
+         *
+         * @param results Results to sort.
+         */
+        void apply(std::vector<std::pair<std::string, std::unique_ptr<Note>>> & results) const;
+};
+
+#endif  // RESULT_ORDER_HPP
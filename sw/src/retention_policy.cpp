@@ -0,0 +1,118 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <istream>
+#include <ostream>
+#include <ctime>
+#include "retention_policy.hpp"
+#include "timestamp.hpp"
+
+const std::vector<std::string> Retention_Policy::m_SQUASHABLE = {
+    "Changed name: ",
+    "Changed text: "
+};
+
+Retention_Policy::Retention_Policy(const size_t max_entries, const unsigned max_age_days,
+                                   const bool squash, const bool archive)
+    : m_Max_Entries(max_entries), m_Max_Age_Days(max_age_days),
+      m_Squash(squash), m_Archive(archive) { }
+
+size_t Retention_Policy::get_field(const std::string & change) {
+    for (size_t i = 0; i < m_SQUASHABLE.size(); i++) {
+        if (!change.compare(0, m_SQUASHABLE[i].size(), m_SQUASHABLE[i])) {
+            return i;
+        }
+    }
+    return m_SQUASHABLE.size();
+}
+
+bool Retention_Policy::enabled() const {
+    return m_Max_Entries || m_Max_Age_Days || m_Squash;
+}
+
+bool Retention_Policy::archive() const {
+    return m_Archive;
+}
+
+std::vector<std::pair<Timestamp, std::string>> Retention_Policy::apply(
+    std::vector<std::pair<Timestamp, std::string>> & changelog,
+    const std::time_t now) const {
+    // The first entry is never trimmed
+    std::vector<bool> keep(changelog.size(), true);
+    if (m_Squash) {
+        for (size_t i = 1; i + 1 < changelog.size(); i++) {
+            const size_t field = get_field(changelog[i].second);
+            if (field < m_SQUASHABLE.size() && field == get_field(changelog[i + 1].second)) {
+                keep[i] = false;
+            }
+        }
+    }
+    if (m_Max_Age_Days) {
+        const Timestamp oldest(now - static_cast<std::time_t>(m_Max_Age_Days) * 24 * 60 * 60);
+        for (size_t i = 1; i < changelog.size(); i++) {
+            if (changelog[i].first.compare(oldest) < 0) {
+                keep[i] = false;
+            }
+        }
+    }
+    if (m_Max_Entries) {
+        // The newest entries are kept, the first one is counted as well
+        size_t kept = 1;
+        for (size_t i = changelog.size(); i-- > 1;) {
+            if (keep[i] && kept++ >= m_Max_Entries) {
+                keep[i] = false;
+            }
+        }
+    }
+
+    std::vector<std::pair<Timestamp, std::string>> trimmed;
+    size_t cnt = 0;
+    for (size_t i = 0; i < changelog.size(); i++) {
+        if (!keep[i]) {
+            trimmed.push_back(std::move(changelog[i]));
+        }
+        else if (cnt++ != i) {
+            changelog[cnt - 1] = std::move(changelog[i]);
+        }
+    }
+    changelog.resize(cnt);
+    return trimmed;
+}
+
+void Retention_Policy::save(std::ostream & os) const {
+    os << m_Max_Entries << ' ' << m_Max_Age_Days << ' '
+       << m_Squash << ' ' << m_Archive << std::endl;
+}
+
+bool Retention_Policy::load(std::istream & is) {
+    size_t max_entries;
+    unsigned max_age_days;
+    bool squash, archive;
+    if (!(is >> max_entries >> max_age_days >> squash >> archive)) {
+        return false;
+    }
+    *this = Retention_Policy(max_entries, max_age_days, squash, archive);
+    return true;
+}
+
+std::ostream & operator << (std::ostream & os, const Retention_Policy & policy) {
+    if (!policy.enabled()) {
+        return os << "keep all changes";
+    }
+    os << "keep ";
+    if (policy.m_Max_Entries) {
+        os << "at most " << policy.m_Max_Entries << ' ';
+    }
+    os << "changes";
+    if (policy.m_Max_Age_Days) {
+        os << " newer than " << policy.m_Max_Age_Days << " days";
+    }
+    if (policy.m_Squash) {
+        os << ", squash consecutive changes of names and texts";
+    }
+    if (policy.m_Archive) {
+        os << ", archive trimmed changes";
+    }
+    return os;
+}
@@ -0,0 +1,93 @@
+#ifndef RETENTION_POLICY_HPP
+#define RETENTION_POLICY_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <istream>
+#include <ostream>
+#include <ctime>
+#include "timestamp.hpp"
+
+/**
+ * Rules which changelog entries of a note are worth keeping.
+ *
+ * The first entry (creation of the note) is always kept, as it holds
+ * the creation date. Entries are trimmed by squashing, then by age
+ * and then by count.
+ */
+class Retention_Policy {
+    private:
+        // Changes which overwrite a whole field, so only the last one
+        // of consecutive changes matters.
+        static const std::vector<std::string> m_SQUASHABLE;
+
+        // At most this many entries are kept (0 for unlimited).
+        size_t m_Max_Entries = 0;
+        // Entries older than this many days are trimmed (0 for unlimited).
+        unsigned m_Max_Age_Days = 0;
+        // Whether or not to squash consecutive changes of the same field.
+        bool m_Squash = false;
+        // Whether or not to archive trimmed entries to a history file.
+        bool m_Archive = false;
+
+        /**
+         * Get a field overwritten by a change.
+         *
+         * @param  change A change.
+         * @return An index to "m_SQUASHABLE" or "m_SQUASHABLE.size()",
+         *         if the change isn't squashable.
+         */
+        static size_t get_field(const std::string & change);
+
+    public:
+        Retention_Policy() = default;
+        Retention_Policy(const size_t max_entries, const unsigned max_age_days,
+                         const bool squash, const bool archive);
+
+        /**
+         * Check whether or not the policy trims anything.
+         *
+         * @return true, if it does;
+         *      false if all entries are kept.
+         */
+        bool enabled() const;
+
+        bool archive() const;
+
+        /**
+         * Trim a changelog.
+         *
+         * @param  changelog A changelog to trim (oldest entry first).
+         * @param  now       Current time, ages are counted from it.
+         * @return Trimmed entries (oldest first).
+         */
+        std::vector<std::pair<Timestamp, std::string>> apply(
+            std::vector<std::pair<Timestamp, std::string>> & changelog,
+            const std::time_t now) const;
+
+        /**
+         * Save the policy as "<max entries> <max age in days> <squash (0/1)>
+         * <archive (0/1)>".
+         *
+         * @param os A stream where to save the policy.
+         */
+        void save(std::ostream & os) const;
+
+        /**
+         * Load the policy saved by save().
+         *
+         * @param  is A stream with the policy.
+         * @return true, if the policy was loaded;
+         *      false otherwise (the policy is unchanged).
+         */
+        bool load(std::istream & is);
+
+        /**
+         * Print the policy in a human-readable form.
+         */
+        friend std::ostream & operator << (std::ostream & os, const Retention_Policy & policy);
+};
+
+#endif  // RETENTION_POLICY_HPP
@@ -0,0 +1,55 @@
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "note_client.hpp"
+#include "protocol.hpp"
+
+Note_Client::Note_Client(const std::string & socket_path) {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Note_Client::Note_Client(): Socket path is too long.");
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    m_Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_Fd < 0) {
+        throw std::runtime_error("Note_Client::Note_Client(): Couldn't create a socket.");
+    }
+    if (connect(m_Fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))) {
+        close(m_Fd);
+        throw std::runtime_error("Note_Client::Note_Client(): Couldn't connect to the server.");
+    }
+}
+
+Note_Client::~Note_Client() {
+    close(m_Fd);
+}
+
+std::string Note_Client::request(const std::vector<std::string> & command,
+                                 const std::string & body) {
+    std::string payload;
+    for (const auto & x: command) {
+        payload.append(x + '\n');
+    }
+    if (body.size()) {
+        payload.append('\n' + body);
+    }
+    protocol::send_frame(m_Fd, payload);
+
+    std::string response;
+    if (!protocol::receive_frame(m_Fd, response)) {
+        throw std::runtime_error("Note_Client::request(): Server closed the connection.");
+    }
+    size_t status_end = response.find('\n');
+    const std::string status = response.substr(0, status_end);
+    if (status != "OK") {
+        throw std::runtime_error(status.substr(status.find(' ') + 1));
+    }
+    return status_end == std::string::npos ? "" : response.substr(status_end + 1);
+}
@@ -0,0 +1,42 @@
+#ifndef NOTE_CLIENT_HPP
+#define NOTE_CLIENT_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * A thin client of Note_Server.
+ */
+class Note_Client {
+    private:
+        int m_Fd;
+
+    public:
+        /**
+         * Connect to a running Note_Server.
+         *
+         * Throws std::runtime_error if couldn't connect.
+         *
+         * @param socket_path A path to the server's socket.
+         */
+        explicit Note_Client(const std::string & socket_path);
+        ~Note_Client();
+
+        Note_Client(const Note_Client &) = delete;
+        Note_Client & operator = (const Note_Client &) = delete;
+
+        /**
+         * Send a request and wait for the response.
+         *
+         * Throws std::runtime_error if got communication error
+         * or if the server failed to process the request.
+         *
+         * @param  command A command and it's arguments.
+         * @param  body    A body of the request (e.g. a note to create).
+         * @return A response body.
+         */
+        std::string request(const std::vector<std::string> & command,
+                            const std::string & body = "");
+};
+
+#endif  // NOTE_CLIENT_HPP
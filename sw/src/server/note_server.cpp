@@ -0,0 +1,284 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "note_server.hpp"
+#include "protocol.hpp"
+#include "../note_storage.hpp"
+#include "../notes/note.hpp"
+#include "../exports/export.hpp"
+#include "../exports/markdown_export.hpp"
+#include "../note_sync.hpp"
+#include "../content_hash.hpp"
+
+size_t Note_Server::Snapshot::find(const std::string & path) const {
+    auto it = m_Index.find(path);
+    if (it == m_Index.end()) {
+        throw std::invalid_argument("Note_Server::process(): No such note.");
+    }
+    return it->second;
+}
+
+void Note_Server::Snapshot::reindex() {
+    m_Index.clear();
+    for (size_t i = 0; i < m_Notes.size(); i++) {
+        m_Index.emplace(m_Notes[i].first, i);
+    }
+}
+
+Note_Server::Note_Server(Note_Storage & notes_store, const std::string & socket_path)
+    : m_Notes_Store(notes_store), m_SOCKET_PATH(socket_path) { }
+
+void Note_Server::reload() {
+    auto snapshot = std::make_shared<Snapshot>();
+    for (auto & x: m_Notes_Store.read_recursively("")) {
+        snapshot->m_Notes.emplace_back(x.first, std::move(x.second));
+    }
+    snapshot->reindex();
+    std::atomic_store(&m_Snapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+}
+
+void Note_Server::run() {
+    reload();
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (m_SOCKET_PATH.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Note_Server::run(): Socket path is too long.");
+    }
+    std::strcpy(address.sun_path, m_SOCKET_PATH.c_str());
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        throw std::runtime_error("Note_Server::run(): Couldn't create a socket.");
+    }
+    // A stale socket might be left by a previous server
+    unlink(m_SOCKET_PATH.c_str());
+    if (bind(server_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address))
+        || listen(server_fd, SOMAXCONN)) {
+        close(server_fd);
+        throw std::runtime_error("Note_Server::run(): Couldn't listen on the socket.");
+    }
+    std::cout << "INFO: Serving " << std::atomic_load(&m_Snapshot)->m_Notes.size()
+              << " notes at " << m_SOCKET_PATH << std::endl;
+
+    for (;;) {
+        {
+            // Other clients wait in the listen queue
+            std::unique_lock<std::mutex> lock(m_Clients_Mutex);
+            m_Client_Left.wait(lock, [this]() { return m_Clients < m_MAX_CLIENTS; });
+        }
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO) {
+                continue;
+            }
+            else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Out of resources for now, clients leaving free them
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            close(server_fd);
+            // Clients use the server, so it can't go away before them
+            std::unique_lock<std::mutex> lock(m_Clients_Mutex);
+            m_Client_Left.wait(lock, [this]() { return !m_Clients; });
+            throw std::runtime_error("Note_Server::run(): Couldn't accept a client.");
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_Clients_Mutex);
+            m_Clients++;
+        }
+        std::thread([this, client_fd]() {
+            serve_client(client_fd);
+            std::lock_guard<std::mutex> lock(m_Clients_Mutex);
+            m_Clients--;
+            m_Client_Left.notify_all();
+        }).detach();
+    }
+}
+
+void Note_Server::serve_client(const int fd) {
+    try {
+        std::string request;
+        while (protocol::receive_frame(fd, request)) {
+            std::string response;
+            try {
+                response = "OK\n" + process(request);
+            }
+            catch (const std::exception & e) {
+                response = std::string("ERROR ") + e.what() + '\n';
+            }
+            protocol::send_frame(fd, response);
+        }
+    }
+    catch (const std::runtime_error & e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+    }
+    close(fd);
+}
+
+std::string Note_Server::process(const std::string & request) {
+    std::string body;
+    const std::vector<std::string> command = protocol::split_request(request, body);
+    if (command.empty()) {
+        throw std::invalid_argument("Note_Server::process(): Empty request.");
+    }
+
+    const std::string & action = command.front();
+    // Create has to be served by a writer, everything else is a read
+    if (action == "create" && command.size() == 2) {
+        return create(command.at(1), body);
+    }
+    else if (action == "put" && command.size() == 2) {
+        const std::string & path = command.at(1);
+        const size_t last_slash = path.find_last_of('/');
+        return create(path.substr(0, last_slash == std::string::npos ? 0 : last_slash), body,
+                      path.substr(last_slash + 1));
+    }
+    else if (action == "remove" && command.size() == 2) {
+        remove(command.at(1));
+        return "";
+    }
+    else if (action == "reload" && command.size() == 1) {
+        std::lock_guard<std::mutex> lock(m_Write_Mutex);
+        reload();
+        return "";
+    }
+
+    const std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&m_Snapshot);
+    std::ostringstream out;
+    if (action == "list" && command.size() == 1) {
+        for (const auto & x: snapshot->m_Notes) {
+            out << x.first << '\n'
+                << x.second->get_summary() << "\n\n";
+        }
+    }
+    else if (action == "read" && command.size() == 2) {
+        snapshot->m_Notes.at(snapshot->find(command.at(1))).second->print(out);
+    }
+    else if (action == "manifest") {
+        Sync_Manifest manifest;
+        for (const auto & x: snapshot->m_Notes) {
+            // Same notes as in manifests of local storages
+            if (!x.first.compare(x.first.find_last_of('/') + 1, std::string::npos, x.second->get_file_name())) {
+                manifest.add(x.first, *x.second);
+            }
+        }
+        if (command.size() == 1) {
+            for (const uint64_t x: manifest.get_summary()) {
+                out << hash_to_hex(x) << '\n';
+            }
+        }
+        else {
+            std::vector<size_t> buckets;
+            for (size_t i = 1; i < command.size(); i++) {
+                buckets.push_back(std::stoul(command.at(i)));
+                if (buckets.back() >= Sync_Manifest::m_BUCKETS) {
+                    throw std::invalid_argument("Note_Server::process(): Invalid bucket.");
+                }
+            }
+            out << manifest.write_buckets(buckets);
+        }
+    }
+    else if (action == "get" && command.size() == 2) {
+        snapshot->m_Notes.at(snapshot->find(command.at(1))).second->save(out);
+    }
+    else if (action == "search" && command.size() == 2) {
+        const std::string & text = command.at(1);
+        for (const auto & x: snapshot->m_Notes) {
+            if (x.second->get_name().find(text) != std::string::npos
+                || x.second->contains(text)) {
+                out << x.first << '\n'
+                    << x.second->get_summary() << "\n\n";
+            }
+        }
+    }
+    else if (action == "export" && (command.size() == 3 || command.size() == 4)) {
+        // Exporting doesn't change the storage, but it needs a note
+        // owned by Export's interface, so it gets a copy of the resident one
+        std::stringstream copy;
+        snapshot->m_Notes.at(snapshot->find(command.at(1))).second->save(copy);
+        std::unique_ptr<Note> to_export = m_Notes_Store.parse(copy);
+        if (command.size() == 4 && command.at(3) == "markdown") {
+            std::unique_ptr<Export> format = std::make_unique<Markdown_Export>(command.at(2));
+            m_Notes_Store.export_note_standard_format(format, to_export);
+        }
+        else if (command.size() == 3) {
+            m_Notes_Store.export_note(command.at(2), to_export);
+        }
+        else {
+            throw std::invalid_argument("Note_Server::process(): Invalid export format.");
+        }
+    }
+    else {
+        throw std::invalid_argument("Note_Server::process(): Invalid request.");
+    }
+    return out.str();
+}
+
+std::string Note_Server::create(std::string dir, const std::string & body,
+                                const std::string & file_name) {
+    if (dir.find('.') != std::string::npos) {
+        throw std::invalid_argument("Note_Server::create(): Used forbidden character in directory.");
+    }
+    std::istringstream is(body);
+    std::shared_ptr<Note> note = m_Notes_Store.parse(is);
+    if (file_name.size() && file_name != note->get_file_name()) {
+        throw std::invalid_argument("Note_Server::create(): Note doesn't match it's file name.");
+    }
+
+    std::lock_guard<std::mutex> lock(m_Write_Mutex);
+    // The changelog is trimmed on save, so the snapshot gets the saved note;
+    // notes put by a synchronization are stored verbatim
+    m_Notes_Store.update(*note, dir, file_name.empty());
+    const std::string path = dir + note->get_file_name();
+
+    // Readers holding the old snapshot keep using it, new ones get a copy
+    // with the new note (notes themselves are shared, not copied)
+    auto snapshot = std::make_shared<Snapshot>(*std::atomic_load(&m_Snapshot));
+    auto it = snapshot->m_Index.find(path);
+    if (it != snapshot->m_Index.end()) {
+        snapshot->m_Notes.at(it->second).second = note;
+    }
+    else {
+        snapshot->m_Index.emplace(path, snapshot->m_Notes.size());
+        snapshot->m_Notes.emplace_back(path, note);
+    }
+    std::atomic_store(&m_Snapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+    return path + '\n';
+}
+
+void Note_Server::remove(const std::string & path) {
+    std::lock_guard<std::mutex> lock(m_Write_Mutex);
+    auto snapshot = std::make_shared<Snapshot>(*std::atomic_load(&m_Snapshot));
+    auto it = snapshot->m_Index.find(path);
+    if (it == snapshot->m_Index.end()) {
+        throw std::invalid_argument("Note_Server::remove(): No such note.");
+    }
+    m_Notes_Store.delete_note(path);
+    // The last note takes the place of the removed one
+    const size_t index = it->second;
+    snapshot->m_Index.erase(it);
+    if (index + 1 < snapshot->m_Notes.size()) {
+        snapshot->m_Notes.at(index) = std::move(snapshot->m_Notes.back());
+        snapshot->m_Index.at(snapshot->m_Notes.at(index).first) = index;
+    }
+    snapshot->m_Notes.pop_back();
+    std::atomic_store(&m_Snapshot, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+}
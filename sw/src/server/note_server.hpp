@@ -0,0 +1,120 @@
+#ifndef NOTE_SERVER_HPP
+#define NOTE_SERVER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "../note_storage.hpp"
+#include "../notes/note.hpp"
+
+/**
+ * A resident server keeping all notes loaded in memory and serving
+ * requests of Note_Client over a Unix domain socket.
+ *
+ * Readers work with an immutable snapshot of the notes, so they are served
+ * in parallel without any locking; writers create a new snapshot
+ * and publish it atomically. Notes in a snapshot are indexed by their
+ * paths and at most m_MAX_CLIENTS clients are served at once.
+ */
+class Note_Server {
+    private:
+        /**
+         * An immutable view of all notes in the storage.
+         */
+        struct Snapshot {
+            // 1st element is a note's path, relative to storage's root.
+            std::vector<std::pair<std::string, std::shared_ptr<const Note>>> m_Notes;
+            // Indices of the notes in m_Notes by their paths.
+            std::unordered_map<std::string, size_t> m_Index;
+
+            /**
+             * Find a note.
+             *
+             * Throws std::invalid_argument if there is no such note.
+             *
+             * @param  path A path of the note.
+             * @return An index of the note in m_Notes.
+             */
+            size_t find(const std::string & path) const;
+
+            /**
+             * Index all notes of m_Notes.
+             */
+            void reindex();
+        };
+
+        // Clients served at once, others wait until one of them leaves.
+        static constexpr size_t m_MAX_CLIENTS = 64;
+
+        Note_Storage & m_Notes_Store;
+        const std::string m_SOCKET_PATH;
+
+        // Always accessed with std::atomic_load() / std::atomic_store().
+        std::shared_ptr<const Snapshot> m_Snapshot;
+        // Serializes writers, readers don't need it.
+        std::mutex m_Write_Mutex;
+        // A number of clients being served, guarded by m_Clients_Mutex.
+        size_t m_Clients = 0;
+        std::mutex m_Clients_Mutex;
+        std::condition_variable m_Client_Left;
+
+        /**
+         * Load all notes from the storage to a new snapshot.
+         */
+        void reload();
+
+        /**
+         * Serve one client until it closes the connection.
+         *
+         * @param fd A socket of the client.
+         */
+        void serve_client(const int fd);
+
+        /**
+         * Process one request.
+         *
+         * Throws std::runtime_error or std::invalid_argument if the request
+         * can't be processed.
+         *
+         * @param  request A request payload.
+         * @return A response body.
+         */
+        std::string process(const std::string & request);
+
+        /**
+         * Save a note received from a client and publish a new snapshot.
+         *
+         * @param  dir       A directory where to save the note.
+         * @param  body      A note in a text format.
+         * @param  file_name An expected file name of the note (if not empty).
+         * @return A path of the new note.
+         */
+        std::string create(std::string dir, const std::string & body,
+                           const std::string & file_name = "");
+
+        /**
+         * Delete a note and publish a new snapshot.
+         *
+         * @param path A path of the note.
+         */
+        void remove(const std::string & path);
+
+    public:
+        Note_Server(Note_Storage & notes_store, const std::string & socket_path);
+
+        /**
+         * Load the notes and serve clients forever.
+         *
+         * Transient errors of accepting a client (e.g. too many open files)
+         * are retried. Throws std::runtime_error if couldn't create
+         * the socket or accept clients, after all served clients left.
+         */
+        void run();
+};
+
+#endif  // NOTE_SERVER_HPP
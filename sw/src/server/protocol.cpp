@@ -0,0 +1,107 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "protocol.hpp"
+
+namespace {
+    /**
+     * Write the whole buffer, retrying on partial writes.
+     *
+     * @return true, if everything was written;
+     *      false otherwise.
+     */
+    bool write_all(const int fd, const char * data, size_t size) {
+        while (size) {
+            ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            else if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    /**
+     * Read exactly "size" bytes.
+     *
+     * @return Amount of read bytes (less than "size" only on end of stream),
+     *         -1 on error.
+     */
+    ssize_t read_all(const int fd, char * data, const size_t size) {
+        size_t done = 0;
+        while (done < size) {
+            ssize_t got = recv(fd, data + done, size - done, 0);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            else if (got < 0) {
+                return -1;
+            }
+            else if (!got) {
+                break;
+            }
+            done += static_cast<size_t>(got);
+        }
+        return static_cast<ssize_t>(done);
+    }
+}
+
+void protocol::send_frame(const int fd, const std::string & payload) {
+    const uint32_t size = static_cast<uint32_t>(payload.size());
+    const char header[4] = { static_cast<char>(size >> 24), static_cast<char>(size >> 16),
+                             static_cast<char>(size >> 8), static_cast<char>(size) };
+    if (!write_all(fd, header, sizeof(header))
+        || !write_all(fd, payload.data(), payload.size())) {
+        throw std::runtime_error("protocol::send_frame(): Couldn't send a frame.");
+    }
+}
+
+bool protocol::receive_frame(const int fd, std::string & payload) {
+    unsigned char header[4];
+    ssize_t got = read_all(fd, reinterpret_cast<char *>(header), sizeof(header));
+    if (!got) {
+        return false;
+    }
+    else if (got != sizeof(header)) {
+        throw std::runtime_error("protocol::receive_frame(): Couldn't receive a frame.");
+    }
+
+    const size_t size = static_cast<size_t>(header[0]) << 24 | header[1] << 16
+                        | header[2] << 8 | header[3];
+    if (size > MAX_FRAME) {
+        throw std::runtime_error("protocol::receive_frame(): Frame is too big.");
+    }
+    payload.resize(size);
+    if (read_all(fd, payload.data(), size) != static_cast<ssize_t>(size)) {
+        throw std::runtime_error("protocol::receive_frame(): Couldn't receive a frame.");
+    }
+    return true;
+}
+
+std::vector<std::string> protocol::split_request(const std::string & request,
+                                                 std::string & body) {
+    std::vector<std::string> command;
+    size_t pos = 0;
+    while (pos < request.size()) {
+        size_t end = request.find('\n', pos);
+        if (end == std::string::npos) {
+            end = request.size();
+        }
+        if (end == pos) {
+            // An empty line separates the body
+            body = request.substr(pos + 1);
+            break;
+        }
+        command.push_back(request.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return command;
+}
@@ -0,0 +1,53 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * A simple framed protocol used by Note_Server and Note_Client.
+ *
+ * Every message is a 4-byte big-endian length followed by the payload.
+ * A request payload is a command and it's arguments, one per line,
+ * optionally followed by an empty line and a body (e.g. a note to create).
+ * A response payload starts with a line "OK" or "ERROR <message>",
+ * followed by the response body.
+ */
+namespace protocol {
+    // The biggest frame we're willing to receive.
+    const size_t MAX_FRAME = 64 * 1024 * 1024;
+
+    /**
+     * Send a frame.
+     *
+     * Throws std::runtime_error if got error.
+     *
+     * @param fd      A socket to send the frame to.
+     * @param payload A payload of the frame.
+     */
+    void send_frame(const int fd, const std::string & payload);
+
+    /**
+     * Receive a frame.
+     *
+     * Throws std::runtime_error if got error or the frame is too big.
+     *
+     * @param  fd      A socket to receive the frame from.
+     * @param  payload Where to store the payload.
+     * @return true, if received the frame;
+     *      false, if the other side closed the connection.
+     */
+    bool receive_frame(const int fd, std::string & payload);
+
+    /**
+     * Split a request to the command with arguments and a body.
+     *
+     * @param  request A request payload.
+     * @param  body    Where to store the body.
+     * @return Command and it's arguments.
+     */
+    std::vector<std::string> split_request(const std::string & request,
+                                           std::string & body);
+}
+
+#endif  // PROTOCOL_HPP
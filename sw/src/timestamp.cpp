@@ -0,0 +1,154 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <chrono>
+#include <ctime>
+#include "timestamp.hpp"
+
+namespace {
+    /**
+     * Write a number as exactly "width" decimal digits.
+     */
+    void put_digits(char * buffer, uint32_t value, size_t width) {
+        while (width--) {
+            buffer[width] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+    }
+
+    /**
+     * Read exactly "width" decimal digits.
+     *
+     * @return false, if there is a non-digit.
+     */
+    bool get_digits(const char * text, size_t width, uint32_t & value) {
+        value = 0;
+        for (size_t i = 0; i < width; i++) {
+            if (text[i] < '0' || text[i] > '9') {
+                return false;
+            }
+            value = value * 10 + static_cast<uint32_t>(text[i] - '0');
+        }
+        return true;
+    }
+}
+
+Timestamp::Timestamp(const std::string & text) {
+    // "YYYY-MM-DD, HH:MM:SS"
+    uint32_t year, month, day, hour, minute, second;
+    if (text.size() != m_TEXT_SIZE || text.compare(4, 1, "-") || text.compare(7, 1, "-")
+        || text.compare(10, 2, ", ") || text.compare(14, 1, ":") || text.compare(17, 1, ":")
+        || !get_digits(text.data(), 4, year) || !get_digits(text.data() + 5, 2, month)
+        || !get_digits(text.data() + 8, 2, day) || !get_digits(text.data() + 12, 2, hour)
+        || !get_digits(text.data() + 15, 2, minute) || !get_digits(text.data() + 18, 2, second)) {
+        m_Raw = text;
+        return;
+    }
+    m_Year = static_cast<uint16_t>(year);
+    m_Month = static_cast<uint8_t>(month);
+    m_Day = static_cast<uint8_t>(day);
+    m_Hour = static_cast<uint8_t>(hour);
+    m_Minute = static_cast<uint8_t>(minute);
+    m_Second = static_cast<uint8_t>(second);
+}
+
+Timestamp::Timestamp(const std::time_t time, const uint32_t micros)
+    : m_Micros(micros) {
+    std::tm local;
+    localtime_r(&time, &local);
+    m_Year = static_cast<uint16_t>(local.tm_year + 1900);
+    m_Month = static_cast<uint8_t>(local.tm_mon + 1);
+    m_Day = static_cast<uint8_t>(local.tm_mday);
+    m_Hour = static_cast<uint8_t>(local.tm_hour);
+    m_Minute = static_cast<uint8_t>(local.tm_min);
+    m_Second = static_cast<uint8_t>(local.tm_sec);
+}
+
+Timestamp Timestamp::now() {
+    // The last second converted to local time by this thread
+    thread_local std::time_t cached_time = -1;
+    thread_local Timestamp cached;
+
+    const auto now = std::chrono::system_clock::now();
+    const std::time_t time = std::chrono::system_clock::to_time_t(now);
+    if (time != cached_time) {
+        cached = Timestamp(time);
+        cached_time = time;
+    }
+    Timestamp result = cached;
+    result.m_Micros = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                now.time_since_epoch()).count() % 1000000);
+    return result;
+}
+
+std::string_view Timestamp::view(char * buffer) const {
+    if (m_Raw.size()) {
+        return m_Raw;
+    }
+    put_digits(buffer, m_Year, 4);
+    buffer[4] = '-';
+    put_digits(buffer + 5, m_Month, 2);
+    buffer[7] = '-';
+    put_digits(buffer + 8, m_Day, 2);
+    buffer[10] = ',';
+    buffer[11] = ' ';
+    put_digits(buffer + 12, m_Hour, 2);
+    buffer[14] = ':';
+    put_digits(buffer + 15, m_Minute, 2);
+    buffer[17] = ':';
+    put_digits(buffer + 18, m_Second, 2);
+    return std::string_view(buffer, m_TEXT_SIZE);
+}
+
+void Timestamp::format_file_name(char * buffer) const {
+    put_digits(buffer, m_Year, 4);
+    buffer[4] = '_';
+    put_digits(buffer + 5, m_Month, 2);
+    buffer[7] = '_';
+    put_digits(buffer + 8, m_Day, 2);
+    buffer[10] = '_';
+    buffer[11] = '_';
+    put_digits(buffer + 12, m_Hour, 2);
+    buffer[14] = '_';
+    put_digits(buffer + 15, m_Minute, 2);
+    buffer[17] = '_';
+    put_digits(buffer + 18, m_Second, 2);
+    buffer[20] = '_';
+    put_digits(buffer + 21, m_Micros, 6);
+}
+
+std::string Timestamp::to_string() const {
+    char buffer[m_TEXT_SIZE];
+    return std::string(view(buffer));
+}
+
+bool Timestamp::is_valid() const {
+    return m_Raw.empty();
+}
+
+int Timestamp::compare(const Timestamp & other) const {
+    if (m_Raw.size() || other.m_Raw.size()) {
+        if (m_Raw.empty()) {
+            return -1;
+        }
+        if (other.m_Raw.empty()) {
+            return 1;
+        }
+        return m_Raw.compare(other.m_Raw);
+    }
+    // Fields are compared in order of significance
+    const uint64_t a = (static_cast<uint64_t>(m_Year) << 40) | (static_cast<uint64_t>(m_Month) << 32)
+                       | (static_cast<uint64_t>(m_Day) << 24) | (m_Hour << 16) | (m_Minute << 8) | m_Second,
+                   b = (static_cast<uint64_t>(other.m_Year) << 40) | (static_cast<uint64_t>(other.m_Month) << 32)
+                       | (static_cast<uint64_t>(other.m_Day) << 24) | (other.m_Hour << 16)
+                       | (other.m_Minute << 8) | other.m_Second;
+    return a < b ? -1 : a > b;
+}
+
+std::ostream & operator << (std::ostream & os, const Timestamp & timestamp) {
+    char buffer[Timestamp::m_TEXT_SIZE];
+    const std::string_view text = timestamp.view(buffer);
+    return os.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
@@ -0,0 +1,96 @@
+#ifndef TIMESTAMP_HPP
+#define TIMESTAMP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <ctime>
+
+/**
+ * A local date and time, stored as numbers and formatted only when needed
+ * ("YYYY-MM-DD, HH:MM:SS" in changelogs, "YYYY_MM_DD__HH_MM_SS_UUUUUU"
+ * in file names).
+ *
+ * Formatting writes digits straight into a caller's buffer (no locale,
+ * no allocation). now() calls localtime_r() only once per second
+ * and thread, the broken-down time is cached.
+ */
+class Timestamp {
+    private:
+        uint16_t m_Year = 0;
+        uint8_t m_Month = 0, m_Day = 0, m_Hour = 0, m_Minute = 0, m_Second = 0;
+        uint32_t m_Micros = 0;
+        // Text of a timestamp read from a file, which isn't in the expected
+        // format (kept, so it's saved back unchanged).
+        std::string m_Raw;
+
+    public:
+        // A size of "YYYY-MM-DD, HH:MM:SS".
+        static constexpr size_t m_TEXT_SIZE = 20;
+        // A size of "YYYY_MM_DD__HH_MM_SS_UUUUUU".
+        static constexpr size_t m_FILE_NAME_SIZE = 27;
+
+        Timestamp() = default;
+
+        /**
+         * Parse a timestamp in "YYYY-MM-DD, HH:MM:SS" format.
+         *
+         * A text in another format is kept as it is.
+         *
+         * @param text A timestamp.
+         */
+        explicit Timestamp(const std::string & text);
+
+        /**
+         * Convert a time to local time.
+         *
+         * @param time   Seconds since the epoch.
+         * @param micros Microseconds.
+         */
+        explicit Timestamp(const std::time_t time, const uint32_t micros = 0);
+
+        /**
+         * Get current local time. Is thread-safe.
+         *
+         * @return Current time (with microseconds).
+         */
+        static Timestamp now();
+
+        /**
+         * Format the timestamp as "YYYY-MM-DD, HH:MM:SS".
+         *
+         * @param  buffer A buffer of at least "m_TEXT_SIZE" characters.
+         * @return A view of the text (in the buffer, or of the original text
+         *         if it wasn't in the expected format).
+         */
+        std::string_view view(char * buffer) const;
+
+        /**
+         * Format the timestamp as "YYYY_MM_DD__HH_MM_SS_UUUUUU".
+         *
+         * @param buffer A buffer of at least "m_FILE_NAME_SIZE" characters.
+         */
+        void format_file_name(char * buffer) const;
+
+        std::string to_string() const;
+
+        /**
+         * Check whether or not the timestamp was parsed (isn't a text
+         * in an unknown format).
+         */
+        bool is_valid() const;
+
+        /**
+         * Compare timestamps chronologically (timestamps in an unknown
+         * format are compared as text, after all the others).
+         *
+         * @return <0, 0 or >0 like std::string::compare().
+         */
+        int compare(const Timestamp & other) const;
+
+        friend std::ostream & operator << (std::ostream & os, const Timestamp & timestamp);
+};
+
+#endif  // TIMESTAMP_HPP
@@ -0,0 +1,233 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "trace.hpp"
+
+namespace {
+    /**
+     * A finished scope ('X') or a counter value ('C').
+     */
+    struct Event {
+        const char * m_Name;
+        char m_Phase;
+        // Nanoseconds since the start of the program
+        uint64_t m_Begin, m_Duration;
+        uint64_t m_Read, m_Written;
+        int64_t m_Value;
+    };
+
+    struct Thread_Buffer {
+        uint32_t m_Thread;
+        // Locked only by it's thread and by dumps, so it's never contended
+        std::mutex m_Mutex;
+        std::vector<Event> m_Events;
+    };
+
+    std::mutex buffers_mutex;
+    std::vector<std::shared_ptr<Thread_Buffer>> buffers;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string trace_path;
+
+    // The innermost active scope of the thread
+    thread_local Trace_Scope * current = nullptr;
+
+    uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now() - start).count());
+    }
+
+    /**
+     * Get a buffer of the calling thread (buffers outlive their threads).
+     */
+    Thread_Buffer & thread_buffer() {
+        thread_local std::shared_ptr<Thread_Buffer> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<Thread_Buffer>();
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            buffer->m_Thread = static_cast<uint32_t>(buffers.size() + 1);
+            buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    void record(const Event & event) {
+        Thread_Buffer & buffer = thread_buffer();
+        std::lock_guard<std::mutex> lock(buffer.m_Mutex);
+        buffer.m_Events.push_back(event);
+    }
+
+    /**
+     * Write the results when the program exits.
+     */
+    void finish() {
+        if (trace_path.empty()) {
+            return;
+        }
+        std::ofstream file(trace_path, std::ios::trunc);
+        Trace::write_chrome_trace(file);
+        file.close();
+        if (!file.good()) {
+            std::cerr << "ERROR: Trace: Couldn't write the trace." << std::endl;
+        }
+        Trace::write_summary(std::cerr);
+    }
+}
+
+std::atomic<bool> Trace::m_Enabled(false);
+
+void Trace::enable() {
+    m_Enabled = true;
+}
+
+void Trace::disable() {
+    m_Enabled = false;
+}
+
+void Trace::init_from_env() {
+    const char * path = std::getenv("NOTEPAD_TRACE");
+    if (!path || !*path) {
+        return;
+    }
+    trace_path = path;
+    std::atexit(finish);
+    enable();
+}
+
+void Trace::count(const char * name, const int64_t value) {
+    if (!enabled()) {
+        return;
+    }
+    record({ name, 'C', now(), 0, 0, 0, value });
+}
+
+void Trace::add_bytes_read(const uint64_t bytes) {
+    if (current) {
+        current->m_Read += bytes;
+    }
+}
+
+void Trace::add_bytes_written(const uint64_t bytes) {
+    if (current) {
+        current->m_Written += bytes;
+    }
+}
+
+void Trace::write_chrome_trace(std::ostream & os) {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto & buffer: buffers) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->m_Mutex);
+        for (const auto & x: buffer->m_Events) {
+            os << (first ? "\n" : ",\n");
+            first = false;
+            // Names are string literals, they don't need escaping
+            os << "{\"name\":\"" << x.m_Name << "\",\"ph\":\"" << x.m_Phase
+               << "\",\"pid\":1,\"tid\":" << buffer->m_Thread
+               << ",\"ts\":" << x.m_Begin / 1000 << '.' << std::setw(3) << std::setfill('0')
+               << x.m_Begin % 1000;
+            if (x.m_Phase == 'X') {
+                os << ",\"dur\":" << x.m_Duration / 1000 << '.' << std::setw(3) << x.m_Duration % 1000
+                   << ",\"args\":{\"bytes_read\":" << x.m_Read
+                   << ",\"bytes_written\":" << x.m_Written << '}';
+            }
+            else {
+                os << ",\"args\":{\"value\":" << x.m_Value << '}';
+            }
+            os << '}';
+        }
+    }
+    os << "\n]}\n";
+}
+
+void Trace::write_summary(std::ostream & os) {
+    struct Stats {
+        std::vector<uint64_t> m_Durations;
+        uint64_t m_Read = 0, m_Written = 0;
+        int64_t m_Total = 0;
+        size_t m_Count = 0;
+    };
+    // Names are string literals, but the same name may have more copies
+    std::map<std::string, Stats> scopes, counters;
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        for (const auto & buffer: buffers) {
+            std::lock_guard<std::mutex> buffer_lock(buffer->m_Mutex);
+            for (const auto & x: buffer->m_Events) {
+                Stats & stats = (x.m_Phase == 'X' ? scopes : counters)[x.m_Name];
+                stats.m_Durations.push_back(x.m_Duration);
+                stats.m_Read += x.m_Read;
+                stats.m_Written += x.m_Written;
+                stats.m_Total += x.m_Value;
+                stats.m_Count++;
+            }
+        }
+    }
+
+    auto percentile = [](std::vector<uint64_t> & durations, const size_t p) {
+        const size_t index = (durations.size() - 1) * p / 100;
+        std::nth_element(durations.begin(), durations.begin() + static_cast<long>(index), durations.end());
+        return durations.at(index) / 1000.0;
+    };
+    os << std::left << std::setw(40) << "scope" << std::right
+       << std::setw(10) << "calls" << std::setw(14) << "total ms"
+       << std::setw(12) << "p50 us" << std::setw(12) << "p99 us"
+       << std::setw(14) << "bytes read" << std::setw(14) << "bytes written" << '\n'
+       << std::fixed << std::setprecision(1);
+    for (auto & x: scopes) {
+        uint64_t total = 0;
+        for (const auto & duration: x.second.m_Durations) {
+            total += duration;
+        }
+        os << std::left << std::setw(40) << x.first << std::right
+           << std::setw(10) << x.second.m_Count << std::setw(14) << total / 1e6;
+        os << std::setw(12) << percentile(x.second.m_Durations, 50);
+        os << std::setw(12) << percentile(x.second.m_Durations, 99)
+           << std::setw(14) << x.second.m_Read << std::setw(14) << x.second.m_Written << '\n';
+    }
+    if (counters.size()) {
+        os << '\n' << std::left << std::setw(40) << "counter" << std::right
+           << std::setw(10) << "samples" << std::setw(14) << "total" << '\n';
+        for (const auto & x: counters) {
+            os << std::left << std::setw(40) << x.first << std::right
+               << std::setw(10) << x.second.m_Count << std::setw(14) << x.second.m_Total << '\n';
+        }
+    }
+    os.flush();
+}
+
+void Trace::clear() {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (const auto & buffer: buffers) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->m_Mutex);
+        buffer->m_Events.clear();
+    }
+}
+
+void Trace_Scope::begin() {
+    m_Parent = current;
+    current = this;
+    m_Begin = now();
+}
+
+void Trace_Scope::end() {
+    const uint64_t end = now();
+    current = m_Parent;
+    if (m_Parent) {
+        m_Parent->m_Read += m_Read;
+        m_Parent->m_Written += m_Written;
+    }
+    record({ m_Name, 'X', m_Begin, end - m_Begin, m_Read, m_Written, 0 });
+}
@@ -0,0 +1,117 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <ostream>
+
+/**
+ * Lightweight instrumentation: scoped timers (Trace_Scope) and counters.
+ *
+ * Disabled by default, then a scope costs one relaxed atomic load.
+ * Tracing is turned on at runtime by setting an environment variable
+ * NOTEPAD_TRACE to a path of a file: when the program exits, the file
+ * gets a Chrome trace (JSON, opens in chrome://tracing or Perfetto)
+ * and a summary table is printed to stderr.
+ *
+ * Events are collected in per-thread buffers, so threads don't contend.
+ */
+class Trace {
+    private:
+        static std::atomic<bool> m_Enabled;
+
+    public:
+        static bool enabled() {
+            return m_Enabled.load(std::memory_order_relaxed);
+        }
+
+        static void enable();
+
+        static void disable();
+
+        /**
+         * Enable tracing if NOTEPAD_TRACE is set and write the results
+         * when the program exits.
+         */
+        static void init_from_env();
+
+        /**
+         * Record a value of a counter (e.g. a number of retries).
+         *
+         * @param name  A name of the counter (must be a string literal).
+         * @param value A value.
+         */
+        static void count(const char * name, const int64_t value);
+
+        /**
+         * Add bytes read / written to the innermost scope of this thread.
+         *
+         * @param bytes A number of bytes.
+         */
+        static void add_bytes_read(const uint64_t bytes);
+
+        static void add_bytes_written(const uint64_t bytes);
+
+        /**
+         * Write all events in Chrome trace event format.
+         *
+         * @param os A stream where to write.
+         */
+        static void write_chrome_trace(std::ostream & os);
+
+        /**
+         * Write a table with a number of calls, p50 / p99 latency and bytes
+         * read and written per scope and a total per counter.
+         *
+         * @param os A stream where to write.
+         */
+        static void write_summary(std::ostream & os);
+
+        /**
+         * Drop all recorded events.
+         */
+        static void clear();
+};
+
+/**
+ * Times a scope (e.g. a function) when tracing is enabled.
+ *
+ * Bytes read and written inside nested scopes count for the outer ones too.
+ */
+class Trace_Scope {
+    private:
+        const char * m_Name;
+        bool m_Active;
+        uint64_t m_Begin = 0, m_Read = 0, m_Written = 0;
+        Trace_Scope * m_Parent = nullptr;
+
+        void begin();
+
+        void end();
+
+        friend class Trace;
+
+    public:
+        /**
+         * @param name A name of the scope (must be a string literal).
+         */
+        explicit Trace_Scope(const char * name)
+            : m_Name(name), m_Active(Trace::enabled()) {
+            if (m_Active) {
+                begin();
+            }
+        }
+
+        ~Trace_Scope() {
+            if (m_Active) {
+                end();
+            }
+        }
+
+        Trace_Scope(const Trace_Scope &) = delete;
+        Trace_Scope & operator = (const Trace_Scope &) = delete;
+};
+
+#endif  // TRACE_HPP